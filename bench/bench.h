@@ -0,0 +1,45 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <iostream>
+
+// Average wall time of a run of the function in milliseconds, after one warm-up run
+template <typename F>
+inline double time_ms(int runs, F&& function)
+{
+  function();
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < runs; i++) {
+    function();
+  }
+
+  const std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+  return total.count() / runs;
+}
+
+// Wall time of a single run in milliseconds, for runs that change what the next one sees
+template <typename F>
+inline double time_once_ms(F&& function)
+{
+  const auto start = std::chrono::steady_clock::now();
+  function();
+
+  const std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - start;
+  return total.count();
+}
+
+// Prints failed checks, the benchmarks return the number of failures as their exit code
+inline int check(bool condition, const char* description)
+{
+  if (condition) {
+    return 0;
+  }
+
+  std::cerr << "Check failed: " << description << std::endl;
+  return 1;
+}
+
+#endif // BENCH_H
@@ -0,0 +1,129 @@
+#include "bench.h"
+#include "culling/bvh.h"
+
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+constexpr unsigned int SIZES[] = { 10000, 100000, 1000000 };
+constexpr float WORLD_EXTENT = 200.0f;
+constexpr int NUM_FRUSTUM_QUERIES = 20;
+constexpr int NUM_SPHERE_QUERIES = 1000;
+constexpr float SPHERE_RADIUS = 5.0f;
+// Brute force results are compared against for the smallest size only
+constexpr unsigned int MAX_CHECKED_SIZE = 10000;
+
+static std::mt19937 generator(1);
+
+static vec3 random_point(float extent)
+{
+  std::uniform_real_distribution<float> coordinate(-extent * 0.5f, extent * 0.5f);
+  return vec3(coordinate(generator), coordinate(generator), coordinate(generator));
+}
+
+static std::vector<AABB> random_boxes(unsigned int count)
+{
+  std::uniform_real_distribution<float> size(0.1f, 1.0f);
+  std::vector<AABB> boxes(count);
+
+  for (auto& box : boxes) {
+    const vec3 center = random_point(WORLD_EXTENT);
+    const vec3 extents(size(generator), size(generator), size(generator));
+    box = { center - extents, center + extents };
+  }
+
+  return boxes;
+}
+
+static int check_queries(const BVH& bvh, const std::vector<AABB>& boxes, const Frustum& frustum)
+{
+  int failures = 0;
+  std::vector<unsigned int> result;
+  size_t expected = 0;
+
+  bvh.query_frustum(frustum, result);
+  for (const AABB& box : boxes) {
+    expected += frustum.intersects(box);
+  }
+  failures += check(result.size() == expected, "frustum query matches brute force");
+
+  for (int i = 0; i < 100; i++) {
+    const vec3 center = random_point(WORLD_EXTENT);
+    bvh.query_sphere(center, SPHERE_RADIUS, result);
+    expected = 0;
+
+    for (const AABB& box : boxes) {
+      const vec3 offset = glm::max(box.min, glm::min(center, box.max)) - center;
+      expected += glm::dot(offset, offset) <= SPHERE_RADIUS * SPHERE_RADIUS;
+    }
+
+    failures += check(result.size() == expected, "sphere query matches brute force");
+  }
+
+  return failures;
+}
+
+int main()
+{
+  int failures = 0;
+
+  const mat4 view = glm::lookAt(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+  const Frustum frustum(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f) * view);
+
+  for (const unsigned int size : SIZES) {
+    std::vector<AABB> boxes = random_boxes(size);
+    BVH bvh;
+    const int runs = static_cast<int>(std::max(1u, 100000 / size));
+
+    const double build_ms = time_ms(runs, [&] { bvh.build(boxes); });
+
+    // Every box moves a little, like the instances of an animated scene
+    std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+    for (auto& box : boxes) {
+      const vec3 offset(jitter(generator), jitter(generator), jitter(generator));
+      box = { box.min + offset, box.max + offset };
+    }
+
+    const double refit_ms = time_ms(runs, [&] { bvh.refit(boxes); });
+
+    if (size <= MAX_CHECKED_SIZE) {
+      failures += check_queries(bvh, boxes, frustum);
+    }
+
+    std::vector<unsigned int> result;
+    size_t frustum_results = 0, sphere_results = 0;
+
+    const double frustum_ms = time_ms(1, [&] {
+      frustum_results = 0;
+
+      for (int i = 0; i < NUM_FRUSTUM_QUERIES; i++) {
+        bvh.query_frustum(frustum, result);
+        frustum_results += result.size();
+      }
+    });
+
+    std::vector<vec3> centers(NUM_SPHERE_QUERIES);
+    for (auto& center : centers) {
+      center = random_point(WORLD_EXTENT);
+    }
+
+    const double sphere_ms = time_ms(1, [&] {
+      sphere_results = 0;
+
+      for (const vec3& center : centers) {
+        bvh.query_sphere(center, SPHERE_RADIUS, result);
+        sphere_results += result.size();
+      }
+    });
+
+    std::cout << size << " boxes" << std::endl;
+    std::cout << "  Build: " << build_ms << " ms, refit: " << refit_ms << " ms" << std::endl;
+    std::cout << "  Frustum: " << frustum_ms * 1000.0 / NUM_FRUSTUM_QUERIES << " us per query, "
+              << frustum_results / NUM_FRUSTUM_QUERIES << " results" << std::endl;
+    std::cout << "  Sphere: " << sphere_ms * 1000.0 / NUM_SPHERE_QUERIES << " us per query, "
+              << static_cast<double>(sphere_results) / NUM_SPHERE_QUERIES << " results"
+              << std::endl;
+  }
+
+  return failures;
+}
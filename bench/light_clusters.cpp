@@ -0,0 +1,47 @@
+#include "bench.h"
+#include "mock_gl.h"
+#include "culling/light_clusters.h"
+
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+constexpr size_t LIGHT_COUNTS[] = { 6, 256, 4096, 65536 };
+constexpr int NUM_UPDATES = 50;
+// Reaches about 5 units, see Lights::get_radius
+constexpr vec3 LIGHT_ATTENUATION = vec3(1.0f, 0.7f, 1.8f);
+
+int main()
+{
+  MockGL::load();
+
+  // Same projection as the camera of the display on a 16:9 screen
+  const mat4 perspective = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+  const mat4 view = glm::lookAt(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> lateral(-40.0f, 40.0f);
+  std::uniform_real_distribution<float> height(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> depth(-100.0f, 0.0f);
+  std::uniform_real_distribution<float> color(0.2f, 1.0f);
+
+  for (const size_t count : LIGHT_COUNTS) {
+    std::vector<Lights::PointLight> lights(count);
+
+    for (auto& light : lights) {
+      const vec3 diffuse(color(generator), color(generator), color(generator));
+      light = { vec3(lateral(generator), height(generator), depth(generator)), diffuse * 0.1f,
+                diffuse, diffuse, LIGHT_ATTENUATION };
+    }
+
+    LightClusters clusters;
+    const double update_ms = time_ms(NUM_UPDATES, [&] {
+      clusters.update(perspective, view, lights);
+    });
+
+    std::cout << count << " lights: " << update_ms << " ms per update, "
+              << clusters.get_average_lights() << " lights per cluster" << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "mock_gl.h"
+#include "model/lights.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+constexpr size_t NUM_LIGHTS = 100000;
+constexpr size_t BATCH_SIZE = 1000;
+constexpr size_t NUM_BATCHES = NUM_LIGHTS / BATCH_SIZE;
+constexpr double BATCH_KB = BATCH_SIZE * POINT_NUM_ELEMS * sizeof (vec4) / 1024.0;
+
+static std::mt19937 generator(1);
+
+static Lights::PointLight random_light()
+{
+  std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+  std::uniform_real_distribution<float> color(0.2f, 1.0f);
+  const vec3 diffuse(color(generator), color(generator), color(generator));
+
+  return { vec3(coordinate(generator), coordinate(generator), coordinate(generator)),
+           diffuse * 0.1f, diffuse, diffuse, vec3(1.0f, 0.7f, 1.8f) };
+}
+
+static std::vector<Lights::PointLight> random_lights(size_t count)
+{
+  std::vector<Lights::PointLight> lights(count);
+
+  for (auto& light : lights) {
+    light = random_light();
+  }
+
+  return lights;
+}
+
+static void print(const char* phase, double total_ms, unsigned long long uploaded_bytes)
+{
+  std::cout << phase << ": " << total_ms / NUM_BATCHES << " ms per batch, "
+            << uploaded_bytes / 1024.0 / NUM_BATCHES << " KB uploaded per update" << std::endl;
+}
+
+// Batches of lights are edited and uploaded by an update each, like frames of a scene
+int main()
+{
+  MockGL::load();
+
+  Lights lights(std::make_shared<Camera>(vec3(0.0f), vec3(0.0f, 0.0f, -1.0f),
+                                         vec3(0.0f, 1.0f, 0.0f)));
+  int failures = 0;
+
+  std::cout << NUM_LIGHTS << " lights in batches of " << BATCH_SIZE << " ("
+            << BATCH_KB << " KB)" << std::endl;
+
+  // The buffer grows by doubling and every reallocation uploads all lights again
+  MockGL::reset_uploaded_bytes();
+  const double add_ms = time_once_ms([&] {
+    for (size_t batch = 0; batch < NUM_BATCHES; batch++) {
+      lights.add_point_lights(random_lights(BATCH_SIZE));
+      lights.update();
+    }
+  });
+  print("Add", add_ms, MockGL::get_uploaded_bytes());
+  failures += check(lights.get_point_lights().size() == NUM_LIGHTS, "every light is added");
+
+  std::vector<std::vector<Lights::PointLight>> batches(NUM_BATCHES);
+  for (auto& batch : batches) {
+    batch = random_lights(BATCH_SIZE);
+  }
+
+  MockGL::reset_uploaded_bytes();
+  const double update_ms = time_once_ms([&] {
+    for (size_t batch = 0; batch < NUM_BATCHES; batch++) {
+      lights.update_point_lights(batch * BATCH_SIZE, batches[batch]);
+      lights.update();
+    }
+  });
+  print("Update contiguous", update_ms, MockGL::get_uploaded_bytes());
+  // Besides the lights, only the camera position goes to the uniform buffer
+  failures += check(MockGL::get_uploaded_bytes() ==
+                    NUM_BATCHES * (BATCH_SIZE * POINT_NUM_ELEMS * sizeof (vec4) + sizeof (vec3)),
+                    "contiguous updates upload only the updated lights");
+
+  // Only one dirty range is kept, so it spans from the first to the last light changed
+  std::uniform_int_distribution<size_t> index(0, NUM_LIGHTS - 1);
+  MockGL::reset_uploaded_bytes();
+  const double scattered_ms = time_once_ms([&] {
+    for (size_t batch = 0; batch < NUM_BATCHES; batch++) {
+      for (size_t i = 0; i < BATCH_SIZE; i++) {
+        lights.update_point_lights(index(generator), { batches[batch][i] });
+      }
+      lights.update();
+    }
+  });
+  print("Update scattered", scattered_ms, MockGL::get_uploaded_bytes());
+
+  std::vector<std::vector<size_t>> removals(NUM_BATCHES);
+  for (size_t batch = 0; batch < NUM_BATCHES; batch++) {
+    removals[batch].resize(NUM_LIGHTS - batch * BATCH_SIZE);
+    std::iota(removals[batch].begin(), removals[batch].end(), 0);
+    std::shuffle(removals[batch].begin(), removals[batch].end(), generator);
+    removals[batch].resize(BATCH_SIZE);
+  }
+
+  // The last lights move into the freed slots, everything from the lowest removed is uploaded
+  MockGL::reset_uploaded_bytes();
+  const double remove_ms = time_once_ms([&] {
+    for (auto& indices : removals) {
+      lights.remove_point_lights(std::move(indices));
+      lights.update();
+    }
+  });
+  print("Remove", remove_ms, MockGL::get_uploaded_bytes());
+  failures += check(lights.get_point_lights().empty(), "every light is removed");
+
+  return failures;
+}
@@ -0,0 +1,91 @@
+#include "mock_gl.h"
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstring>
+
+static std::atomic<unsigned long long> uploaded_bytes(0);
+static std::atomic<unsigned int> next_name(1);
+
+// Called through pointers of every GL signature, which the calling conventions glad is used
+// with allow for functions ignoring their arguments
+static GLintptr APIENTRY do_nothing()
+{
+  return 0;
+}
+
+static void APIENTRY generate(GLsizei count, GLuint* names)
+{
+  for (GLsizei i = 0; i < count; i++) {
+    names[i] = next_name++;
+  }
+}
+
+static const GLubyte* APIENTRY get_string(GLenum name)
+{
+  return reinterpret_cast<const GLubyte*>(name == GL_VERSION ? "4.5.0 Mock" : "Mock");
+}
+
+static void APIENTRY get_integer(GLenum, GLint* data)
+{
+  *data = 0;
+}
+
+static void APIENTRY get_integer64(GLenum, GLint64* data)
+{
+  *data = 0;
+}
+
+static void APIENTRY buffer_data(GLenum, GLsizeiptr size, const void* data, GLenum)
+{
+  if (data) {
+    uploaded_bytes += static_cast<unsigned long long>(size);
+  }
+}
+
+static void APIENTRY buffer_sub_data(GLenum, GLintptr, GLsizeiptr size, const void*)
+{
+  uploaded_bytes += static_cast<unsigned long long>(size);
+}
+
+static void* load_function(const char* name)
+{
+  const auto is = [name] (const char* function) {
+    return std::strcmp(name, function) == 0;
+  };
+
+  if (std::strncmp(name, "glGen", 5) == 0 && std::strncmp(name, "glGenerate", 10) != 0) {
+    return reinterpret_cast<void*>(generate);
+  } else if (is("glGetString")) {
+    return reinterpret_cast<void*>(get_string);
+  } else if (is("glGetIntegerv")) {
+    return reinterpret_cast<void*>(get_integer);
+  } else if (is("glGetInteger64v")) {
+    return reinterpret_cast<void*>(get_integer64);
+  } else if (is("glBufferData")) {
+    return reinterpret_cast<void*>(buffer_data);
+  } else if (is("glBufferSubData")) {
+    return reinterpret_cast<void*>(buffer_sub_data);
+  }
+
+  return reinterpret_cast<void*>(do_nothing);
+}
+
+namespace MockGL {
+  void load()
+  {
+    // Fails on the missing extensions after every entry point is loaded
+    gladLoadGLLoader(load_function);
+  }
+
+  unsigned long long get_uploaded_bytes()
+  {
+    return uploaded_bytes;
+  }
+
+  void reset_uploaded_bytes()
+  {
+    uploaded_bytes = 0;
+  }
+}
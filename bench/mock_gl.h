@@ -0,0 +1,15 @@
+#ifndef MOCK_GL_H
+#define MOCK_GL_H
+
+// Stand-in GL loaded through glad, so code issuing GL calls runs without a window or context.
+// Every entry point does nothing and returns zero, except the few that hand out names or
+// describe the context. Buffer uploads are counted so benchmarks can report them.
+namespace MockGL {
+  void load();
+
+  // Bytes given to glBufferData and glBufferSubData since the last reset
+  unsigned long long get_uploaded_bytes();
+  void reset_uploaded_bytes();
+}
+
+#endif // MOCK_GL_H
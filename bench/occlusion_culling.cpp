@@ -0,0 +1,113 @@
+#include "bench.h"
+#include "culling/occlusion_culler.h"
+#include "util/data.h"
+
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// Same resolution as the culler of the display
+constexpr int WIDTH = 320;
+constexpr int HEIGHT = 180;
+constexpr int NUM_OCCLUDERS = 256;
+constexpr int NUM_OCCLUDEES = 4096;
+constexpr int NUM_FRAMES = 200;
+
+static mat4 get_view_projection()
+{
+  const mat4 view = glm::lookAt(vec3(0.0f, 0.0f, 10.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+  return glm::perspective(glm::radians(60.0f), static_cast<float>(WIDTH) / HEIGHT, 0.1f, 100.0f) *
+         view;
+}
+
+static void add_cube(OcclusionCuller& culler, const vec3& position, const vec3& scale)
+{
+  culler.add_occluder(CUBE_VERTICES, 8, CUBE_INDICES, 36,
+                      glm::scale(glm::translate(mat4(1.0f), position), scale));
+}
+
+// An 8x8 wall through the origin facing the camera, boxes behind it with a smaller footprint
+// are hidden, anything beside, in front or only partly behind it is not
+static int check_wall()
+{
+  OcclusionCuller culler(WIDTH, HEIGHT);
+  culler.begin_frame(get_view_projection());
+  add_cube(culler, vec3(0.0f), vec3(8.0f, 8.0f, 0.2f));
+  culler.rasterize();
+
+  int failures = 0;
+  failures += check(!culler.is_visible({ vec3(-1.0f, -1.0f, -3.0f), vec3(1.0f, 1.0f, -2.0f) }),
+                    "box behind the wall is hidden");
+  failures += check(!culler.is_visible({ vec3(-3.0f, -3.0f, -9.0f), vec3(3.0f, 3.0f, -8.0f) }),
+                    "larger box far behind the wall is hidden");
+  failures += check(culler.is_visible({ vec3(-1.0f, -1.0f, 1.0f), vec3(1.0f, 1.0f, 2.0f) }),
+                    "box in front of the wall is visible");
+  failures += check(culler.is_visible({ vec3(6.0f, -1.0f, -3.0f), vec3(7.0f, 1.0f, -2.0f) }),
+                    "box beside the wall is visible");
+  failures += check(culler.is_visible({ vec3(3.0f, -1.0f, -3.0f), vec3(5.0f, 1.0f, -2.0f) }),
+                    "box partly behind the wall is visible");
+  failures += check(culler.is_visible({ vec3(-6.0f, -6.0f, -3.0f), vec3(6.0f, 6.0f, -2.0f) }),
+                    "box larger than the wall behind it is visible");
+  failures += check(!culler.is_visible({ vec3(-1.0f, -1.0f, 11.0f), vec3(1.0f, 1.0f, 12.0f) }),
+                    "box behind the camera is hidden");
+  failures += check(!culler.is_visible({ vec3(40.0f, -1.0f, -3.0f), vec3(41.0f, 1.0f, -2.0f) }),
+                    "box outside the view is hidden");
+
+  return failures;
+}
+
+int main()
+{
+  const int failures = check_wall();
+
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<float> lateral(-20.0f, 20.0f);
+  std::uniform_real_distribution<float> depth(-60.0f, 0.0f);
+  std::uniform_real_distribution<float> size(0.5f, 3.0f);
+
+  std::vector<std::pair<vec3, vec3>> occluders(NUM_OCCLUDERS);
+  std::vector<AABB> occludees(NUM_OCCLUDEES);
+
+  for (auto& [position, scale] : occluders) {
+    position = vec3(lateral(generator), lateral(generator), depth(generator));
+    scale = vec3(size(generator), size(generator), size(generator));
+  }
+
+  for (auto& bounds : occludees) {
+    const vec3 center(lateral(generator), lateral(generator), depth(generator));
+    const vec3 extents = vec3(size(generator)) * 0.25f;
+    bounds = { center - extents, center + extents };
+  }
+
+  OcclusionCuller culler(WIDTH, HEIGHT);
+  const mat4 view_projection = get_view_projection();
+  int num_visible = 0;
+
+  const double rasterize_ms = time_ms(NUM_FRAMES, [&] {
+    culler.begin_frame(view_projection);
+
+    for (const auto& [position, scale] : occluders) {
+      add_cube(culler, position, scale);
+    }
+
+    culler.rasterize();
+  });
+
+  const double test_ms = time_ms(NUM_FRAMES, [&] {
+    num_visible = 0;
+
+    for (const AABB& bounds : occludees) {
+      num_visible += culler.is_visible(bounds);
+    }
+  });
+
+  std::cout << WIDTH << "x" << HEIGHT << ", " << NUM_OCCLUDERS << " cube occluders ("
+            << NUM_OCCLUDERS * 12 << " triangles), " << NUM_OCCLUDEES << " occludees" << std::endl;
+  std::cout << "Rasterize: " << rasterize_ms << " ms per frame" << std::endl;
+  std::cout << "Test: " << test_ms << " ms per frame, "
+            << test_ms * 1e6 / NUM_OCCLUDEES << " ns per occludee" << std::endl;
+  std::cout << "Cull rate: " << 100.0 * (NUM_OCCLUDEES - num_visible) / NUM_OCCLUDEES << " %"
+            << std::endl;
+
+  return failures;
+}
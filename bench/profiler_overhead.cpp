@@ -0,0 +1,58 @@
+#include "bench.h"
+#include "util/profiling/eventbuffer.h"
+#include "util/profiling/timescope.h"
+
+// Empty scopes timed in batches that fit in the event buffer, which is emptied in between
+constexpr int NUM_BATCHES = 64;
+constexpr int BATCH_SCOPES = Profiling::EventBuffer::CAPACITY / 4;
+
+// Nanoseconds per scope of the function run BATCH_SCOPES times in each batch
+template <typename F>
+static double time_scopes_ns(F&& function)
+{
+  double total_ms = 0.0;
+
+  for (int batch = 0; batch < NUM_BATCHES; batch++) {
+    total_ms += time_once_ms([&] {
+      for (int i = 0; i < BATCH_SCOPES; i++) {
+        function();
+      }
+    });
+
+    Profiling::EventBuffer::get().discard();
+  }
+
+  return total_ms * 1e6 / (NUM_BATCHES * BATCH_SCOPES);
+}
+
+int main()
+{
+  const Profiling::ScopeId scope = Profiling::intern("Profiler Overhead");
+  const Profiling::ScopeId section = Profiling::intern("Profiler Overhead Section");
+
+  const double scope_ns = time_scopes_ns([&] {
+    Profiling::TimeScope ts(scope);
+  });
+
+  const double section_ns = time_scopes_ns([&] {
+    Profiling::TimeScope ts(scope);
+    ts.section_start(section);
+    ts.section_end();
+  });
+
+  // What a name costs when it's looked up on every call instead of once
+  const double intern_ns = time_scopes_ns([] {
+    Profiling::TimeScope ts(Profiling::intern("Profiler Overhead Lookup"));
+  });
+
+  const double intern_format_ns = time_scopes_ns([] {
+    Profiling::TimeScope ts(Profiling::intern_format("Profiler Overhead %d", 1));
+  });
+
+  std::cout << "Empty scope: " << scope_ns << " ns" << std::endl;
+  std::cout << "Scope with a section: " << section_ns << " ns" << std::endl;
+  std::cout << "Scope interning its name: " << intern_ns << " ns" << std::endl;
+  std::cout << "Scope formatting its name: " << intern_format_ns << " ns" << std::endl;
+
+  return 0;
+}
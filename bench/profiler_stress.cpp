@@ -0,0 +1,125 @@
+#include "bench.h"
+#include "mock_gl.h"
+#include "util/profiling/eventbuffer.h"
+#include "util/profiling/timescope.h"
+
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Workers are started in rounds while the main thread ends frames, so their buffers are
+// drained while they record, registered while others exit and forgotten after
+constexpr int NUM_ROUNDS = 8;
+constexpr int NUM_WORKERS = 16;
+constexpr int FRAMES_PER_ROUND = 20;
+// Well within a buffer even if nothing is collected until the worker exits
+constexpr int WORKER_JOBS = 1000;
+// The last worker of each round records twice what its buffer holds before the main thread
+// collects anything, everything past the capacity is dropped
+constexpr int OVERFLOW_SCOPES = Profiling::EventBuffer::CAPACITY;
+constexpr unsigned long long TRACE_FIRST_FRAME = 1;
+constexpr unsigned long long TRACE_FRAMES = 60;
+
+static void work(int worker)
+{
+  Profiling::set_thread_name("Worker " + std::to_string(worker));
+  const Profiling::ScopeId job = Profiling::intern("Job");
+  const Profiling::ScopeId section = Profiling::intern("Job Section");
+
+  for (int i = 0; i < WORKER_JOBS; i++) {
+    Profiling::TimeScope ts(job);
+    ts.section_start(section);
+    ts.section_end();
+  }
+}
+
+static void overflow(int worker, std::atomic<bool>& done)
+{
+  Profiling::set_thread_name("Worker " + std::to_string(worker) + " (Overflowing)");
+  const Profiling::ScopeId burst = Profiling::intern("Burst");
+
+  for (int i = 0; i < OVERFLOW_SCOPES; i++) {
+    Profiling::TimeScope ts(burst);
+  }
+
+  done.store(true, std::memory_order_release);
+}
+
+static std::string read_file(const std::string& path)
+{
+  std::ifstream file(path);
+  std::stringstream stream;
+  stream << file.rdbuf();
+  return stream.str();
+}
+
+int main()
+{
+  MockGL::load();
+  Profiling::set_thread_name("Main");
+  Profiling::capture_trace(TRACE_FIRST_FRAME, TRACE_FRAMES);
+
+  const Profiling::ScopeId frame = Profiling::intern("Frame");
+
+  const double total_ms = time_once_ms([&] {
+    for (int round = 0; round < NUM_ROUNDS; round++) {
+      std::vector<std::thread> workers;
+      std::atomic<bool> overflowed(false);
+
+      for (int i = 0; i < NUM_WORKERS - 1; i++) {
+        workers.emplace_back(work, round * NUM_WORKERS + i);
+      }
+
+      workers.emplace_back(overflow, round * NUM_WORKERS + NUM_WORKERS - 1,
+                           std::ref(overflowed));
+
+      while (!overflowed.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+
+      for (int i = 0; i < FRAMES_PER_ROUND; i++) {
+        {
+          Profiling::TimeScope ts(frame);
+        }
+
+        Profiling::end_frame();
+      }
+
+      for (auto& worker : workers) {
+        worker.join();
+      }
+
+      // Collects what the workers recorded after the last frame
+      Profiling::end_frame();
+    }
+  });
+
+  const unsigned long long jobs = Profiling::get_statistics("Job", false, false).get_count();
+  const unsigned long long bursts = Profiling::get_statistics("Burst", false, false).get_count();
+  const unsigned long long frames = Profiling::get_statistics("Frame", false, false).get_count();
+
+  std::cout << NUM_ROUNDS << " rounds of " << NUM_WORKERS << " threads: " << total_ms
+            << " ms, " << jobs << " jobs, " << bursts << " of "
+            << NUM_ROUNDS * OVERFLOW_SCOPES << " overflowing scopes kept" << std::endl;
+
+  const std::string trace = read_file("logs/trace_" + std::to_string(TRACE_FIRST_FRAME) +
+                                      ".json");
+
+  int failures = 0;
+  failures += check(jobs == static_cast<unsigned long long>(NUM_ROUNDS) * (NUM_WORKERS - 1) *
+                            WORKER_JOBS, "every job of the workers within capacity is timed");
+  failures += check(bursts >= static_cast<unsigned long long>(NUM_ROUNDS) *
+                               (Profiling::EventBuffer::CAPACITY / 2 - 1),
+                    "an overflowing buffer keeps what fits");
+  failures += check(bursts < static_cast<unsigned long long>(NUM_ROUNDS) * OVERFLOW_SCOPES,
+                    "an overflowing buffer drops what doesn't fit");
+  failures += check(frames == NUM_ROUNDS * FRAMES_PER_ROUND, "every frame scope is timed");
+  failures += check(trace.rfind("\n]\n") == trace.size() - 3, "the trace is closed");
+  failures += check(trace.find("\"Worker ") != std::string::npos &&
+                    trace.find("\"Job\"") != std::string::npos,
+                    "the trace has the workers' scopes");
+  return failures;
+}
@@ -0,0 +1,202 @@
+#include "bench.h"
+#include "util/profiling/statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+constexpr int NUM_SAMPLES = 100000;
+// Percentiles are the geometric middle of a bucket a quarter of a power of two wide
+constexpr double PERCENTILE_TOLERANCE = 0.1;
+constexpr double FRACTIONS[] = { 0.5, 0.9, 0.99, 0.999 };
+
+static bool near(double value, double expected, double tolerance)
+{
+  return std::abs(value - expected) <= tolerance * std::abs(expected);
+}
+
+static Profiling::Statistics add_all(const std::vector<double>& times)
+{
+  Profiling::Statistics statistics;
+
+  for (const double time : times) {
+    statistics.add(time);
+  }
+
+  return statistics;
+}
+
+// Times from 1 us to 1 ms, the percentiles and moments of which are known
+static int check_uniform()
+{
+  std::mt19937 generator(1);
+  std::uniform_real_distribution<double> distribution(1e3, 1e6);
+  std::vector<double> times(NUM_SAMPLES);
+
+  for (auto& time : times) {
+    time = distribution(generator);
+  }
+
+  const Profiling::Statistics statistics = add_all(times);
+  const double mean = (1e3 + 1e6) / 2.0;
+  const double variance = (1e6 - 1e3) * (1e6 - 1e3) / 12.0;
+
+  int failures = 0;
+  failures += check(statistics.get_count() == NUM_SAMPLES, "uniform count");
+  failures += check(near(statistics.get_mean(), mean, 0.01), "uniform mean");
+  failures += check(near(statistics.get_variance(), variance, 0.02), "uniform variance");
+
+  for (const double fraction : FRACTIONS) {
+    failures += check(near(statistics.get_percentile(fraction), 1e3 + fraction * (1e6 - 1e3),
+                           PERCENTILE_TOLERANCE), "uniform percentile");
+  }
+
+  return failures;
+}
+
+// Skewed like frame times, with a long tail
+static int check_exponential()
+{
+  constexpr double MEAN = 5e4;
+
+  std::mt19937 generator(2);
+  std::exponential_distribution<double> distribution(1.0 / MEAN);
+  std::vector<double> times(NUM_SAMPLES);
+
+  for (auto& time : times) {
+    time = distribution(generator);
+  }
+
+  const Profiling::Statistics statistics = add_all(times);
+
+  int failures = 0;
+  failures += check(near(statistics.get_mean(), MEAN, 0.02), "exponential mean");
+  failures += check(near(statistics.get_variance(), MEAN * MEAN, 0.05), "exponential variance");
+
+  // The 99.9th percentile only has a hundred samples above it
+  for (const double fraction : { 0.5, 0.9, 0.99 }) {
+    failures += check(near(statistics.get_percentile(fraction), -std::log(1.0 - fraction) * MEAN,
+                           PERCENTILE_TOLERANCE), "exponential percentile");
+  }
+
+  return failures;
+}
+
+// Without spread every percentile is the time itself, under 1 ns too
+static int check_constant()
+{
+  int failures = 0;
+
+  for (const double time : { 0.5, 700.0 }) {
+    const Profiling::Statistics statistics = add_all(std::vector<double>(1000, time));
+    failures += check(statistics.get_variance() == 0.0, "constant variance");
+
+    for (const double fraction : FRACTIONS) {
+      failures += check(statistics.get_percentile(fraction) == time, "constant percentile");
+    }
+  }
+
+  failures += check(Profiling::Statistics().get_percentile(0.5) == 0.0, "empty percentile");
+  return failures;
+}
+
+// Merging the statistics of parts of a stream gives those of the whole stream
+static int check_merge()
+{
+  std::mt19937 generator(3);
+  std::lognormal_distribution<double> distribution(8.0, 1.5);
+  std::vector<double> times(NUM_SAMPLES);
+
+  for (auto& time : times) {
+    time = distribution(generator);
+  }
+
+  const Profiling::Statistics whole = add_all(times);
+  // Uneven parts with different means, so the pairwise update matters
+  const std::vector<double> first(times.begin(), times.begin() + NUM_SAMPLES / 7);
+  std::vector<double> second(times.begin() + NUM_SAMPLES / 7, times.end());
+  std::sort(second.begin(), second.end());
+  const std::vector<double> low(second.begin(), second.begin() + NUM_SAMPLES / 2);
+  const std::vector<double> high(second.begin() + NUM_SAMPLES / 2, second.end());
+
+  Profiling::Statistics merged = add_all(first);
+  merged.merge(add_all(low));
+  merged.merge(add_all(high));
+  merged.merge(Profiling::Statistics());
+
+  const auto a = whole.summarize();
+  const auto b = merged.summarize();
+
+  int failures = 0;
+  failures += check(a.count == b.count, "merged count");
+  failures += check(near(a.mean, b.mean, 1e-9), "merged mean");
+  failures += check(near(a.deviation, b.deviation, 1e-9), "merged deviation");
+  failures += check(a.min == b.min && a.max == b.max, "merged min and max");
+  failures += check(a.p50 == b.p50 && a.p90 == b.p90 && a.p99 == b.p99 && a.p999 == b.p999,
+                    "merged percentiles");
+  return failures;
+}
+
+// The window keeps the newest sub-windows whole and drops the oldest
+static int check_rolling()
+{
+  constexpr auto SAMPLES = Profiling::RollingStatistics::WINDOW_SAMPLES;
+  constexpr auto NUM_WINDOWS = Profiling::RollingStatistics::NUM_WINDOWS;
+  constexpr unsigned long long NUM_TIMES = 5 * SAMPLES * NUM_WINDOWS + SAMPLES / 2;
+
+  Profiling::RollingStatistics rolling;
+
+  for (unsigned long long i = 0; i < NUM_TIMES; i++) {
+    rolling.add(static_cast<double>(i));
+  }
+
+  const Profiling::Statistics window = rolling.get_window();
+  const Profiling::Statistics::Summary summary = window.summarize();
+
+  int failures = 0;
+  failures += check(rolling.get_total().get_count() == NUM_TIMES, "rolling total count");
+  failures += check(summary.count == (NUM_WINDOWS - 1) * SAMPLES + SAMPLES / 2,
+                    "rolling window count");
+  failures += check(summary.min == static_cast<double>(NUM_TIMES - summary.count) &&
+                    summary.max == static_cast<double>(NUM_TIMES - 1),
+                    "rolling window holds the newest times");
+  failures += check(near(summary.mean, static_cast<double>(NUM_TIMES) -
+                                       (static_cast<double>(summary.count) + 1.0) / 2.0, 1e-9),
+                    "rolling window mean");
+  return failures;
+}
+
+int main()
+{
+  int failures = 0;
+  failures += check_uniform();
+  failures += check_exponential();
+  failures += check_constant();
+  failures += check_merge();
+  failures += check_rolling();
+
+  std::vector<double> times(NUM_SAMPLES);
+  std::mt19937 generator(4);
+  std::exponential_distribution<double> distribution(1e-4);
+
+  for (auto& time : times) {
+    time = distribution(generator);
+  }
+
+  Profiling::RollingStatistics rolling;
+  const double add_ms = time_ms(10, [&] {
+    for (const double time : times) {
+      rolling.add(time);
+    }
+  });
+
+  Profiling::Statistics window;
+  const double window_ms = time_ms(1000, [&] { window = rolling.get_window(); });
+
+  std::cout << "Rolling add: " << add_ms * 1e6 / NUM_SAMPLES << " ns, window: "
+            << window_ms * 1e3 << " us, p99 "
+            << window.get_percentile(0.99) << " ns" << std::endl;
+
+  return failures;
+}
@@ -37,11 +37,11 @@ layout (std140, binding = 2) uniform Lights {
     int num_point_lights;
 };
 
-layout (std140, binding = 3) buffer DirLights {
+layout (std430, binding = 3) buffer DirLights {
     DirLight dir_light[];
 };
 
-layout (std140, binding = 4) buffer PointLights {
+layout (std430, binding = 4) buffer PointLights {
     PointLight point_light[];
 };
 
@@ -0,0 +1,56 @@
+# version 450 core
+out vec4 frag_color;
+
+in vec2 texture_coords;
+
+uniform sampler2D source1;
+
+uniform bool prefilter;
+uniform float threshold;
+uniform float knee;
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Quadratic ramp from threshold - knee to threshold + knee, linear above
+vec3 soft_threshold(vec3 color) {
+    float brightness = luminance(color);
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.0001);
+
+    return color * max(soft, brightness - threshold) / max(brightness, 0.0001);
+}
+
+void main()
+{
+    // A destination texel covers 2x2 source texels, so the center tap averages them and the
+    // corner taps each average a neighbouring 2x2 block
+    const vec2 texel = 1.0 / vec2(textureSize(source1, 0));
+    vec3 taps[5] = vec3[] (
+        texture(source1, texture_coords).rgb,
+        texture(source1, texture_coords + texel * vec2(-1.0, -1.0)).rgb,
+        texture(source1, texture_coords + texel * vec2( 1.0, -1.0)).rgb,
+        texture(source1, texture_coords + texel * vec2(-1.0,  1.0)).rgb,
+        texture(source1, texture_coords + texel * vec2( 1.0,  1.0)).rgb
+    );
+    const float weights[5] = float[] (0.5, 0.125, 0.125, 0.125, 0.125);
+
+    vec3 color = vec3(0.0);
+    float total_weight = 0.0;
+
+    for (int i = 0; i < 5; i++) {
+        float weight = weights[i];
+
+        // Weighting by inverse luminance stops single bright pixels from flickering
+        if (prefilter) {
+            taps[i] = soft_threshold(taps[i]);
+            weight /= 1.0 + luminance(taps[i]);
+        }
+
+        color += taps[i] * weight;
+        total_weight += weight;
+    }
+
+    frag_color = vec4(color / total_weight, 1.0);
+}
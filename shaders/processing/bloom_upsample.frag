@@ -0,0 +1,25 @@
+# version 450 core
+out vec4 frag_color;
+
+in vec2 texture_coords;
+
+uniform sampler2D source1;
+
+void main()
+{
+    // 3x3 tent over the smaller level, added onto the larger one by blending
+    const vec2 texel = 1.0 / vec2(textureSize(source1, 0));
+    vec3 color = texture(source1, texture_coords).rgb * 4.0;
+
+    color += texture(source1, texture_coords + texel * vec2(-1.0,  0.0)).rgb * 2.0;
+    color += texture(source1, texture_coords + texel * vec2( 1.0,  0.0)).rgb * 2.0;
+    color += texture(source1, texture_coords + texel * vec2( 0.0, -1.0)).rgb * 2.0;
+    color += texture(source1, texture_coords + texel * vec2( 0.0,  1.0)).rgb * 2.0;
+
+    color += texture(source1, texture_coords + texel * vec2(-1.0, -1.0)).rgb;
+    color += texture(source1, texture_coords + texel * vec2( 1.0, -1.0)).rgb;
+    color += texture(source1, texture_coords + texel * vec2(-1.0,  1.0)).rgb;
+    color += texture(source1, texture_coords + texel * vec2( 1.0,  1.0)).rgb;
+
+    frag_color = vec4(color / 16.0, 1.0);
+}
@@ -0,0 +1,63 @@
+# version 450 core
+out vec4 frag_color;
+
+in vec2 texture_coords;
+
+// Every EFFECT_ define is set to 0 or 1 by PostComposer
+uniform sampler2D hdr;
+uniform sampler2D bloom;
+uniform sampler3D lut;
+
+// Fraction of the targets rendered to this frame and its size in pixels, see DynamicResolution
+layout (std140, binding = 14) uniform Viewport {
+    vec2 viewport_scale;
+    vec2 viewport_size;
+};
+
+uniform float bloom_strength;
+uniform float exposure;
+uniform float vignette;
+uniform float gamma;
+
+vec3 reinhard_tone_mapping(vec3 color) {
+    return color / (color + vec3(1.0));
+}
+
+// Samples at texel centers so the ends of the range map to the ends of the LUT
+vec3 color_grade(vec3 color) {
+    const float size = float(textureSize(lut, 0).x);
+    return texture(lut, clamp(color, 0.0, 1.0) * (size - 1.0) / size + 0.5 / size).rgb;
+}
+
+void main()
+{
+    // Upscales from the rendered part of the target to the window
+    vec3 color = texture(hdr, texture_coords).rgb;
+
+#if EFFECT_BLOOM
+    color += texture(bloom, texture_coords).rgb * bloom_strength;
+#endif
+
+#if EFFECT_EXPOSURE
+    color *= exposure;
+#endif
+
+#if EFFECT_TONEMAP
+    color = reinhard_tone_mapping(color);
+#endif
+
+#if EFFECT_COLOR_GRADING
+    color = color_grade(color);
+#endif
+
+#if EFFECT_VIGNETTE
+    const vec2 offset = texture_coords / viewport_scale - 0.5;
+    color *= 1.0 - vignette * smoothstep(0.2, 0.8, dot(offset, offset) * 2.0);
+#endif
+
+#if EFFECT_GAMMA
+    color = pow(max(color, 0.0), vec3(1.0 / gamma));
+#endif
+
+    frag_color = vec4(color, 1.0);
+}
@@ -5,13 +5,20 @@ layout (location = 1) out vec4 bright_color;
 
 in vec2 texture_coords;
 
+// GBUFFER_COMPACT is defined by GBuffer to match its layout
+#if GBUFFER_COMPACT
+uniform sampler2D texture_screen1;
+uniform sampler2D texture_screen2;
+uniform sampler2D texture_depth1;
+#else
 uniform sampler2D texture_screen1;
 uniform sampler2D texture_screen2;
 uniform sampler2D texture_screen3;
 uniform sampler2D texture_screen4;
 uniform sampler2D texture_screen5;
 uniform sampler2D texture_screen6;
-uniform samplerCube shadow_map;
+#endif
+uniform sampler2DArray dir_shadow_map;
 
 struct DirLight {
     vec3 direction;
@@ -28,24 +35,52 @@ struct PointLight {
     vec3 attenuation;
 };
 
+layout (std140, binding = 0) uniform Matrices {
+    mat4 perspective;
+    mat4 view;
+    mat4 inverse_view_projection;
+};
+
+// Fraction of the targets rendered to this frame and its size in pixels, see DynamicResolution
+layout (std140, binding = 14) uniform Viewport {
+    vec2 viewport_scale;
+    vec2 viewport_size;
+};
+
 layout (std140, binding = 2) uniform Lights {
     vec3 view_position;
     int num_dir_lights;
     int num_point_lights;
 };
 
-layout (std140, binding = 3) buffer DirLights {
+layout (std430, binding = 3) buffer DirLights {
     DirLight dir_light[];
 };
 
-layout (std140, binding = 4) buffer PointLights {
+layout (std430, binding = 4) buffer PointLights {
     PointLight point_light[];
 };
 
-layout (std140, binding = 9) uniform PointShadow {
-    mat4 shadow_matrices[6];
-    vec3 light_position;
-    float far_plane;
+// x, y and z cluster counts, then the near plane and log(far / near) of the depth slices
+layout (std140, binding = 5) uniform Clusters {
+    uvec4 cluster_grid;
+    vec2 cluster_depth;
+};
+
+// Offset and count of every cluster's range in light_index
+layout (std430, binding = 5) buffer ClusterGrid {
+    uvec2 cluster[];
+};
+
+layout (std430, binding = 6) buffer ClusterLights {
+    uint light_index[];
+};
+
+// Cascaded shadow map of the first directional light, see DirectionalShadow
+layout (std140, binding = 8) uniform DirectionalShadow {
+    mat4 light_space[4];
+    vec4 cascade_far_planes;
+    int num_cascades;
 };
 
 vec3 calc_point_light(PointLight light, vec3 normal, vec3 light_pos, vec3 frag_position, vec3 eye_direction,
@@ -65,33 +100,103 @@ vec3 calc_point_light(PointLight light, vec3 normal, vec3 light_pos, vec3 frag_p
     return (ambient + (1 - shadow) * (diffuse + specular)) / attenuation;
 }
 
-float calc_shadow(PointLight light, vec3 position, vec3 normal) {
-    vec3 light_ray = position - light.position;
-    float current_depth = length(light_ray);
-
-    float bias = 0.1;
-    const int samples = 20;
-    float disk_radius = (1.0 + distance(view_position, position) / far_plane) / 25.0;
-    float shadow = 0;
-
-    const vec3 sample_offset_dirs[samples] = vec3[]
-    (
-       vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1),
-       vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
-       vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
-       vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
-       vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
-    );
-
-    for (int i = 0; i < samples; i++) {
-        float closest_depth =
-                texture(shadow_map, light_ray + sample_offset_dirs[i] * disk_radius).r * far_plane;
-        if (current_depth - bias > closest_depth) {
-            shadow += 1;
+vec3 calc_dir_light(DirLight light, vec3 normal, vec3 light_direction, vec3 eye_direction,
+                    vec3 diffuse_texture, vec3 specular_texture, float shadow) {
+    vec3 half_vec = normalize(eye_direction + light_direction);
+
+    vec3 ambient = light.ambient * diffuse_texture;
+    vec3 diffuse = light.diffuse * diffuse_texture * max(dot(normal, light_direction), 0.0);
+    vec3 specular = light.specular * specular_texture *
+                    pow(max(dot(normal, half_vec), 0.0), 32);
+
+    return ambient + (1 - shadow) * (diffuse + specular);
+}
+
+float calc_dir_shadow(vec3 position, float depth) {
+    int cascade = 0;
+    while (cascade < num_cascades - 1 && depth > cascade_far_planes[cascade]) {
+        cascade++;
+    }
+
+    if (depth > cascade_far_planes[num_cascades - 1]) {
+        return 0.0;
+    }
+
+    vec4 light_position = light_space[cascade] * vec4(position, 1.0);
+    vec3 coords = light_position.xyz / light_position.w * 0.5 + 0.5;
+
+    if (coords.z > 1.0) {
+        return 0.0;
+    }
+
+    float bias = 0.002;
+    vec2 texel_size = 1.0 / vec2(textureSize(dir_shadow_map, 0).xy);
+    float shadow = 0.0;
+
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            float closest_depth = texture(dir_shadow_map,
+                                          vec3(coords.xy + vec2(x, y) * texel_size, cascade)).r;
+            if (coords.z - bias > closest_depth) {
+                shadow += 1.0;
+            }
         }
     }
 
-    return shadow / float(samples);
+    return shadow / 9.0;
+}
+
+uvec2 find_cluster(vec3 position) {
+    float depth = -(view * vec4(position, 1.0)).z;
+    uint slice = uint(clamp(log(depth / cluster_depth.x) / cluster_depth.y * float(cluster_grid.z),
+                            0.0, float(cluster_grid.z - 1)));
+    uvec2 tile = min(uvec2(texture_coords * vec2(cluster_grid.xy)), cluster_grid.xy - 1);
+
+    return cluster[(slice * cluster_grid.y + tile.y) * cluster_grid.x + tile.x];
+}
+
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+vec3 octahedral_decode(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 v = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-v.z, 0.0);
+    v.x += v.x >= 0.0 ? -fold : fold;
+    v.y += v.y >= 0.0 ? -fold : fold;
+    return normalize(v);
+}
+
+// World space surface at a pixel of the G-buffer
+Surface read_gbuffer(ivec2 pixel) {
+    Surface surface;
+
+#if GBUFFER_COMPACT
+    float depth = texelFetch(texture_depth1, pixel, 0).r;
+    vec2 ndc = (vec2(pixel) + 0.5) / viewport_size * 2.0 - 1.0;
+    vec4 position = inverse_view_projection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+
+    surface.position = position.xyz / position.w;
+    surface.normal = octahedral_decode(texelFetch(texture_screen1, pixel, 0).rg);
+    vec4 diffuse_spec = texelFetch(texture_screen2, pixel, 0);
+#else
+    vec3 t = texelFetch(texture_screen4, pixel, 0).rgb;
+    vec3 b = texelFetch(texture_screen5, pixel, 0).rgb;
+    vec3 n = texelFetch(texture_screen6, pixel, 0).rgb;
+
+    surface.position = texelFetch(texture_screen1, pixel, 0).rgb;
+    surface.normal = mat3(t, b, n) * texelFetch(texture_screen2, pixel, 0).rgb;
+    vec4 diffuse_spec = texelFetch(texture_screen3, pixel, 0);
+#endif
+
+    surface.diffuse = diffuse_spec.rgb;
+    surface.specular = diffuse_spec.aaa;
+
+    return surface;
 }
 
 vec3 filter_bright_colors(vec3 color) {
@@ -104,32 +209,31 @@ vec3 filter_bright_colors(vec3 color) {
 
 void main()
 {
-    vec3 position = texture(texture_screen1, texture_coords).rgb;
-    vec3 normal = texture(texture_screen2, texture_coords).rgb;
-    vec3 diffuse = texture(texture_screen3, texture_coords).rgb;
-    vec3 specular = texture(texture_screen3, texture_coords).aaa;
-    vec3 t = texture(texture_screen4, texture_coords).rgb;
-    vec3 b = texture(texture_screen5, texture_coords).rgb;
-    vec3 n = texture(texture_screen6, texture_coords).rgb;
-    mat3 tbn = transpose(mat3(t, b, n));
-    vec3 tangent_view_pos = tbn * view_position;
-    vec3 tangent_frag_pos = tbn * position;
-    vec3 eye_direction = normalize(tangent_view_pos - tangent_frag_pos);
+    // Lighting is done in world space, which the tangent frame of the wide layout maps to
+    Surface surface = read_gbuffer(ivec2(gl_FragCoord.xy));
+    vec3 position = surface.position;
+    vec3 eye_direction = normalize(view_position - position);
 
-    float shadow = 0.0;
+    vec3 color = vec3(0.0);
 
-//    for (int i = 0; i < num_point_lights; i++) {
-//        shadow += calc_shadow(point_light[i], position, normal);
-//    }
-    shadow = clamp(shadow, 0.0, 1.0);
+    for (int i = 0; i < num_dir_lights; i++) {
+        float shadow = i == 0 ? calc_dir_shadow(position, -(view * vec4(position, 1.0)).z) : 0.0;
+        color += calc_dir_light(dir_light[i], surface.normal, normalize(-dir_light[i].direction),
+                                eye_direction, surface.diffuse, surface.specular, shadow);
+    }
 
-    vec3 color = vec3(0.0);
+    // Light volumes add the point lights on top, see GBuffer::draw_dir_lights
+#ifndef DIR_LIGHTS_ONLY
+    uvec2 cluster_range = find_cluster(position);
 
-    for (int i = 0; i < num_point_lights; i++) {
-        vec3 tangent_light_pos = tbn * point_light[i].position;
-        color += calc_point_light(point_light[i], normal, tangent_light_pos, tangent_frag_pos,
-                                  eye_direction, diffuse, specular, shadow);
+    for (uint i = cluster_range.x; i < cluster_range.x + cluster_range.y; i++) {
+        PointLight light = point_light[light_index[i]];
+        float shadow = calc_shadow(light_index[i], light.position, position, view_position,
+                                   gl_FragCoord.xy);
+        color += calc_point_light(light, surface.normal, light.position, position,
+                                  eye_direction, surface.diffuse, surface.specular, shadow);
     }
+#endif
 
     frag_color = vec4(color, 1.0);
     bright_color = vec4(filter_bright_colors(color), 1.0);
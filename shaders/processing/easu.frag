@@ -0,0 +1,131 @@
+# version 450 core
+out vec4 frag_color;
+
+// Edge adaptive upscaling in the style of FSR1's EASU. Every output pixel reads the 12 texels
+// around its position in the source, estimates the edge direction from their luma, and
+// filters with a Lanczos-like kernel stretched along the edge, clamped to the nearest four
+// texels to avoid ringing.
+uniform sampler2D source;
+// Part of the source that was rendered, the output covers the whole viewport
+uniform vec2 input_size;
+uniform vec2 output_size;
+// Display encoded input is already perceptual, linear input is approximated with gamma 2
+uniform bool encoded;
+
+vec3 fetch(ivec2 pixel) {
+    vec3 color = texelFetch(source, clamp(pixel, ivec2(0), ivec2(input_size) - 1), 0).rgb;
+    return encoded ? color : sqrt(max(color, 0.0));
+}
+
+float luma(vec3 color) {
+    return color.b * 0.5 + (color.r * 0.5 + color.g);
+}
+
+// Accumulates the direction and length of the edge seen by one of the four bilinear corners,
+// from its horizontal (b, c, d) and vertical (a, c, e) neighbours
+void edge(inout vec2 direction, inout float edge_length, float weight,
+          float a, float b, float c, float d, float e) {
+    float dc = d - c;
+    float cb = c - b;
+    float length_x = max(abs(dc), abs(cb));
+    float direction_x = d - b;
+    length_x = clamp(abs(direction_x) / max(length_x, 1e-5), 0.0, 1.0);
+    direction.x += direction_x * weight;
+    edge_length += length_x * length_x * weight;
+
+    float ec = e - c;
+    float ca = c - a;
+    float length_y = max(abs(ec), abs(ca));
+    float direction_y = e - a;
+    length_y = clamp(abs(direction_y) / max(length_y, 1e-5), 0.0, 1.0);
+    direction.y += direction_y * weight;
+    edge_length += length_y * length_y * weight;
+}
+
+void tap(inout vec3 color, inout float total, vec2 offset, vec2 direction, vec2 stretch,
+         float lobe, float clip, vec3 texel) {
+    // Rotate into the edge's frame and scale the kernel along and across it
+    vec2 v = vec2(dot(offset, direction), dot(offset, vec2(-direction.y, direction.x))) * stretch;
+    float d2 = min(dot(v, v), clip);
+
+    // Polynomial approximation of windowed Lanczos 2
+    float base = 2.0 / 5.0 * d2 - 1.0;
+    float window = lobe * d2 - 1.0;
+    base *= base;
+    window *= window;
+    base = 25.0 / 16.0 * base - (25.0 / 16.0 - 1.0);
+    float weight = base * window;
+
+    color += texel * weight;
+    total += weight;
+}
+
+void main()
+{
+    vec2 position = gl_FragCoord.xy * input_size / output_size - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+
+    //    b c
+    //  e f g h
+    //  i j k l
+    //    n o
+    vec3 b = fetch(base + ivec2(0, -1));
+    vec3 c = fetch(base + ivec2(1, -1));
+    vec3 e = fetch(base + ivec2(-1, 0));
+    vec3 ff = fetch(base);
+    vec3 g = fetch(base + ivec2(1, 0));
+    vec3 h = fetch(base + ivec2(2, 0));
+    vec3 i = fetch(base + ivec2(-1, 1));
+    vec3 j = fetch(base + ivec2(0, 1));
+    vec3 k = fetch(base + ivec2(1, 1));
+    vec3 l = fetch(base + ivec2(2, 1));
+    vec3 n = fetch(base + ivec2(0, 2));
+    vec3 o = fetch(base + ivec2(1, 2));
+
+    float lb = luma(b), lc = luma(c), le = luma(e), lf = luma(ff), lg = luma(g), lh = luma(h);
+    float li = luma(i), lj = luma(j), lk = luma(k), ll = luma(l), ln = luma(n), lo = luma(o);
+
+    vec2 direction = vec2(0.0);
+    float edge_length = 0.0;
+    edge(direction, edge_length, (1.0 - f.x) * (1.0 - f.y), lb, le, lf, lg, lj);
+    edge(direction, edge_length, f.x * (1.0 - f.y), lc, lf, lg, lh, lk);
+    edge(direction, edge_length, (1.0 - f.x) * f.y, lf, li, lj, lk, ln);
+    edge(direction, edge_length, f.x * f.y, lg, lj, lk, ll, lo);
+
+    // Flat areas have no direction, filter them axis aligned
+    float direction_length = dot(direction, direction);
+    direction = direction_length < 1.0 / 32768.0 ? vec2(1.0, 0.0)
+                                                 : direction * inversesqrt(direction_length);
+
+    edge_length *= 0.5;
+    edge_length *= edge_length;
+
+    // Diagonal edges get a kernel stretched to the square's diagonal
+    float stretch = dot(direction, direction) / max(abs(direction.x), abs(direction.y));
+    vec2 kernel = vec2(1.0 + (stretch - 1.0) * edge_length, 1.0 - 0.5 * edge_length);
+    // Sharper lobes along stronger edges
+    float lobe = 0.5 + ((1.0 / 4.0 - 0.04) - 0.5) * edge_length;
+    float clip = 1.0 / lobe;
+
+    vec3 color = vec3(0.0);
+    float total = 0.0;
+    tap(color, total, vec2(0.0, -1.0) - f, direction, kernel, lobe, clip, b);
+    tap(color, total, vec2(1.0, -1.0) - f, direction, kernel, lobe, clip, c);
+    tap(color, total, vec2(-1.0, 1.0) - f, direction, kernel, lobe, clip, i);
+    tap(color, total, vec2(0.0, 1.0) - f, direction, kernel, lobe, clip, j);
+    tap(color, total, vec2(0.0, 0.0) - f, direction, kernel, lobe, clip, ff);
+    tap(color, total, vec2(-1.0, 0.0) - f, direction, kernel, lobe, clip, e);
+    tap(color, total, vec2(1.0, 1.0) - f, direction, kernel, lobe, clip, k);
+    tap(color, total, vec2(2.0, 1.0) - f, direction, kernel, lobe, clip, l);
+    tap(color, total, vec2(2.0, 0.0) - f, direction, kernel, lobe, clip, h);
+    tap(color, total, vec2(1.0, 0.0) - f, direction, kernel, lobe, clip, g);
+    tap(color, total, vec2(1.0, 2.0) - f, direction, kernel, lobe, clip, o);
+    tap(color, total, vec2(0.0, 2.0) - f, direction, kernel, lobe, clip, n);
+
+    vec3 lowest = min(min(ff, g), min(j, k));
+    vec3 highest = max(max(ff, g), max(j, k));
+    color = clamp(color / total, lowest, highest);
+
+    frag_color = vec4(encoded ? color : color * color, 1.0);
+}
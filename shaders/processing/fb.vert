@@ -5,8 +5,14 @@ layout (location = 1) in vec2 in_texture_coords;
 
 out vec2 texture_coords;
 
+// Fraction of the targets rendered to this frame and its size in pixels, see DynamicResolution
+layout (std140, binding = 14) uniform Viewport {
+    vec2 viewport_scale;
+    vec2 viewport_size;
+};
+
 void main()
 {
     gl_Position = vec4(in_position.xy, 0.0, 1.0);
-    texture_coords = in_texture_coords;
+    texture_coords = in_texture_coords * viewport_scale;
 }
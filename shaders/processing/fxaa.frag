@@ -0,0 +1,162 @@
+# version 450 core
+out vec4 frag_color;
+
+in vec2 texture_coords;
+
+// Fast approximate anti-aliasing in the style of FXAA 3.11's quality preset. Edges are found
+// from the contrast in luma around the pixel, followed along to where they end, and the
+// pixel is blended across the edge by how close it is to the nearer end.
+uniform sampler2D source;
+// Linear sources are measured in perceptual luma, the sRGB framebuffer encodes the result
+uniform bool encoded;
+
+// Fraction of the targets rendered to this frame and its size in pixels, see DynamicResolution
+layout (std140, binding = 14) uniform Viewport {
+    vec2 viewport_scale;
+    vec2 viewport_size;
+};
+
+// Contrast below which nothing is done, absolute and relative to the brightest neighbour
+const float EDGE_THRESHOLD_MIN = 0.0312;
+const float EDGE_THRESHOLD_MAX = 0.125;
+// How much single pixel features are blended away
+const float SUBPIXEL_QUALITY = 0.75;
+const int SEARCH_STEPS = 10;
+const float SEARCH_STEP_SIZES[SEARCH_STEPS] = float[](1.0, 1.0, 1.0, 1.0, 1.0,
+                                                      1.5, 2.0, 2.0, 4.0, 8.0);
+
+vec2 texel_size;
+// Keeps taps inside the part of the source rendered to
+vec2 max_coords;
+
+vec3 sample_color(vec2 coords) {
+    return texture(source, min(coords, max_coords)).rgb;
+}
+
+float luma(vec3 color) {
+    float value = dot(color, vec3(0.299, 0.587, 0.114));
+    return encoded ? value : sqrt(value);
+}
+
+float sample_luma(vec2 coords) {
+    return luma(sample_color(coords));
+}
+
+float sample_luma(vec2 coords, vec2 offset) {
+    return sample_luma(coords + offset * texel_size);
+}
+
+void main()
+{
+    texel_size = 1.0 / vec2(textureSize(source, 0));
+    max_coords = viewport_scale - 0.5 * texel_size;
+
+    vec3 color = sample_color(texture_coords);
+    float center = luma(color);
+    float down = sample_luma(texture_coords, vec2(0.0, -1.0));
+    float up = sample_luma(texture_coords, vec2(0.0, 1.0));
+    float left = sample_luma(texture_coords, vec2(-1.0, 0.0));
+    float right = sample_luma(texture_coords, vec2(1.0, 0.0));
+
+    float luma_min = min(center, min(min(down, up), min(left, right)));
+    float luma_max = max(center, max(max(down, up), max(left, right)));
+    float range = luma_max - luma_min;
+
+    if (range < max(EDGE_THRESHOLD_MIN, luma_max * EDGE_THRESHOLD_MAX)) {
+        frag_color = vec4(color, 1.0);
+        return;
+    }
+
+    float down_left = sample_luma(texture_coords, vec2(-1.0, -1.0));
+    float up_right = sample_luma(texture_coords, vec2(1.0, 1.0));
+    float up_left = sample_luma(texture_coords, vec2(-1.0, 1.0));
+    float down_right = sample_luma(texture_coords, vec2(1.0, -1.0));
+
+    float down_up = down + up;
+    float left_right = left + right;
+    float left_corners = down_left + up_left;
+    float down_corners = down_left + down_right;
+    float right_corners = down_right + up_right;
+    float up_corners = up_right + up_left;
+
+    // Second differences across rows and columns tell which way the edge runs
+    float edge_horizontal = abs(-2.0 * left + left_corners) +
+                            abs(-2.0 * center + down_up) * 2.0 +
+                            abs(-2.0 * right + right_corners);
+    float edge_vertical = abs(-2.0 * up + up_corners) +
+                          abs(-2.0 * center + left_right) * 2.0 +
+                          abs(-2.0 * down + down_corners);
+    bool horizontal = edge_horizontal >= edge_vertical;
+
+    // The side of the pixel the edge is on is the one with the steeper gradient
+    float luma1 = horizontal ? down : left;
+    float luma2 = horizontal ? up : right;
+    float gradient1 = luma1 - center;
+    float gradient2 = luma2 - center;
+    bool steepest1 = abs(gradient1) >= abs(gradient2);
+    float gradient_scaled = 0.25 * max(abs(gradient1), abs(gradient2));
+
+    float step_length = horizontal ? texel_size.y : texel_size.x;
+    float luma_local_average;
+
+    if (steepest1) {
+        step_length = -step_length;
+        luma_local_average = 0.5 * (luma1 + center);
+    } else {
+        luma_local_average = 0.5 * (luma2 + center);
+    }
+
+    // Walks both ways along the middle of the edge until the luma leaves it
+    vec2 edge_coords = texture_coords;
+    if (horizontal) {
+        edge_coords.y += step_length * 0.5;
+    } else {
+        edge_coords.x += step_length * 0.5;
+    }
+
+    vec2 offset = horizontal ? vec2(texel_size.x, 0.0) : vec2(0.0, texel_size.y);
+    vec2 coords1 = edge_coords - offset;
+    vec2 coords2 = edge_coords + offset;
+    float luma_end1 = sample_luma(coords1) - luma_local_average;
+    float luma_end2 = sample_luma(coords2) - luma_local_average;
+    bool reached1 = abs(luma_end1) >= gradient_scaled;
+    bool reached2 = abs(luma_end2) >= gradient_scaled;
+
+    for (int i = 1; i < SEARCH_STEPS && !(reached1 && reached2); i++) {
+        if (!reached1) {
+            coords1 -= offset * SEARCH_STEP_SIZES[i];
+            luma_end1 = sample_luma(coords1) - luma_local_average;
+            reached1 = abs(luma_end1) >= gradient_scaled;
+        }
+
+        if (!reached2) {
+            coords2 += offset * SEARCH_STEP_SIZES[i];
+            luma_end2 = sample_luma(coords2) - luma_local_average;
+            reached2 = abs(luma_end2) >= gradient_scaled;
+        }
+    }
+
+    float distance1 = horizontal ? texture_coords.x - coords1.x : texture_coords.y - coords1.y;
+    float distance2 = horizontal ? coords2.x - texture_coords.x : coords2.y - texture_coords.y;
+    bool nearer1 = distance1 < distance2;
+    float pixel_offset = 0.5 - min(distance1, distance2) / (distance1 + distance2);
+
+    // Only blends when the nearer end goes the other way from the pixel
+    bool center_smaller = center < luma_local_average;
+    bool correct_variation = ((nearer1 ? luma_end1 : luma_end2) < 0.0) != center_smaller;
+    float final_offset = correct_variation ? pixel_offset : 0.0;
+
+    float luma_average = (2.0 * (down_up + left_right) + left_corners + right_corners) / 12.0;
+    float subpixel = clamp(abs(luma_average - center) / range, 0.0, 1.0);
+    subpixel = (-2.0 * subpixel + 3.0) * subpixel * subpixel;
+    final_offset = max(final_offset, subpixel * subpixel * SUBPIXEL_QUALITY);
+
+    vec2 final_coords = texture_coords;
+    if (horizontal) {
+        final_coords.y += final_offset * step_length;
+    } else {
+        final_coords.x += final_offset * step_length;
+    }
+
+    frag_color = vec4(sample_color(final_coords), 1.0);
+}
@@ -13,14 +13,24 @@ in V_DATA {
     vec3 n;
     vec3 tangent_view_pos;
     vec3 tangent_frag_pos;
+    vec4 current_clip;
+    vec4 previous_clip;
 } fs_in;
 
+// GBUFFER_COMPACT is defined by GBuffer to match its layout
+#if GBUFFER_COMPACT
+layout (location = 0) out vec4 packed_normal;
+layout (location = 1) out vec4 diffuse_spec;
+layout (location = 2) out vec2 velocity;
+#else
 layout (location = 0) out vec3 position;
 layout (location = 1) out vec3 normal;
 layout (location = 2) out vec4 diffuse_spec;
 layout (location = 3) out vec3 t;
 layout (location = 4) out vec3 b;
 layout (location = 5) out vec3 n;
+layout (location = 6) out vec2 velocity;
+#endif
 
 uniform bool gamma;
 uniform bool parallax;
@@ -55,6 +65,13 @@ vec2 parallax_mapping(vec2 texture_coords, vec3 eye_direction) {
     return mix(current_texture_coords, prev_texture_coords, weight);
 }
 
+// Maps a unit vector to the unit square through an octahedron
+vec2 octahedral_encode(vec3 v) {
+    v /= abs(v.x) + abs(v.y) + abs(v.z);
+    vec2 folded = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return (v.z >= 0.0 ? v.xy : folded) * 0.5 + 0.5;
+}
+
 void main() {
     vec2 texture_coords = fs_in.texture_coords;
 
@@ -63,18 +80,29 @@ void main() {
         texture_coords = parallax_mapping(fs_in.texture_coords, eye_direction);
     }
 
-    position = fs_in.position;
-    normal = texture(texture_normal1, texture_coords).rgb;
+    vec3 tangent_normal = texture(texture_normal1, texture_coords).rgb;
 
     if (gamma) {
-        normal = pow(normal, vec3(2.2));
+        tangent_normal = pow(tangent_normal, vec3(2.2));
     }
 
-    normal = normalize(normal * 2.0 - 1.0);
+    tangent_normal = normalize(tangent_normal * 2.0 - 1.0);
     diffuse_spec.rgb = texture(texture_diffuse1, texture_coords).rgb;
     diffuse_spec.a = texture(texture_specular1, texture_coords).r;
 
+    // In texture coordinates, from where the surface was last frame to where it is now
+    vec2 current_ndc = fs_in.current_clip.xy / fs_in.current_clip.w;
+    vec2 previous_ndc = fs_in.previous_clip.xy / fs_in.previous_clip.w;
+    velocity = (current_ndc - previous_ndc) * 0.5;
+
+#if GBUFFER_COMPACT
+    vec3 world_normal = normalize(mat3(fs_in.t, fs_in.b, fs_in.n) * tangent_normal);
+    packed_normal = vec4(octahedral_encode(world_normal), 0.0, 0.0);
+#else
+    position = fs_in.position;
+    normal = tangent_normal;
     t = fs_in.t;
     b = fs_in.b;
     n = fs_in.n;
+#endif
 }
@@ -23,6 +23,10 @@ struct PointLight {
 layout (std140, binding = 0) uniform Matrices {
     mat4 perspective;
     mat4 view;
+    mat4 inverse_view_projection;
+    // Without the anti-aliasing jitter, for motion vectors
+    mat4 unjittered_view_projection;
+    mat4 previous_view_projection;
 };
 
 layout (std430, binding = 1) buffer Model {
@@ -35,15 +39,18 @@ layout (std140, binding = 2) uniform Lights {
     int num_point_lights;
 };
 
-layout (std140, binding = 3) buffer DirLights {
+layout (std430, binding = 3) buffer DirLights {
     DirLight dir_light[];
 };
 
-layout (std140, binding = 4) buffer PointLights {
+layout (std430, binding = 4) buffer PointLights {
     PointLight point_light[];
 };
 
 uniform bool reverse_normal;
+// Set for draws that moved since the last frame, others only move with the camera
+uniform bool has_previous_model;
+uniform mat4 previous_model;
 
 out V_DATA {
     vec3 position;
@@ -53,6 +60,8 @@ out V_DATA {
     vec3 n;
     vec3 tangent_view_pos;
     vec3 tangent_frag_pos;
+    vec4 current_clip;
+    vec4 previous_clip;
 } vs_out;
 
 void main() {
@@ -71,5 +80,10 @@ void main() {
     vs_out.tangent_view_pos = tbn * view_position;
     vs_out.tangent_frag_pos = tbn * vs_out.position;
 
+    vec4 previous_position = has_previous_model ? previous_model * vec4(in_position, 1.0)
+                                                : vec4(vs_out.position, 1.0);
+    vs_out.current_clip = unjittered_view_projection * vec4(vs_out.position, 1.0);
+    vs_out.previous_clip = previous_view_projection * previous_position;
+
     gl_Position = perspective * view * model[gl_InstanceID] * vec4(in_position, 1.0);
 }
@@ -0,0 +1,159 @@
+# version 450 core
+
+layout (location = 0) out vec4 frag_color;
+layout (location = 1) out vec4 bright_color;
+
+flat in int light_id;
+
+// Intensity under which a light is considered to have no effect, matching Lights::get_radius
+const float MIN_INTENSITY = 5.0 / 256.0;
+
+// GBUFFER_COMPACT is defined by GBuffer to match its layout
+#if GBUFFER_COMPACT
+uniform sampler2D texture_screen1;
+uniform sampler2D texture_screen2;
+uniform sampler2D texture_depth1;
+#else
+uniform sampler2D texture_screen1;
+uniform sampler2D texture_screen2;
+uniform sampler2D texture_screen3;
+uniform sampler2D texture_screen4;
+uniform sampler2D texture_screen5;
+uniform sampler2D texture_screen6;
+#endif
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    vec3 attenuation;
+};
+
+layout (std140, binding = 0) uniform Matrices {
+    mat4 perspective;
+    mat4 view;
+    mat4 inverse_view_projection;
+};
+
+// Fraction of the targets rendered to this frame and its size in pixels, see DynamicResolution
+layout (std140, binding = 14) uniform Viewport {
+    vec2 viewport_scale;
+    vec2 viewport_size;
+};
+
+layout (std140, binding = 2) uniform Lights {
+    vec3 view_position;
+    int num_dir_lights;
+    int num_point_lights;
+};
+
+layout (std430, binding = 3) buffer DirLights {
+    DirLight dir_light[];
+};
+
+layout (std430, binding = 4) buffer PointLights {
+    PointLight point_light[];
+};
+
+vec3 calc_point_light(PointLight light, vec3 normal, vec3 light_pos, vec3 frag_position, vec3 eye_direction,
+                      vec3 diffuse_texture, vec3 specular_texture, float shadow) {
+    float light_distance = distance(light_pos, frag_position);
+    float attenuation = dot(light.attenuation,
+                            vec3(1.0, light_distance, light_distance * light_distance));
+
+    vec3 light_direction = normalize(light_pos - frag_position);
+    vec3 half_vec = normalize(eye_direction + light_direction);
+
+    vec3 ambient = light.ambient * diffuse_texture;
+    vec3 diffuse = light.diffuse * diffuse_texture * max(dot(normal, light_direction), 0.0);
+    vec3 specular = light.specular * specular_texture *
+                    pow(max(dot(normal, half_vec), 0.0), 32);
+
+    return (ambient + (1 - shadow) * (diffuse + specular)) / attenuation;
+}
+
+struct Surface {
+    vec3 position;
+    vec3 normal;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+vec3 octahedral_decode(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 v = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-v.z, 0.0);
+    v.x += v.x >= 0.0 ? -fold : fold;
+    v.y += v.y >= 0.0 ? -fold : fold;
+    return normalize(v);
+}
+
+// World space surface at a pixel of the G-buffer
+Surface read_gbuffer(ivec2 pixel) {
+    Surface surface;
+
+#if GBUFFER_COMPACT
+    float depth = texelFetch(texture_depth1, pixel, 0).r;
+    vec2 ndc = (vec2(pixel) + 0.5) / viewport_size * 2.0 - 1.0;
+    vec4 position = inverse_view_projection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+
+    surface.position = position.xyz / position.w;
+    surface.normal = octahedral_decode(texelFetch(texture_screen1, pixel, 0).rg);
+    vec4 diffuse_spec = texelFetch(texture_screen2, pixel, 0);
+#else
+    vec3 t = texelFetch(texture_screen4, pixel, 0).rgb;
+    vec3 b = texelFetch(texture_screen5, pixel, 0).rgb;
+    vec3 n = texelFetch(texture_screen6, pixel, 0).rgb;
+
+    surface.position = texelFetch(texture_screen1, pixel, 0).rgb;
+    surface.normal = mat3(t, b, n) * texelFetch(texture_screen2, pixel, 0).rgb;
+    vec4 diffuse_spec = texelFetch(texture_screen3, pixel, 0);
+#endif
+
+    surface.diffuse = diffuse_spec.rgb;
+    surface.specular = diffuse_spec.aaa;
+
+    return surface;
+}
+
+vec3 filter_bright_colors(vec3 color) {
+    if (dot(color, vec3(0.2126, 0.7152, 0.0722)) > 1.0) {
+        return color;
+    } else {
+        return vec3(0.0);
+    }
+}
+
+void main()
+{
+    Surface surface = read_gbuffer(ivec2(gl_FragCoord.xy));
+    vec3 position = surface.position;
+    PointLight light = point_light[light_id];
+
+    // The back faces of the volume only bound the pixels from behind
+    float light_distance = distance(position, light.position);
+    float max_intensity = max(max(max(light.diffuse.x, light.diffuse.y), light.diffuse.z),
+                              max(max(light.specular.x, light.specular.y), light.specular.z));
+    if (dot(light.attenuation, vec3(1.0, light_distance, light_distance * light_distance)) *
+        MIN_INTENSITY > max_intensity) {
+        discard;
+    }
+
+    vec3 eye_direction = normalize(view_position - position);
+
+    float shadow = calc_shadow(uint(light_id), light.position, position, view_position,
+                               gl_FragCoord.xy);
+    vec3 color = calc_point_light(light, surface.normal, light.position, position,
+                                  eye_direction, surface.diffuse, surface.specular, shadow);
+
+    frag_color = vec4(color, 1.0);
+    bright_color = vec4(filter_bright_colors(color), 1.0);
+}
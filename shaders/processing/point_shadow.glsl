@@ -0,0 +1,159 @@
+// Point light shadow lookup and filtering shared by the lighting shaders, see
+// PointShadowCache::get_shader_source. It is inserted after the #version line of every stage,
+// so it can't use declarations of the shaders or anything only fragment shaders have.
+
+uniform samplerCubeArray shadow_maps[4];
+// The same cube arrays with hardware depth comparison and bilinear filtering
+uniform samplerCubeArrayShadow shadow_compare_maps[4];
+// Point shadow filter and its number of Poisson taps, see PointShadowCache::ShadowFilter
+uniform int shadow_filter;
+uniform int shadow_filter_taps;
+
+const int SHADOW_FILTER_MANUAL = 0;
+const int SHADOW_FILTER_HARDWARE = 1;
+const int SHADOW_FILTER_POISSON = 2;
+const int SHADOW_FILTER_POISSON_EARLY_OUT = 3;
+
+// Taps checked before the early out, the first taps of the disk lie in different quadrants
+// near its edge
+const int EARLY_OUT_TAPS = 4;
+const int MAX_POISSON_TAPS = 16;
+const vec2 POISSON_DISK[MAX_POISSON_TAPS] = vec2[]
+(
+    vec2(-0.94201624, -0.39906216), vec2( 0.97484398,  0.75648379),
+    vec2( 0.44323325, -0.97511554), vec2(-0.24188840,  0.99706507),
+    vec2( 0.94558609, -0.76890725), vec2(-0.09418410, -0.92938870),
+    vec2( 0.34495938,  0.29387760), vec2(-0.91588581,  0.45771432),
+    vec2(-0.81544232, -0.87912464), vec2(-0.38277543,  0.27676845),
+    vec2( 0.53742981, -0.47373420), vec2(-0.26496911, -0.41893023),
+    vec2( 0.79197514,  0.19090188), vec2(-0.81409955,  0.91437590),
+    vec2( 0.19984126,  0.78641367), vec2( 0.14383161, -0.14100790)
+);
+// Scales the disk to roughly the area of the manual offsets
+const float POISSON_SCALE = 1.5;
+
+// Cached shadow map of every point light, see PointShadowCache
+struct ShadowSlot {
+    int tier;
+    int layer;
+    float far_plane;
+    float padding;
+};
+
+layout (std430, binding = 7) buffer ShadowSlots {
+    ShadowSlot shadow_slot[];
+};
+
+float sample_shadow_map(int tier, vec4 coords) {
+    // Sampler arrays can only be indexed with dynamically uniform expressions
+    switch (tier) {
+        case 0:
+            return texture(shadow_maps[0], coords).r;
+        case 1:
+            return texture(shadow_maps[1], coords).r;
+        case 2:
+            return texture(shadow_maps[2], coords).r;
+        default:
+            return texture(shadow_maps[3], coords).r;
+    }
+}
+
+// Fraction of the bilinear footprint around coords that is lit
+float sample_shadow_compare(int tier, vec4 coords, float reference) {
+    switch (tier) {
+        case 0:
+            return texture(shadow_compare_maps[0], coords, reference);
+        case 1:
+            return texture(shadow_compare_maps[1], coords, reference);
+        case 2:
+            return texture(shadow_compare_maps[2], coords, reference);
+        default:
+            return texture(shadow_compare_maps[3], coords, reference);
+    }
+}
+
+float interleaved_gradient_noise(vec2 pixel) {
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+float calc_shadow_manual(ShadowSlot slot, vec3 light_ray, float current_depth,
+                         float disk_radius) {
+    const int samples = 20;
+    float shadow = 0;
+
+    const vec3 sample_offset_dirs[samples] = vec3[]
+    (
+       vec3( 1,  1,  1), vec3( 1, -1,  1), vec3(-1, -1,  1), vec3(-1,  1,  1),
+       vec3( 1,  1, -1), vec3( 1, -1, -1), vec3(-1, -1, -1), vec3(-1,  1, -1),
+       vec3( 1,  1,  0), vec3( 1, -1,  0), vec3(-1, -1,  0), vec3(-1,  1,  0),
+       vec3( 1,  0,  1), vec3(-1,  0,  1), vec3( 1,  0, -1), vec3(-1,  0, -1),
+       vec3( 0,  1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0,  1, -1)
+    );
+
+    for (int i = 0; i < samples; i++) {
+        vec4 coords = vec4(light_ray + sample_offset_dirs[i] * disk_radius, slot.layer);
+        float closest_depth = sample_shadow_map(slot.tier, coords) * slot.far_plane;
+        if (current_depth > closest_depth) {
+            shadow += 1;
+        }
+    }
+
+    return shadow / float(samples);
+}
+
+float calc_shadow_poisson(ShadowSlot slot, vec3 light_ray, float reference, float disk_radius,
+                          vec2 pixel) {
+    // The disk lies in the plane facing the light and is rotated per pixel, which trades
+    // banding for noise
+    vec3 axis = normalize(light_ray);
+    vec3 tangent = normalize(cross(axis, abs(axis.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0)));
+    vec3 bitangent = cross(axis, tangent);
+    float angle = 6.28318531 * interleaved_gradient_noise(pixel);
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+    float radius = disk_radius * POISSON_SCALE;
+
+    int taps = clamp(shadow_filter_taps, 1, MAX_POISSON_TAPS);
+    float lit = 0.0;
+
+    for (int i = 0; i < taps; i++) {
+        // Fully lit or fully shadowed pixels stop after the first ring
+        if (i == EARLY_OUT_TAPS && shadow_filter == SHADOW_FILTER_POISSON_EARLY_OUT &&
+            (lit == 0.0 || lit == float(EARLY_OUT_TAPS))) {
+            return 1.0 - lit / float(EARLY_OUT_TAPS);
+        }
+
+        vec2 offset = rotation * POISSON_DISK[i] * radius;
+        vec4 coords = vec4(light_ray + tangent * offset.x + bitangent * offset.y, slot.layer);
+        lit += sample_shadow_compare(slot.tier, coords, reference);
+    }
+
+    return 1.0 - lit / float(taps);
+}
+
+float calc_shadow(uint light, vec3 light_position, vec3 position, vec3 view_position,
+                  vec2 pixel) {
+    ShadowSlot slot = shadow_slot[light];
+
+    if (slot.tier < 0) {
+        return 0.0;
+    }
+
+    vec3 light_ray = position - light_position;
+    float current_depth = length(light_ray);
+
+    float bias = 0.1;
+    float disk_radius = (1.0 + distance(view_position, position) / slot.far_plane) / 25.0;
+
+    if (shadow_filter == SHADOW_FILTER_MANUAL) {
+        return calc_shadow_manual(slot, light_ray, current_depth - bias, disk_radius);
+    }
+
+    // Stored depths are light distances over the far plane
+    float reference = (current_depth - bias) / slot.far_plane;
+
+    if (shadow_filter == SHADOW_FILTER_HARDWARE) {
+        return 1.0 - sample_shadow_compare(slot.tier, vec4(light_ray, slot.layer), reference);
+    }
+
+    return calc_shadow_poisson(slot, light_ray, reference, disk_radius, pixel);
+}
@@ -0,0 +1,18 @@
+# version 450 core
+out vec4 frag_color;
+
+in vec2 texture_coords;
+
+uniform sampler2D image1;
+
+vec3 srgb_to_linear(vec3 color) {
+    return mix(color / 12.92, pow((color + 0.055) / 1.055, vec3(2.4)),
+               step(vec3(0.04045), color));
+}
+
+void main()
+{
+    // Written sRGB encoded by an image store, the framebuffer encodes it again. Upscales from
+    // the rendered part of the target.
+    frag_color = vec4(srgb_to_linear(texture(image1, texture_coords).rgb), 1.0);
+}
@@ -0,0 +1,43 @@
+# version 450 core
+out vec4 frag_color;
+
+// Contrast adaptive sharpening in the style of FSR1's RCAS. Sharpens with the four direct
+// neighbours, with the amount limited per pixel so the result never leaves the range of the
+// neighbourhood, which keeps it from clipping or ringing.
+uniform sampler2D source;
+// 0 is the strongest, every stop above halves the sharpening
+uniform float sharpness;
+
+// Most negative lobe weight, beyond which the filter can't stay within the neighbourhood
+const float RCAS_LIMIT = 0.25 - 1.0 / 16.0;
+
+vec3 fetch(ivec2 pixel) {
+    return texelFetch(source, clamp(pixel, ivec2(0), textureSize(source, 0) - 1), 0).rgb;
+}
+
+void main()
+{
+    //    b
+    //  d e f
+    //    h
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 b = fetch(pixel + ivec2(0, 1));
+    vec3 d = fetch(pixel + ivec2(-1, 0));
+    vec3 e = fetch(pixel);
+    vec3 f = fetch(pixel + ivec2(1, 0));
+    vec3 h = fetch(pixel + ivec2(0, -1));
+
+    vec3 lowest = min(min(b, d), min(f, h));
+    vec3 highest = max(max(b, d), max(f, h));
+
+    // Largest negative lobe that keeps every channel within [0, 1]
+    vec3 hit_min = lowest / (4.0 * highest + 1e-5);
+    vec3 hit_max = (1.0 - highest) / (4.0 * lowest - 4.0 - 1e-5);
+    vec3 lobes = max(-hit_min, hit_max);
+    float lobe = max(-RCAS_LIMIT, min(max(lobes.r, max(lobes.g, lobes.b)), 0.0)) *
+                 exp2(-sharpness);
+
+    vec3 color = (lobe * (b + d + f + h) + e) / (4.0 * lobe + 1.0);
+
+    frag_color = vec4(color, 1.0);
+}
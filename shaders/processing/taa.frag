@@ -0,0 +1,93 @@
+# version 450 core
+out vec4 frag_color;
+
+in vec2 texture_coords;
+
+// Temporal anti-aliasing resolve. Every frame is rendered with a different sub-pixel jitter
+// and blended into the frames before it, reprojected with the motion vectors. The history is
+// clamped to the colors around the pixel in the current frame, so surfaces that were hidden
+// or have changed don't leave ghosts behind.
+uniform sampler2D current;
+uniform sampler2D history;
+uniform sampler2D velocity;
+uniform bool history_valid;
+// Weight of the current frame
+uniform float blend;
+// Normalized device coordinates on the far plane to the last frame's, for the sky
+uniform mat4 sky_reprojection;
+
+// Fraction of the targets rendered to this frame and its size in pixels, see DynamicResolution
+layout (std140, binding = 14) uniform Viewport {
+    vec2 viewport_scale;
+    vec2 viewport_size;
+};
+
+// Matches GBuffer, left where no geometry was drawn
+const float NO_MOTION = 1e4;
+
+vec3 rgb_to_ycocg(vec3 color) {
+    return vec3(0.25 * color.x + 0.5 * color.y + 0.25 * color.z,
+                0.5 * color.x - 0.5 * color.z,
+                -0.25 * color.x + 0.5 * color.y - 0.25 * color.z);
+}
+
+vec3 ycocg_to_rgb(vec3 color) {
+    return vec3(color.x + color.y - color.z, color.x + color.z, color.x - color.y - color.z);
+}
+
+// Blending HDR values as they are lets a few bright samples outweigh the rest
+vec3 compress(vec3 color) {
+    return color / (1.0 + max(color.x, max(color.y, color.z)));
+}
+
+vec3 uncompress(vec3 color) {
+    return color / max(1.0 - max(color.x, max(color.y, color.z)), 1e-4);
+}
+
+vec3 fetch(ivec2 pixel) {
+    return compress(texelFetch(current, clamp(pixel, ivec2(0), ivec2(viewport_size) - 1), 0).rgb);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec3 color = fetch(pixel);
+
+    if (!history_valid) {
+        frag_color = vec4(uncompress(color), 1.0);
+        return;
+    }
+
+    // Bounds of the neighbourhood in YCoCg, which fits around its colors more tightly
+    vec3 lowest = rgb_to_ycocg(color);
+    vec3 highest = lowest;
+
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec3 neighbour = rgb_to_ycocg(fetch(pixel + ivec2(x, y)));
+            lowest = min(lowest, neighbour);
+            highest = max(highest, neighbour);
+        }
+    }
+
+    vec2 motion = texelFetch(velocity, pixel, 0).xy;
+
+    if (motion.x >= NO_MOTION) {
+        vec2 ndc = (vec2(pixel) + 0.5) / viewport_size * 2.0 - 1.0;
+        vec4 previous = sky_reprojection * vec4(ndc, 1.0, 1.0);
+        motion = (ndc - previous.xy / previous.w) * 0.5;
+    }
+
+    vec2 previous_coords = texture_coords - motion * viewport_scale;
+
+    if (any(lessThan(previous_coords, vec2(0.0))) ||
+        any(greaterThan(previous_coords, viewport_scale))) {
+        frag_color = vec4(uncompress(color), 1.0);
+        return;
+    }
+
+    vec3 previous = rgb_to_ycocg(compress(texture(history, previous_coords).rgb));
+    previous = ycocg_to_rgb(clamp(previous, lowest, highest));
+
+    frag_color = vec4(uncompress(mix(previous, color, blend)), 1.0);
+}
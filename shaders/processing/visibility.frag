@@ -0,0 +1,12 @@
+#version 450 core
+
+// Matches VisibilityBuffer, the instance goes in the high bits
+const uint TRIANGLE_BITS = 24;
+
+flat in uint instance;
+
+layout (location = 0) out uint visibility_id;
+
+void main() {
+    visibility_id = (instance << TRIANGLE_BITS) | uint(gl_PrimitiveID);
+}
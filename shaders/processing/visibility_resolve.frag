@@ -0,0 +1,208 @@
+#version 450 core
+
+// Matches VisibilityBuffer, the instance goes in the high bits
+const uint TRIANGLE_BITS = 24;
+const uint TRIANGLE_MASK = (1u << TRIANGLE_BITS) - 1u;
+const uint EMPTY_ID = 0xFFFFFFFFu;
+// Floats per vertex: position, normal, texture coordinates, tangent and bitangent
+const uint VERTEX_STRIDE = 14;
+
+layout (location = 0) out vec4 packed_normal;
+layout (location = 1) out vec4 diffuse_spec;
+layout (location = 2) out vec2 velocity;
+
+uniform usampler2D visibility_ids;
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_specular1;
+uniform sampler2D texture_normal1;
+uniform sampler2D texture_height1;
+
+uniform uint first_instance;
+uniform uint num_instances;
+uniform bool indexed;
+uniform bool reverse_normal;
+uniform bool gamma;
+uniform bool parallax;
+
+layout (std140, binding = 0) uniform Matrices {
+    mat4 perspective;
+    mat4 view;
+    mat4 inverse_view_projection;
+    // Without the anti-aliasing jitter, for motion vectors
+    mat4 unjittered_view_projection;
+    mat4 previous_view_projection;
+};
+
+// Fraction of the targets rendered to this frame and its size in pixels, see DynamicResolution
+layout (std140, binding = 14) uniform Viewport {
+    vec2 viewport_scale;
+    vec2 viewport_size;
+};
+
+// Vertex and index buffers of the draw being resolved
+layout (std430, binding = 11) buffer Vertices {
+    float vertex_data[];
+};
+
+layout (std430, binding = 12) buffer Indices {
+    uint vertex_index[];
+};
+
+layout (std430, binding = 13) buffer Instances {
+    mat4 instance_model[];
+};
+
+struct Vertex {
+    vec3 position;
+    vec3 normal;
+    vec2 texture_coords;
+    vec3 tangent;
+    vec3 bitangent;
+};
+
+Vertex fetch_vertex(uint index) {
+    uint base = index * VERTEX_STRIDE;
+    Vertex vertex;
+
+    vertex.position = vec3(vertex_data[base], vertex_data[base + 1], vertex_data[base + 2]);
+    vertex.normal = vec3(vertex_data[base + 3], vertex_data[base + 4], vertex_data[base + 5]);
+    vertex.texture_coords = vec2(vertex_data[base + 6], vertex_data[base + 7]);
+    vertex.tangent = vec3(vertex_data[base + 8], vertex_data[base + 9], vertex_data[base + 10]);
+    vertex.bitangent = vec3(vertex_data[base + 11], vertex_data[base + 12], vertex_data[base + 13]);
+
+    return vertex;
+}
+
+vec3 unproject(vec2 ndc, float depth) {
+    vec4 position = inverse_view_projection * vec4(ndc, depth, 1.0);
+    return position.xyz / position.w;
+}
+
+// Barycentrics of where the ray through a point on the screen hits the triangle's plane,
+// which are perspective correct without needing the rasterizer's interpolation
+vec3 ray_barycentrics(vec2 ndc, vec3 p0, vec3 p1, vec3 p2) {
+    vec3 origin = unproject(ndc, -1.0);
+    vec3 direction = unproject(ndc, 1.0) - origin;
+
+    vec3 e1 = p1 - p0;
+    vec3 e2 = p2 - p0;
+    vec3 normal = cross(e1, e2);
+    vec3 hit = origin + direction * dot(p0 - origin, normal) / dot(direction, normal);
+
+    vec3 offset = hit - p0;
+    float d00 = dot(e1, e1);
+    float d01 = dot(e1, e2);
+    float d11 = dot(e2, e2);
+    float d20 = dot(offset, e1);
+    float d21 = dot(offset, e2);
+    float denominator = d00 * d11 - d01 * d01;
+    float v = (d11 * d20 - d01 * d21) / denominator;
+    float w = (d00 * d21 - d01 * d20) / denominator;
+
+    return vec3(1.0 - v - w, v, w);
+}
+
+// Same as in gbuffer.frag, with explicit gradients since neighbouring pixels of a resolved
+// tile can belong to other triangles
+vec2 parallax_mapping(vec2 texture_coords, vec3 eye_direction, vec2 dx, vec2 dy) {
+    const float height_scale = 0.1;
+    const float min_layers = 8;
+    const float max_layers = 32;
+    const float num_layers = mix(max_layers, min_layers, abs(eye_direction.z));
+    const float layer_depth = 1.0 / num_layers;
+    const vec2 p = eye_direction.xy * height_scale;
+    const vec2 delta_texture_coords = p / num_layers;
+
+    float current_layer_depth = 0.0;
+    vec2 current_texture_coords = texture_coords;
+    float current_depth_map_value = textureGrad(texture_height1, current_texture_coords, dx, dy).r;
+
+    while (current_layer_depth < current_depth_map_value) {
+        current_texture_coords -= delta_texture_coords;
+        current_depth_map_value = textureGrad(texture_height1, current_texture_coords, dx, dy).r;
+        current_layer_depth += layer_depth;
+    }
+
+    vec2 prev_texture_coords = current_texture_coords + delta_texture_coords;
+    float prev_layer_depth = current_layer_depth - layer_depth;
+    float prev_depth_map_value = textureGrad(texture_height1, prev_texture_coords, dx, dy).r;
+
+    float after_depth_offset = -(current_depth_map_value - current_layer_depth);
+    float prev_depth_offset = prev_depth_map_value - prev_layer_depth;
+    float weight = after_depth_offset / (after_depth_offset + prev_depth_offset);
+
+    return mix(current_texture_coords, prev_texture_coords, weight);
+}
+
+// Maps a unit vector to the unit square through an octahedron
+vec2 octahedral_encode(vec3 v) {
+    v /= abs(v.x) + abs(v.y) + abs(v.z);
+    vec2 folded = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    return (v.z >= 0.0 ? v.xy : folded) * 0.5 + 0.5;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    uint id = texelFetch(visibility_ids, pixel, 0).r;
+    uint instance = id >> TRIANGLE_BITS;
+
+    if (id == EMPTY_ID || instance < first_instance || instance >= first_instance + num_instances) {
+        discard;
+    }
+
+    uint triangle = id & TRIANGLE_MASK;
+    uint i0 = indexed ? vertex_index[3 * triangle] : 3 * triangle;
+    uint i1 = indexed ? vertex_index[3 * triangle + 1] : 3 * triangle + 1;
+    uint i2 = indexed ? vertex_index[3 * triangle + 2] : 3 * triangle + 2;
+    Vertex v0 = fetch_vertex(i0);
+    Vertex v1 = fetch_vertex(i1);
+    Vertex v2 = fetch_vertex(i2);
+
+    mat4 model = instance_model[instance];
+    vec3 p0 = vec3(model * vec4(v0.position, 1.0));
+    vec3 p1 = vec3(model * vec4(v1.position, 1.0));
+    vec3 p2 = vec3(model * vec4(v2.position, 1.0));
+
+    // The neighbouring pixels' rays give the texture coordinate gradients for filtering
+    vec2 pixel_size = 2.0 / viewport_size;
+    vec2 ndc = (vec2(pixel) + 0.5) * pixel_size - 1.0;
+    vec3 bary = ray_barycentrics(ndc, p0, p1, p2);
+    vec3 bary_dx = ray_barycentrics(ndc + vec2(pixel_size.x, 0.0), p0, p1, p2);
+    vec3 bary_dy = ray_barycentrics(ndc + vec2(0.0, pixel_size.y), p0, p1, p2);
+
+    mat3x2 coords = mat3x2(v0.texture_coords, v1.texture_coords, v2.texture_coords);
+    vec2 texture_coords = coords * bary;
+    vec2 dx = coords * bary_dx - texture_coords;
+    vec2 dy = coords * bary_dy - texture_coords;
+
+    mat3 normal_mat = transpose(inverse(mat3(model)));
+    vec3 t = normalize(normal_mat * mat3(v0.tangent, v1.tangent, v2.tangent) * bary);
+    vec3 b = normalize(normal_mat * mat3(v0.bitangent, v1.bitangent, v2.bitangent) * bary);
+    vec3 n = normalize(normal_mat * mat3(v0.normal, v1.normal, v2.normal) * bary) *
+             (reverse_normal ? -1 : 1);
+
+    if (parallax) {
+        vec3 view_ray = unproject(ndc, 1.0) - unproject(ndc, -1.0);
+        vec3 eye_direction = normalize(transpose(mat3(t, b, n)) * -view_ray);
+        texture_coords = parallax_mapping(texture_coords, eye_direction, dx, dy);
+    }
+
+    vec3 tangent_normal = textureGrad(texture_normal1, texture_coords, dx, dy).rgb;
+
+    if (gamma) {
+        tangent_normal = pow(tangent_normal, vec3(2.2));
+    }
+
+    tangent_normal = normalize(tangent_normal * 2.0 - 1.0);
+    diffuse_spec.rgb = textureGrad(texture_diffuse1, texture_coords, dx, dy).rgb;
+    diffuse_spec.a = textureGrad(texture_specular1, texture_coords, dx, dy).r;
+
+    vec3 world_normal = normalize(mat3(t, b, n) * tangent_normal);
+    packed_normal = vec4(octahedral_encode(world_normal), 0.0, 0.0);
+
+    // Only the instances of this frame are kept, so the motion is the camera's
+    vec4 position = vec4(mat3(p0, p1, p2) * bary, 1.0);
+    vec4 current_clip = unjittered_view_projection * position;
+    vec4 previous_clip = previous_view_projection * position;
+    velocity = (current_clip.xy / current_clip.w - previous_clip.xy / previous_clip.w) * 0.5;
+}
@@ -0,0 +1,51 @@
+#version 450 core
+
+// Matches VisibilityBuffer
+const uint TILE_SIZE = 16;
+
+layout (location = 0) in vec2 in_position;
+
+// Fraction of the targets rendered to this frame and its size in pixels, see DynamicResolution
+layout (std140, binding = 14) uniform Viewport {
+    vec2 viewport_scale;
+    vec2 viewport_size;
+};
+
+// Same as in visibility_classify.comp
+struct DrawTiles {
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+    uint first_tile;
+    uint max_tiles;
+    uint padding[2];
+};
+
+layout (std430, binding = 9) buffer Draws {
+    DrawTiles draws[];
+};
+
+layout (std430, binding = 10) buffer Tiles {
+    uint tiles[];
+};
+
+uniform uint draw;
+
+// A quad over each tile holding the draw's pixels
+void main()
+{
+    // Past what its bounds allowed for, the draw's quad collapses
+    const uint instance = uint(gl_InstanceID);
+
+    if (instance >= draws[draw].max_tiles) {
+        gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    const uint tile = tiles[draws[draw].first_tile + instance];
+    const vec2 corner = vec2(tile & 0xFFFFu, tile >> 16) + (in_position * 0.5 + 0.5);
+    const vec2 pixel = min(corner * TILE_SIZE, viewport_size);
+
+    gl_Position = vec4(pixel / viewport_size * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -8,9 +8,13 @@ layout (std430, binding = 1) buffer Model {
 
 
 layout (std140, binding = 8) uniform DirectionalShadow {
-    mat4 light_space;
+    mat4 light_space[4];
+    vec4 cascade_far_planes;
+    int num_cascades;
 };
 
+uniform int cascade;
+
 void main() {
-    gl_Position = light_space * model[gl_InstanceID] * vec4(in_position, 1.0);
+    gl_Position = light_space[cascade] * model[gl_InstanceID] * vec4(in_position, 1.0);
 }
@@ -2,10 +2,12 @@
 
 in vec4 frag_pos;
 
-layout (std140, binding = 9) uniform PointShadow {
+layout (std140, binding = 10) uniform ShadowFace {
   mat4 shadow_matrices[6];
   vec3 light_position;
   float far_plane;
+  int first_layer;
+  int face_mask;
 };
 
 void main() {
@@ -0,0 +1,21 @@
+#version 450 core
+
+layout (location = 0) in vec3 in_position;
+
+layout (std140, binding = 10) uniform ShadowFace {
+  mat4 shadow_matrices[6];
+  vec3 light_position;
+  float far_plane;
+  int first_layer;
+  int face_mask;
+};
+
+uniform mat4 model_matrix;
+uniform int face;
+
+out vec4 frag_pos;
+
+void main() {
+    frag_pos = model_matrix * vec4(in_position, 1.0);
+    gl_Position = shadow_matrices[face] * frag_pos;
+}
@@ -0,0 +1,25 @@
+#version 450 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+
+layout (location = 0) in vec3 in_position;
+// Taken from the base instance of the draw command, one command per face
+layout (location = 1) in int in_face;
+
+layout (std140, binding = 10) uniform ShadowFace {
+  mat4 shadow_matrices[6];
+  vec3 light_position;
+  float far_plane;
+  int first_layer;
+  int face_mask;
+};
+
+uniform mat4 model_matrix;
+
+out vec4 frag_pos;
+
+void main() {
+    frag_pos = model_matrix * vec4(in_position, 1.0);
+    gl_Position = shadow_matrices[in_face] * frag_pos;
+    gl_Layer = first_layer + in_face;
+}
@@ -0,0 +1,54 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+typedef glm::vec3 vec3;
+typedef glm::vec4 vec4;
+typedef glm::mat4 mat4;
+
+struct AABB {
+  vec3 min = vec3(std::numeric_limits<float>::max());
+  vec3 max = vec3(std::numeric_limits<float>::lowest());
+
+  void extend(const vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  void extend(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+
+  bool empty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
+  vec3 center() const {
+    return (min + max) * 0.5f;
+  }
+
+  vec3 extents() const {
+    return (max - min) * 0.5f;
+  }
+
+  vec3 corner(int i) const {
+    return vec3((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+  }
+
+  // Bounds of the box after an affine transform, conservative for rotations
+  AABB transform(const mat4& matrix) const {
+    AABB result;
+
+    for (int i = 0; i < 8; i++) {
+      result.extend(vec3(matrix * vec4(corner(i), 1.0f)));
+    }
+
+    return result;
+  }
+};
+
+#endif // BOUNDS_H
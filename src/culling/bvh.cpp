@@ -0,0 +1,411 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <xmmintrin.h>
+
+constexpr unsigned int NUM_BINS = 16;
+constexpr unsigned int MAX_LEAF_SIZE = 4;
+constexpr unsigned int EMPTY_SLOT = std::numeric_limits<unsigned int>::max();
+static float surface_area(const AABB& bounds)
+{
+  const vec3 size = bounds.max - bounds.min;
+  return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void BVH::Node::set_bounds(int slot, const AABB& bounds)
+{
+  min_x[slot] = bounds.min.x;
+  min_y[slot] = bounds.min.y;
+  min_z[slot] = bounds.min.z;
+  max_x[slot] = bounds.max.x;
+  max_y[slot] = bounds.max.y;
+  max_z[slot] = bounds.max.z;
+}
+
+void BVH::build(const std::vector<AABB>& bounds)
+{
+  nodes.clear();
+  primitive_bounds = bounds;
+  primitive_indices.resize(bounds.size());
+
+  if (bounds.empty()) {
+    return;
+  }
+
+  std::vector<vec3> centroids;
+  centroids.reserve(bounds.size());
+
+  for (unsigned int i = 0; i < bounds.size(); i++) {
+    primitive_indices[i] = i;
+    centroids.emplace_back(bounds[i].center());
+  }
+
+  std::vector<BuildNode> build_nodes;
+  build_nodes.reserve(2 * bounds.size() / MAX_LEAF_SIZE + 1);
+  build_node(build_nodes, centroids, 0, static_cast<unsigned int>(bounds.size()));
+
+  nodes.reserve(build_nodes.size() / 2 + 1);
+
+  if (build_nodes.front().count == 0) {
+    collapse(build_nodes, 0);
+    return;
+  }
+
+  // A single leaf still needs a node above it, the unused slots are empty like in collapse
+  Node root;
+  std::fill(std::begin(root.child), std::end(root.child), EMPTY_SLOT);
+  std::fill(std::begin(root.count), std::end(root.count), 0);
+
+  for (int slot = 1; slot < 4; slot++) {
+    root.set_bounds(slot, AABB());
+  }
+
+  root.set_bounds(0, build_nodes.front().bounds);
+  root.child[0] = 0;
+  root.count[0] = build_nodes.front().count;
+  nodes.emplace_back(root);
+}
+
+unsigned int BVH::build_node(std::vector<BuildNode>& build_nodes,
+                             const std::vector<vec3>& centroids,
+                             unsigned int first, unsigned int count)
+{
+  const unsigned int index = static_cast<unsigned int>(build_nodes.size());
+  build_nodes.push_back({ AABB(), 0, 0, first, count });
+
+  AABB bounds, centroid_bounds;
+
+  for (unsigned int i = first; i < first + count; i++) {
+    bounds.extend(primitive_bounds[primitive_indices[i]]);
+    centroid_bounds.extend(centroids[primitive_indices[i]]);
+  }
+
+  build_nodes[index].bounds = bounds;
+
+  if (count <= MAX_LEAF_SIZE) {
+    return index;
+  }
+
+  int best_axis = -1;
+  unsigned int best_split = 0;
+  float best_cost = surface_area(bounds) * static_cast<float>(count);
+
+  for (int axis = 0; axis < 3; axis++) {
+    const float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+
+    if (extent <= 0.0f) {
+      continue;
+    }
+
+    AABB bin_bounds[NUM_BINS];
+    unsigned int bin_counts[NUM_BINS] = {};
+    const float scale = NUM_BINS / extent;
+
+    for (unsigned int i = first; i < first + count; i++) {
+      const unsigned int primitive = primitive_indices[i];
+      const unsigned int bin = std::min(NUM_BINS - 1, static_cast<unsigned int>(
+        (centroids[primitive][axis] - centroid_bounds.min[axis]) * scale));
+
+      bin_bounds[bin].extend(primitive_bounds[primitive]);
+      bin_counts[bin]++;
+    }
+
+    // Sweep from the right to get the cost of every right hand side, then from the left
+    float right_areas[NUM_BINS];
+    unsigned int right_counts[NUM_BINS];
+    AABB right_bounds;
+    unsigned int right_count = 0;
+
+    for (unsigned int bin = NUM_BINS - 1; bin > 0; bin--) {
+      right_bounds.extend(bin_bounds[bin]);
+      right_count += bin_counts[bin];
+      right_areas[bin] = right_bounds.empty() ? 0.0f : surface_area(right_bounds);
+      right_counts[bin] = right_count;
+    }
+
+    AABB left_bounds;
+    unsigned int left_count = 0;
+
+    for (unsigned int split = 1; split < NUM_BINS; split++) {
+      left_bounds.extend(bin_bounds[split - 1]);
+      left_count += bin_counts[split - 1];
+
+      if (left_count == 0 || right_counts[split] == 0) {
+        continue;
+      }
+
+      const float cost = surface_area(left_bounds) * static_cast<float>(left_count) +
+                         right_areas[split] * static_cast<float>(right_counts[split]);
+
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = split;
+      }
+    }
+  }
+
+  unsigned int* begin = primitive_indices.data() + first;
+  unsigned int* end = begin + count;
+  unsigned int* middle = begin + count / 2;
+
+  if (best_axis >= 0) {
+    const float min = centroid_bounds.min[best_axis];
+    const float scale = NUM_BINS / (centroid_bounds.max[best_axis] - min);
+
+    middle = std::partition(begin, end, [&] (unsigned int primitive) {
+      const unsigned int bin = std::min(NUM_BINS - 1, static_cast<unsigned int>(
+        (centroids[primitive][best_axis] - min) * scale));
+      return bin < best_split;
+    });
+  } else {
+    // Either every centroid is the same or no split beats a leaf, the node is still too big
+    const vec3 extents = bounds.extents();
+    const int axis = extents.x > extents.y ? (extents.x > extents.z ? 0 : 2)
+                                           : (extents.y > extents.z ? 1 : 2);
+    std::nth_element(begin, middle, end, [&] (unsigned int a, unsigned int b) {
+      return centroids[a][axis] < centroids[b][axis];
+    });
+  }
+
+  const unsigned int left_count = static_cast<unsigned int>(middle - begin);
+  const unsigned int left = build_node(build_nodes, centroids, first, left_count);
+  const unsigned int right = build_node(build_nodes, centroids, first + left_count,
+                                        count - left_count);
+
+  build_nodes[index].left = left;
+  build_nodes[index].right = right;
+  build_nodes[index].count = 0;
+
+  return index;
+}
+
+unsigned int BVH::collapse(const std::vector<BuildNode>& build_nodes, unsigned int build_index)
+{
+  const unsigned int index = static_cast<unsigned int>(nodes.size());
+  nodes.emplace_back();
+
+  // Open the largest interior children until all four slots are used
+  unsigned int children[4] = { build_nodes[build_index].left, build_nodes[build_index].right };
+  int num_children = 2;
+
+  while (num_children < 4) {
+    int largest = -1;
+    float largest_area = -1.0f;
+
+    for (int i = 0; i < num_children; i++) {
+      const BuildNode& child = build_nodes[children[i]];
+      const float area = surface_area(child.bounds);
+
+      if (child.count == 0 && area > largest_area) {
+        largest = i;
+        largest_area = area;
+      }
+    }
+
+    if (largest < 0) {
+      break;
+    }
+
+    const BuildNode& opened = build_nodes[children[largest]];
+    children[largest] = opened.left;
+    children[num_children++] = opened.right;
+  }
+
+  for (int slot = 0; slot < 4; slot++) {
+    Node& node = nodes[index];
+
+    if (slot >= num_children) {
+      node.set_bounds(slot, AABB());
+      node.child[slot] = EMPTY_SLOT;
+      node.count[slot] = 0;
+      continue;
+    }
+
+    const BuildNode& child = build_nodes[children[slot]];
+    node.set_bounds(slot, child.bounds);
+    node.count[slot] = child.count;
+
+    if (child.count > 0) {
+      node.child[slot] = child.first;
+    } else {
+      const unsigned int child_index = collapse(build_nodes, children[slot]);
+      nodes[index].child[slot] = child_index;
+    }
+  }
+
+  return index;
+}
+
+void BVH::refit(const std::vector<AABB>& bounds)
+{
+  primitive_bounds = bounds;
+
+  // Children are always stored after their parent
+  for (size_t i = nodes.size(); i-- > 0;) {
+    Node& node = nodes[i];
+
+    for (int slot = 0; slot < 4 && node.child[slot] != EMPTY_SLOT; slot++) {
+      AABB slot_bounds;
+
+      if (node.count[slot] > 0) {
+        for (unsigned int j = node.child[slot]; j < node.child[slot] + node.count[slot]; j++) {
+          slot_bounds.extend(primitive_bounds[primitive_indices[j]]);
+        }
+      } else {
+        const Node& child = nodes[node.child[slot]];
+
+        for (int child_slot = 0; child_slot < 4 && child.child[child_slot] != EMPTY_SLOT;
+             child_slot++) {
+          slot_bounds.extend(vec3(child.min_x[child_slot], child.min_y[child_slot],
+                                  child.min_z[child_slot]));
+          slot_bounds.extend(vec3(child.max_x[child_slot], child.max_y[child_slot],
+                                  child.max_z[child_slot]));
+        }
+      }
+
+      node.set_bounds(slot, slot_bounds);
+    }
+  }
+}
+
+void BVH::collect(unsigned int node, int slot, std::vector<unsigned int>& result) const
+{
+  if (nodes[node].count[slot] > 0) {
+    const unsigned int first = nodes[node].child[slot];
+    result.insert(result.end(), primitive_indices.begin() + first,
+                  primitive_indices.begin() + first + nodes[node].count[slot]);
+    return;
+  }
+
+  const Node& child = nodes[nodes[node].child[slot]];
+
+  for (int child_slot = 0; child_slot < 4 && child.child[child_slot] != EMPTY_SLOT; child_slot++) {
+    collect(nodes[node].child[slot], child_slot, result);
+  }
+}
+
+void BVH::query_frustum(const Frustum& frustum, std::vector<unsigned int>& result) const
+{
+  result.clear();
+
+  if (nodes.empty()) {
+    return;
+  }
+
+  std::vector<unsigned int> stack;
+  stack.reserve(64);
+  stack.emplace_back(0);
+
+  while (!stack.empty()) {
+    const unsigned int index = stack.back();
+    stack.pop_back();
+    const Node& node = nodes[index];
+
+    __m128 outside = _mm_setzero_ps();
+    __m128 partial = _mm_setzero_ps();
+
+    for (const auto& plane : frustum.planes) {
+      // Farthest corner along the plane normal decides if the box is outside, nearest if inside
+      const __m128 px = _mm_load_ps(plane.x > 0.0f ? node.max_x : node.min_x);
+      const __m128 py = _mm_load_ps(plane.y > 0.0f ? node.max_y : node.min_y);
+      const __m128 pz = _mm_load_ps(plane.z > 0.0f ? node.max_z : node.min_z);
+      const __m128 nx = _mm_load_ps(plane.x > 0.0f ? node.min_x : node.max_x);
+      const __m128 ny = _mm_load_ps(plane.y > 0.0f ? node.min_y : node.max_y);
+      const __m128 nz = _mm_load_ps(plane.z > 0.0f ? node.min_z : node.max_z);
+      const __m128 a = _mm_set1_ps(plane.x);
+      const __m128 b = _mm_set1_ps(plane.y);
+      const __m128 c = _mm_set1_ps(plane.z);
+      const __m128 d = _mm_set1_ps(plane.w);
+
+      const __m128 far = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, px), _mm_mul_ps(b, py)),
+                                    _mm_add_ps(_mm_mul_ps(c, pz), d));
+      const __m128 near = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, nx), _mm_mul_ps(b, ny)),
+                                     _mm_add_ps(_mm_mul_ps(c, nz), d));
+
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(far, _mm_setzero_ps()));
+      partial = _mm_or_ps(partial, _mm_cmplt_ps(near, _mm_setzero_ps()));
+    }
+
+    const int outside_mask = _mm_movemask_ps(outside);
+    const int partial_mask = _mm_movemask_ps(partial);
+
+    for (int slot = 0; slot < 4 && node.child[slot] != EMPTY_SLOT; slot++) {
+      if (outside_mask & (1 << slot)) {
+        continue;
+      }
+
+      if (!(partial_mask & (1 << slot))) {
+        collect(index, slot, result);
+      } else if (node.count[slot] == 0) {
+        stack.emplace_back(node.child[slot]);
+      } else {
+        for (unsigned int i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+          if (frustum.intersects(primitive_bounds[primitive_indices[i]])) {
+            result.emplace_back(primitive_indices[i]);
+          }
+        }
+      }
+    }
+  }
+}
+
+void BVH::query_sphere(const vec3& center, float radius, std::vector<unsigned int>& result) const
+{
+  result.clear();
+
+  if (nodes.empty()) {
+    return;
+  }
+
+  const __m128 cx = _mm_set1_ps(center.x);
+  const __m128 cy = _mm_set1_ps(center.y);
+  const __m128 cz = _mm_set1_ps(center.z);
+  const __m128 radius_squared = _mm_set1_ps(radius * radius);
+
+  std::vector<unsigned int> stack;
+  stack.reserve(64);
+  stack.emplace_back(0);
+
+  while (!stack.empty()) {
+    const Node& node = nodes[stack.back()];
+    stack.pop_back();
+
+    const __m128 dx = _mm_sub_ps(_mm_max_ps(_mm_load_ps(node.min_x),
+                                            _mm_min_ps(cx, _mm_load_ps(node.max_x))), cx);
+    const __m128 dy = _mm_sub_ps(_mm_max_ps(_mm_load_ps(node.min_y),
+                                            _mm_min_ps(cy, _mm_load_ps(node.max_y))), cy);
+    const __m128 dz = _mm_sub_ps(_mm_max_ps(_mm_load_ps(node.min_z),
+                                            _mm_min_ps(cz, _mm_load_ps(node.max_z))), cz);
+    const __m128 distance_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                               _mm_mul_ps(dz, dz));
+    const int hit_mask = _mm_movemask_ps(_mm_cmple_ps(distance_squared, radius_squared));
+
+    for (int slot = 0; slot < 4 && node.child[slot] != EMPTY_SLOT; slot++) {
+      if (!(hit_mask & (1 << slot))) {
+        continue;
+      }
+
+      if (node.count[slot] == 0) {
+        stack.emplace_back(node.child[slot]);
+        continue;
+      }
+
+      for (unsigned int i = node.child[slot]; i < node.child[slot] + node.count[slot]; i++) {
+        const AABB& bounds = primitive_bounds[primitive_indices[i]];
+        const vec3 offset = glm::max(bounds.min, glm::min(center, bounds.max)) - center;
+
+        if (glm::dot(offset, offset) <= radius * radius) {
+          result.emplace_back(primitive_indices[i]);
+        }
+      }
+    }
+  }
+}
+
+size_t BVH::size() const
+{
+  return primitive_bounds.size();
+}
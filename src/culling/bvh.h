@@ -0,0 +1,54 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "culling/bounds.h"
+#include "culling/frustum.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+typedef glm::vec3 vec3;
+
+// Bounding volume hierarchy over the bounds of arbitrary primitives (instances, light volumes).
+// A binary tree is built with binned SAH and then collapsed into 4-wide nodes stored in a flat
+// array, with the child boxes laid out so that every traversal step tests all four at once.
+// Primitives keep the index they had in the bounds vector given to build.
+class BVH
+{
+public:
+  void build(const std::vector<AABB>& bounds);
+  void refit(const std::vector<AABB>& bounds);
+
+  void query_frustum(const Frustum& frustum, std::vector<unsigned int>& result) const;
+  void query_sphere(const vec3& center, float radius, std::vector<unsigned int>& result) const;
+
+  size_t size() const;
+
+private:
+  struct alignas(16) Node {
+    float min_x[4], min_y[4], min_z[4];
+    float max_x[4], max_y[4], max_z[4];
+    unsigned int child[4];
+    unsigned int count[4];
+
+    void set_bounds(int slot, const AABB& bounds);
+  };
+
+  struct BuildNode {
+    AABB bounds;
+    unsigned int left, right;
+    unsigned int first, count;
+  };
+
+  unsigned int build_node(std::vector<BuildNode>& build_nodes, const std::vector<vec3>& centroids,
+                          unsigned int first, unsigned int count);
+  unsigned int collapse(const std::vector<BuildNode>& build_nodes, unsigned int build_index);
+  void collect(unsigned int node, int slot, std::vector<unsigned int>& result) const;
+
+  std::vector<Node> nodes;
+  std::vector<unsigned int> primitive_indices;
+  std::vector<AABB> primitive_bounds;
+};
+
+#endif // BVH_H
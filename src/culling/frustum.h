@@ -0,0 +1,65 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "culling/bounds.h"
+
+#include <glm/glm.hpp>
+
+typedef glm::vec3 vec3;
+typedef glm::vec4 vec4;
+typedef glm::mat4 mat4;
+
+struct Frustum {
+  // Left, right, bottom, top, near, far, pointing inwards
+  vec4 planes[6];
+
+  Frustum() = default;
+
+  explicit Frustum(const mat4& view_projection) {
+    const vec4 row_x(view_projection[0][0], view_projection[1][0], view_projection[2][0],
+                     view_projection[3][0]);
+    const vec4 row_y(view_projection[0][1], view_projection[1][1], view_projection[2][1],
+                     view_projection[3][1]);
+    const vec4 row_z(view_projection[0][2], view_projection[1][2], view_projection[2][2],
+                     view_projection[3][2]);
+    const vec4 row_w(view_projection[0][3], view_projection[1][3], view_projection[2][3],
+                     view_projection[3][3]);
+
+    planes[0] = row_w + row_x;
+    planes[1] = row_w - row_x;
+    planes[2] = row_w + row_y;
+    planes[3] = row_w - row_y;
+    planes[4] = row_w + row_z;
+    planes[5] = row_w - row_z;
+
+    for (auto& plane : planes) {
+      plane /= glm::length(vec3(plane));
+    }
+  }
+
+  bool intersects(const AABB& bounds) const {
+    for (const auto& plane : planes) {
+      const vec3 positive(plane.x > 0.0f ? bounds.max.x : bounds.min.x,
+                          plane.y > 0.0f ? bounds.max.y : bounds.min.y,
+                          plane.z > 0.0f ? bounds.max.z : bounds.min.z);
+
+      if (glm::dot(vec3(plane), positive) + plane.w < 0.0f) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool intersects(const vec3& center, float radius) const {
+    for (const auto& plane : planes) {
+      if (glm::dot(vec3(plane), center) + plane.w < -radius) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
+#endif // FRUSTUM_H
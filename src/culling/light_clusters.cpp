@@ -0,0 +1,278 @@
+#include "light_clusters.h"
+#include "util/profiling/profiling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <xmmintrin.h>
+
+constexpr int CLUSTERS_X = 16;
+constexpr int CLUSTERS_Y = 9;
+constexpr int CLUSTERS_Z = 24;
+constexpr int NUM_CLUSTERS = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+static_assert(CLUSTERS_X % 4 == 0, "Clusters are tested four at a time along x");
+
+LightClusters::LightClusters()
+  : grid_capacity(0),
+    index_capacity(0),
+    cluster_perspective(0.0f),
+    near_plane(0.0f),
+    far_plane(0.0f),
+    min_x(CLUSTERS_X * CLUSTERS_Z),
+    max_x(CLUSTERS_X * CLUSTERS_Z),
+    min_y(CLUSTERS_Y * CLUSTERS_Z),
+    max_y(CLUSTERS_Y * CLUSTERS_Z),
+    min_z(CLUSTERS_Z),
+    max_z(CLUSTERS_Z),
+    slice_lights(CLUSTERS_Z),
+    cluster_lights(NUM_CLUSTERS),
+    grid(2 * NUM_CLUSTERS)
+{
+  glGenBuffers(1, &UBO);
+  glGenBuffers(1, &grid_SSBO);
+  glGenBuffers(1, &index_SSBO);
+
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferData(GL_UNIFORM_BUFFER, 4 * sizeof (unsigned int) + 4 * sizeof (float),
+               nullptr, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, 5, UBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, grid_SSBO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, index_SSBO);
+}
+
+LightClusters::~LightClusters()
+{
+  glDeleteBuffers(1, &UBO);
+  glDeleteBuffers(1, &grid_SSBO);
+  glDeleteBuffers(1, &index_SSBO);
+}
+
+void LightClusters::update(const mat4& perspective, const mat4& view,
+                           const std::vector<Lights::PointLight>& point_lights)
+{
+  PROFILE_SCOPE("LightClusters")
+
+  update_cluster_bounds(perspective);
+
+  PROFILE_SECTION_START("Light Bounds")
+  const int num_lights = static_cast<int>(point_lights.size());
+  const float log_depth_ratio = std::log(far_plane / near_plane);
+  std::vector<LightBounds> light_bounds(point_lights.size());
+
+  #pragma omp parallel for
+  for (int i = 0; i < num_lights; i++) {
+    LightBounds& bounds = light_bounds[static_cast<size_t>(i)];
+    bounds.center = vec3(view * vec4(point_lights[static_cast<size_t>(i)].position, 1.0f));
+    bounds.radius = Lights::get_radius(point_lights[static_cast<size_t>(i)]);
+
+    const float nearest = std::max(near_plane, -(bounds.center.z + bounds.radius));
+    const float farthest = -(bounds.center.z - bounds.radius);
+
+    bounds.min_z = 1;
+    bounds.max_z = 0;
+
+    if (farthest < near_plane || nearest > far_plane) {
+      continue;
+    }
+
+    // x / depth is monotonic in both, so the corners give the projected extents
+    float ndc_x[2] = { 1.0f, -1.0f }, ndc_y[2] = { 1.0f, -1.0f };
+
+    for (float depth : { nearest, farthest }) {
+      for (float sign : { -1.0f, 1.0f }) {
+        const float x = perspective[0][0] * (bounds.center.x + sign * bounds.radius) / depth -
+                        perspective[2][0];
+        const float y = perspective[1][1] * (bounds.center.y + sign * bounds.radius) / depth -
+                        perspective[2][1];
+        ndc_x[0] = std::min(ndc_x[0], x);
+        ndc_x[1] = std::max(ndc_x[1], x);
+        ndc_y[0] = std::min(ndc_y[0], y);
+        ndc_y[1] = std::max(ndc_y[1], y);
+      }
+    }
+
+    if (ndc_x[0] > 1.0f || ndc_x[1] < -1.0f || ndc_y[0] > 1.0f || ndc_y[1] < -1.0f) {
+      continue;
+    }
+
+    const auto slice = [&] (float depth) {
+      return std::clamp(static_cast<int>(std::log(depth / near_plane) / log_depth_ratio *
+                                         CLUSTERS_Z), 0, CLUSTERS_Z - 1);
+    };
+    const auto tile = [] (float ndc, int num_tiles) {
+      return std::clamp(static_cast<int>((ndc * 0.5f + 0.5f) * num_tiles), 0, num_tiles - 1);
+    };
+
+    bounds.min_x = tile(ndc_x[0], CLUSTERS_X);
+    bounds.max_x = tile(ndc_x[1], CLUSTERS_X);
+    bounds.min_y = tile(ndc_y[0], CLUSTERS_Y);
+    bounds.max_y = tile(ndc_y[1], CLUSTERS_Y);
+    bounds.min_z = slice(nearest);
+    bounds.max_z = slice(std::min(farthest, far_plane));
+  }
+
+  for (auto& lights : slice_lights) {
+    lights.clear();
+  }
+
+  for (unsigned int i = 0; i < light_bounds.size(); i++) {
+    for (int z = light_bounds[i].min_z; z <= light_bounds[i].max_z; z++) {
+      slice_lights[static_cast<size_t>(z)].emplace_back(i);
+    }
+  }
+  PROFILE_SECTION_END()
+
+  PROFILE_SECTION_START("Assign Lights")
+  #pragma omp parallel for schedule(dynamic)
+  for (int z = 0; z < CLUSTERS_Z; z++) {
+    assign_slice(z, light_bounds);
+  }
+  PROFILE_SECTION_END()
+
+  PROFILE_SECTION_START("Upload")
+  upload();
+  PROFILE_SECTION_END()
+}
+
+float LightClusters::get_average_lights() const
+{
+  return static_cast<float>(indices.size()) / NUM_CLUSTERS;
+}
+
+void LightClusters::update_cluster_bounds(const mat4& perspective)
+{
+  if (perspective == cluster_perspective) {
+    return;
+  }
+
+  cluster_perspective = perspective;
+  near_plane = perspective[3][2] / (perspective[2][2] - 1.0f);
+  far_plane = perspective[3][2] / (perspective[2][2] + 1.0f);
+
+  // Cluster boxes are separable, x only depends on the column and slice, y on the row and slice
+  for (int z = 0; z < CLUSTERS_Z; z++) {
+    const float near = near_plane * std::pow(far_plane / near_plane,
+                                             static_cast<float>(z) / CLUSTERS_Z);
+    const float far = near_plane * std::pow(far_plane / near_plane,
+                                            static_cast<float>(z + 1) / CLUSTERS_Z);
+    min_z[static_cast<size_t>(z)] = -far;
+    max_z[static_cast<size_t>(z)] = -near;
+
+    for (int x = 0; x < CLUSTERS_X; x++) {
+      const float ndc_min = -1.0f + 2.0f * x / CLUSTERS_X + perspective[2][0];
+      const float ndc_max = -1.0f + 2.0f * (x + 1) / CLUSTERS_X + perspective[2][0];
+      const size_t index = static_cast<size_t>(z * CLUSTERS_X + x);
+      min_x[index] = std::min(ndc_min * near, ndc_min * far) / perspective[0][0];
+      max_x[index] = std::max(ndc_max * near, ndc_max * far) / perspective[0][0];
+    }
+
+    for (int y = 0; y < CLUSTERS_Y; y++) {
+      const float ndc_min = -1.0f + 2.0f * y / CLUSTERS_Y + perspective[2][1];
+      const float ndc_max = -1.0f + 2.0f * (y + 1) / CLUSTERS_Y + perspective[2][1];
+      const size_t index = static_cast<size_t>(z * CLUSTERS_Y + y);
+      min_y[index] = std::min(ndc_min * near, ndc_min * far) / perspective[1][1];
+      max_y[index] = std::max(ndc_max * near, ndc_max * far) / perspective[1][1];
+    }
+  }
+
+  const unsigned int grid_size[4] = { CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, 0 };
+  const float depth_params[4] = { near_plane, std::log(far_plane / near_plane), 0.0f, 0.0f };
+
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof (grid_size), grid_size);
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (grid_size), sizeof (depth_params), depth_params);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void LightClusters::assign_slice(int z, const std::vector<LightBounds>& light_bounds)
+{
+  const size_t slice_offset = static_cast<size_t>(z * CLUSTERS_X * CLUSTERS_Y);
+
+  for (size_t cluster = slice_offset; cluster < slice_offset + CLUSTERS_X * CLUSTERS_Y; cluster++) {
+    cluster_lights[cluster].clear();
+  }
+
+  const float slice_min_z = min_z[static_cast<size_t>(z)];
+  const float slice_max_z = max_z[static_cast<size_t>(z)];
+  const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+  for (unsigned int light : slice_lights[static_cast<size_t>(z)]) {
+    const LightBounds& bounds = light_bounds[light];
+    const vec3& center = bounds.center;
+
+    const float dz = std::clamp(center.z, slice_min_z, slice_max_z) - center.z;
+    const __m128 cx = _mm_set1_ps(center.x);
+    const __m128 first_x = _mm_set1_ps(static_cast<float>(bounds.min_x) - 0.5f);
+    const __m128 last_x = _mm_set1_ps(static_cast<float>(bounds.max_x) + 0.5f);
+
+    for (int y = bounds.min_y; y <= bounds.max_y; y++) {
+      const size_t row = static_cast<size_t>(z * CLUSTERS_Y + y);
+      const float dy = std::clamp(center.y, min_y[row], max_y[row]) - center.y;
+      const float remaining = bounds.radius * bounds.radius - dy * dy - dz * dz;
+
+      if (remaining < 0.0f) {
+        continue;
+      }
+
+      const __m128 remaining_squared = _mm_set1_ps(remaining);
+      const float* row_min_x = min_x.data() + z * CLUSTERS_X;
+      const float* row_max_x = max_x.data() + z * CLUSTERS_X;
+
+      for (int x = bounds.min_x & ~3; x <= bounds.max_x; x += 4) {
+        const __m128 dx = _mm_sub_ps(_mm_max_ps(_mm_loadu_ps(row_min_x + x),
+                                                _mm_min_ps(cx, _mm_loadu_ps(row_max_x + x))), cx);
+        const __m128 column = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes);
+        const __m128 in_range = _mm_and_ps(_mm_cmpgt_ps(column, first_x),
+                                           _mm_cmplt_ps(column, last_x));
+        const int mask = _mm_movemask_ps(_mm_and_ps(in_range,
+                                                    _mm_cmple_ps(_mm_mul_ps(dx, dx),
+                                                                 remaining_squared)));
+
+        for (int lane = 0; lane < 4; lane++) {
+          if (mask & (1 << lane)) {
+            cluster_lights[static_cast<size_t>((z * CLUSTERS_Y + y) * CLUSTERS_X + x + lane)]
+              .emplace_back(light);
+          }
+        }
+      }
+    }
+  }
+}
+
+void LightClusters::upload()
+{
+  indices.clear();
+
+  for (size_t cluster = 0; cluster < cluster_lights.size(); cluster++) {
+    grid[2 * cluster] = static_cast<unsigned int>(indices.size());
+    grid[2 * cluster + 1] = static_cast<unsigned int>(cluster_lights[cluster].size());
+    indices.insert(indices.end(), cluster_lights[cluster].begin(), cluster_lights[cluster].end());
+  }
+
+  const size_t grid_size = grid.size() * sizeof (unsigned int);
+  const size_t index_size = std::max<size_t>(indices.size(), 1) * sizeof (unsigned int);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, grid_SSBO);
+  if (grid_size > grid_capacity) {
+    grid_capacity = grid_size;
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<long>(grid_capacity), nullptr,
+                 GL_DYNAMIC_DRAW);
+  }
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<long>(grid_size), grid.data());
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, index_SSBO);
+  if (index_size > index_capacity) {
+    index_capacity = 2 * index_size;
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<long>(index_capacity), nullptr,
+                 GL_DYNAMIC_DRAW);
+  }
+  if (!indices.empty()) {
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<long>(indices.size() *
+                                                                   sizeof (unsigned int)),
+                    indices.data());
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
@@ -0,0 +1,50 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include "model/lights.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+typedef glm::mat4 mat4;
+
+// Splits the view frustum into a 3D grid of clusters (screen tiles times exponential depth
+// slices) and assigns every point light to the clusters its attenuation range touches, so the
+// lighting pass only has to shade with the lights of the cluster a pixel falls into.
+class LightClusters
+{
+public:
+  LightClusters();
+  ~LightClusters();
+
+  void update(const mat4& perspective, const mat4& view,
+              const std::vector<Lights::PointLight>& point_lights);
+  // Over every cluster, as of the last update
+  float get_average_lights() const;
+
+private:
+  struct LightBounds {
+    vec3 center;
+    float radius;
+    int min_x, max_x, min_y, max_y, min_z, max_z;
+  };
+
+  void update_cluster_bounds(const mat4& perspective);
+  void assign_slice(int z, const std::vector<LightBounds>& light_bounds);
+  void upload();
+
+  unsigned int UBO, grid_SSBO, index_SSBO;
+  size_t grid_capacity, index_capacity;
+
+  mat4 cluster_perspective;
+  float near_plane, far_plane;
+
+  std::vector<float> min_x, max_x, min_y, max_y, min_z, max_z;
+  std::vector<std::vector<unsigned int>> slice_lights;
+  std::vector<std::vector<unsigned int>> cluster_lights;
+  std::vector<unsigned int> grid;
+  std::vector<unsigned int> indices;
+};
+
+#endif // LIGHT_CLUSTERS_H
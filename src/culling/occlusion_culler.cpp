@@ -0,0 +1,338 @@
+#include "occlusion_culler.h"
+#include "util/logging.h"
+#include "util/profiling/profiling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <emmintrin.h>
+
+constexpr int TILE_WIDTH = 32;
+constexpr int TILE_HEIGHT = 8;
+constexpr int TILE_SIZE = TILE_WIDTH * TILE_HEIGHT;
+constexpr float CLEAR_DEPTH = 1.0f;
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+  : width((width + TILE_WIDTH - 1) / TILE_WIDTH * TILE_WIDTH),
+    height((height + TILE_HEIGHT - 1) / TILE_HEIGHT * TILE_HEIGHT),
+    tiles_x(this->width / TILE_WIDTH),
+    tiles_y(this->height / TILE_HEIGHT),
+    view_projection(1.0f),
+    tile_bins(static_cast<size_t>(tiles_x * tiles_y)),
+    depth(static_cast<size_t>(this->width * this->height), CLEAR_DEPTH),
+    tile_max_depth(static_cast<size_t>(tiles_x * tiles_y), CLEAR_DEPTH),
+    num_frames(0),
+    num_triangles(0),
+    num_tested(0),
+    num_culled(0)
+{
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+  if (num_frames == 0) {
+    return;
+  }
+
+  const double cull_rate = num_tested == 0 ? 0.0 : 100.0 * num_culled / num_tested;
+
+  logger_t logger = Logging::get_logger();
+  logger << "-----------------------------------------------------" << std::endl;
+  logger << "                  Occlusion Culling                  " << std::endl;
+  logger << "-----------------------------------------------------" << std::endl;
+  logger << "Resolution: " << width << "x" << height << std::endl;
+  logger << "Occluder triangles per frame: "
+         << static_cast<double>(num_triangles) / num_frames << std::endl;
+  logger << "Occludees tested per frame: "
+         << static_cast<double>(num_tested) / num_frames << std::endl;
+  logger << "Occludees culled per frame: "
+         << static_cast<double>(num_culled) / num_frames << std::endl;
+  logger << "Cull rate: " << cull_rate << " %" << std::endl;
+}
+
+void OcclusionCuller::begin_frame(const mat4& view_projection)
+{
+  this->view_projection = view_projection;
+
+  triangles.clear();
+  for (auto& bin : tile_bins) {
+    bin.clear();
+  }
+
+  std::fill(depth.begin(), depth.end(), CLEAR_DEPTH);
+  std::fill(tile_max_depth.begin(), tile_max_depth.end(), CLEAR_DEPTH);
+
+  num_frames++;
+}
+
+void OcclusionCuller::add_occluder(const float* vertices, int stride,
+                                   const unsigned int* indices, int num_indices,
+                                   const mat4& model)
+{
+  const mat4 mvp = view_projection * model;
+  const int num_new_triangles = num_indices / 3;
+  const size_t first = triangles.size();
+
+  triangles.resize(first + static_cast<size_t>(num_new_triangles));
+
+  #pragma omp parallel for
+  for (int i = 0; i < num_new_triangles; i++) {
+    vec4 clip[3];
+
+    for (int j = 0; j < 3; j++) {
+      const float* position = vertices + indices[i * 3 + j] * static_cast<unsigned int>(stride);
+      clip[j] = mvp * vec4(position[0], position[1], position[2], 1.0f);
+    }
+
+    Triangle& triangle = triangles[first + static_cast<size_t>(i)];
+
+    if (!setup_triangle(clip, triangle)) {
+      triangle.min_x = 1;
+      triangle.max_x = 0;
+    }
+  }
+}
+
+bool OcclusionCuller::setup_triangle(const vec4 clip[3], Triangle& triangle) const
+{
+  float x[3], y[3], z[3];
+
+  for (int i = 0; i < 3; i++) {
+    // Clipping is not worth it at this resolution, and dropping an occluder is always safe
+    if (clip[i].w <= 0.0f || clip[i].z < -clip[i].w) {
+      return false;
+    }
+
+    const float inv_w = 1.0f / clip[i].w;
+    x[i] = (clip[i].x * inv_w * 0.5f + 0.5f) * width;
+    y[i] = (clip[i].y * inv_w * 0.5f + 0.5f) * height;
+    z[i] = clip[i].z * inv_w * 0.5f + 0.5f;
+  }
+
+  const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+  if (area == 0.0f) {
+    return false;
+  }
+
+  triangle.min_x = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+  triangle.min_y = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+  triangle.max_x = std::min(width - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+  triangle.max_y = std::min(height - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+
+  if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+    return false;
+  }
+
+  // Occluders are rasterized from both sides, so flip the edges of clockwise triangles
+  const float orientation = area > 0.0f ? 1.0f : -1.0f;
+
+  for (int i = 0; i < 3; i++) {
+    const int a = i;
+    const int b = (i + 1) % 3;
+
+    triangle.edge_x[i] = -(y[b] - y[a]) * orientation;
+    triangle.edge_y[i] = (x[b] - x[a]) * orientation;
+    triangle.edge_c[i] = ((y[b] - y[a]) * x[a] - (x[b] - x[a]) * y[a]) * orientation;
+  }
+
+  const float dx1 = x[1] - x[0], dy1 = y[1] - y[0], dz1 = z[1] - z[0];
+  const float dx2 = x[2] - x[0], dy2 = y[2] - y[0], dz2 = z[2] - z[0];
+
+  triangle.depth_x = (dz1 * dy2 - dz2 * dy1) / area;
+  triangle.depth_y = (dx1 * dz2 - dx2 * dz1) / area;
+  triangle.depth_c = z[0] - triangle.depth_x * x[0] - triangle.depth_y * y[0];
+
+  return true;
+}
+
+void OcclusionCuller::rasterize()
+{
+  PROFILE_SCOPE("OcclusionCuller")
+
+  PROFILE_SECTION_START("Bin Triangles")
+  for (unsigned int i = 0; i < triangles.size(); i++) {
+    const Triangle& triangle = triangles[i];
+
+    if (triangle.min_x > triangle.max_x) {
+      continue;
+    }
+
+    for (int ty = triangle.min_y / TILE_HEIGHT; ty <= triangle.max_y / TILE_HEIGHT; ty++) {
+      for (int tx = triangle.min_x / TILE_WIDTH; tx <= triangle.max_x / TILE_WIDTH; tx++) {
+        tile_bins[static_cast<size_t>(ty * tiles_x + tx)].emplace_back(i);
+      }
+    }
+  }
+
+  num_triangles += triangles.size();
+  PROFILE_SECTION_END()
+
+  PROFILE_SECTION_START("Rasterize Tiles")
+  #pragma omp parallel for schedule(dynamic)
+  for (int tile = 0; tile < tiles_x * tiles_y; tile++) {
+    rasterize_tile(tile);
+  }
+  PROFILE_SECTION_END()
+}
+
+void OcclusionCuller::rasterize_tile(int tile)
+{
+  const auto& bin = tile_bins[static_cast<size_t>(tile)];
+
+  if (bin.empty()) {
+    return;
+  }
+
+  const int tile_x = (tile % tiles_x) * TILE_WIDTH;
+  const int tile_y = (tile / tiles_x) * TILE_HEIGHT;
+  float* tile_depth = depth.data() + tile * TILE_SIZE;
+
+  const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+  const __m128 zero = _mm_setzero_ps();
+
+  for (unsigned int index : bin) {
+    const Triangle& triangle = triangles[index];
+
+    const int x0 = std::max(triangle.min_x, tile_x) & ~3;
+    const int x1 = std::min(triangle.max_x, tile_x + TILE_WIDTH - 1);
+    const int y0 = std::max(triangle.min_y, tile_y);
+    const int y1 = std::min(triangle.max_y, tile_y + TILE_HEIGHT - 1);
+
+    const __m128 edge_x0 = _mm_set1_ps(triangle.edge_x[0]);
+    const __m128 edge_x1 = _mm_set1_ps(triangle.edge_x[1]);
+    const __m128 edge_x2 = _mm_set1_ps(triangle.edge_x[2]);
+    const __m128 depth_x = _mm_set1_ps(triangle.depth_x);
+
+    for (int y = y0; y <= y1; y++) {
+      const float center_y = static_cast<float>(y) + 0.5f;
+      const __m128 row_edge0 = _mm_set1_ps(triangle.edge_y[0] * center_y + triangle.edge_c[0]);
+      const __m128 row_edge1 = _mm_set1_ps(triangle.edge_y[1] * center_y + triangle.edge_c[1]);
+      const __m128 row_edge2 = _mm_set1_ps(triangle.edge_y[2] * center_y + triangle.edge_c[2]);
+      const __m128 row_depth = _mm_set1_ps(triangle.depth_y * center_y + triangle.depth_c);
+      float* row = tile_depth + (y - tile_y) * TILE_WIDTH - tile_x;
+
+      for (int x = x0; x <= x1; x += 4) {
+        const __m128 center_x = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_offsets);
+
+        const __m128 edge0 = _mm_add_ps(_mm_mul_ps(edge_x0, center_x), row_edge0);
+        const __m128 edge1 = _mm_add_ps(_mm_mul_ps(edge_x1, center_x), row_edge1);
+        const __m128 edge2 = _mm_add_ps(_mm_mul_ps(edge_x2, center_x), row_edge2);
+        const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge0, zero),
+                                                    _mm_cmpge_ps(edge1, zero)),
+                                         _mm_cmpge_ps(edge2, zero));
+
+        if (_mm_movemask_ps(inside) == 0) {
+          continue;
+        }
+
+        const __m128 z = _mm_add_ps(_mm_mul_ps(depth_x, center_x), row_depth);
+        const __m128 old_z = _mm_loadu_ps(row + x);
+        const __m128 new_z = _mm_min_ps(old_z, z);
+
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_z), _mm_andnot_ps(inside, old_z)));
+      }
+    }
+  }
+
+  __m128 max_z = _mm_loadu_ps(tile_depth);
+
+  for (int i = 4; i < TILE_SIZE; i += 4) {
+    max_z = _mm_max_ps(max_z, _mm_loadu_ps(tile_depth + i));
+  }
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, max_z);
+  tile_max_depth[static_cast<size_t>(tile)] = std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+}
+
+bool OcclusionCuller::is_visible(const AABB& bounds)
+{
+  num_tested++;
+
+  if (test_bounds(bounds)) {
+    return true;
+  }
+
+  num_culled++;
+  return false;
+}
+
+bool OcclusionCuller::test_bounds(const AABB& bounds) const
+{
+  float min_x = std::numeric_limits<float>::max(), max_x = std::numeric_limits<float>::lowest();
+  float min_y = std::numeric_limits<float>::max(), max_y = std::numeric_limits<float>::lowest();
+  float min_z = std::numeric_limits<float>::max();
+  vec4 clip[8];
+  int num_behind = 0;
+
+  for (int i = 0; i < 8; i++) {
+    clip[i] = view_projection * vec4(bounds.corner(i), 1.0f);
+
+    if (clip[i].z < -clip[i].w) {
+      num_behind++;
+    }
+  }
+
+  // Boxes crossing the near plane cover most of the screen anyways
+  if (num_behind > 0) {
+    return num_behind < 8;
+  }
+
+  for (int i = 0; i < 8; i++) {
+    const float inv_w = 1.0f / clip[i].w;
+    const float x = (clip[i].x * inv_w * 0.5f + 0.5f) * width;
+    const float y = (clip[i].y * inv_w * 0.5f + 0.5f) * height;
+
+    min_x = std::min(min_x, x);
+    max_x = std::max(max_x, x);
+    min_y = std::min(min_y, y);
+    max_y = std::max(max_y, y);
+    min_z = std::min(min_z, clip[i].z * inv_w * 0.5f + 0.5f);
+  }
+
+  if (max_x < 0.0f || max_y < 0.0f || min_x >= width || min_y >= height || min_z > 1.0f) {
+    return false;
+  }
+
+  const int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+  const int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+  const int x1 = std::min(width - 1, static_cast<int>(std::floor(max_x)));
+  const int y1 = std::min(height - 1, static_cast<int>(std::floor(max_y)));
+
+  const __m128 occludee_z = _mm_set1_ps(min_z);
+  const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+  const __m128 first_x = _mm_set1_ps(static_cast<float>(x0) - 0.5f);
+  const __m128 last_x = _mm_set1_ps(static_cast<float>(x1) + 0.5f);
+
+  for (int ty = y0 / TILE_HEIGHT; ty <= y1 / TILE_HEIGHT; ty++) {
+    for (int tx = x0 / TILE_WIDTH; tx <= x1 / TILE_WIDTH; tx++) {
+      const int tile = ty * tiles_x + tx;
+
+      if (min_z >= tile_max_depth[static_cast<size_t>(tile)]) {
+        continue;
+      }
+
+      const int tile_x = tx * TILE_WIDTH;
+      const int tile_y = ty * TILE_HEIGHT;
+      const float* tile_depth = depth.data() + tile * TILE_SIZE;
+
+      for (int y = std::max(y0, tile_y); y <= std::min(y1, tile_y + TILE_HEIGHT - 1); y++) {
+        const float* row = tile_depth + (y - tile_y) * TILE_WIDTH - tile_x;
+
+        for (int x = std::max(x0, tile_x) & ~3; x <= std::min(x1, tile_x + TILE_WIDTH - 1); x += 4) {
+          const __m128 pixel_x = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes);
+          const __m128 in_rect = _mm_and_ps(_mm_cmpgt_ps(pixel_x, first_x),
+                                            _mm_cmplt_ps(pixel_x, last_x));
+          const __m128 closer = _mm_cmplt_ps(occludee_z, _mm_loadu_ps(row + x));
+
+          if (_mm_movemask_ps(_mm_and_ps(in_rect, closer)) != 0) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+
+  return false;
+}
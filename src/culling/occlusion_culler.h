@@ -0,0 +1,54 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include "culling/bounds.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+typedef glm::mat4 mat4;
+
+// Low resolution software depth buffer used to reject occludees before they are submitted.
+// Occluder triangles are binned into tiles and each tile is rasterized independently with SSE,
+// tiles are spread over OpenMP threads. Every tile keeps its farthest depth so that most occludee
+// tests are answered without touching individual pixels, like masked occlusion culling.
+class OcclusionCuller
+{
+public:
+  OcclusionCuller(int width, int height);
+  ~OcclusionCuller();
+
+  void begin_frame(const mat4& view_projection);
+  void add_occluder(const float* vertices, int stride, const unsigned int* indices, int num_indices,
+                    const mat4& model);
+  void rasterize();
+  bool is_visible(const AABB& bounds);
+
+private:
+  struct Triangle {
+    float edge_x[3], edge_y[3], edge_c[3];
+    float depth_x, depth_y, depth_c;
+    int min_x, min_y, max_x, max_y;
+  };
+
+  bool setup_triangle(const vec4 clip[3], Triangle& triangle) const;
+  void rasterize_tile(int tile);
+  bool test_bounds(const AABB& bounds) const;
+
+  int width, height;
+  int tiles_x, tiles_y;
+  mat4 view_projection;
+
+  std::vector<Triangle> triangles;
+  std::vector<std::vector<unsigned int>> tile_bins;
+  std::vector<float> depth;
+  std::vector<float> tile_max_depth;
+
+  unsigned long num_frames;
+  unsigned long num_triangles;
+  unsigned long num_tested;
+  unsigned long num_culled;
+};
+
+#endif // OCCLUSION_CULLER_H
@@ -16,7 +16,8 @@ Camera::Camera(vec3 position, vec3 forward, vec3 up)
     last_frame(0.0f),
     pitch(0.0f),
     yaw(270.0f),
-    fovy(45.0f)
+    fovy(45.0f),
+    jitter(0.0f)
 {
 }
 
@@ -25,10 +26,23 @@ mat4 Camera::lookat() const {
 }
 
 mat4 Camera::perspective() const {
+  // Clip space w is minus the view space z, so this moves every depth by the same offset
+  mat4 projection = unjittered_perspective();
+  projection[2][0] -= jitter.x;
+  projection[2][1] -= jitter.y;
+
+  return projection;
+}
+
+mat4 Camera::unjittered_perspective() const {
   return glm::perspective(glm::radians(fovy), static_cast<float>(Window::width()) / Window::height(),
                           0.1f, 100.0f);
 }
 
+void Camera::set_jitter(vec2 jitter) {
+  this->jitter = jitter;
+}
+
 void Camera::move(Direction direction) {
   switch (direction) {
     case Direction::FORWARD:
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+typedef glm::vec2 vec2;
 typedef glm::vec3 vec3;
 typedef glm::mat4 mat4;
 
@@ -22,7 +23,11 @@ public:
   };
 
   mat4 lookat() const;
+  // Includes the sub-pixel jitter set for temporal anti-aliasing
   mat4 perspective() const;
+  mat4 unjittered_perspective() const;
+  // Offset of the projection in normalized device coordinates
+  void set_jitter(vec2 jitter);
   void move(Direction direction);
   void update_frames();
   void update_direction(float delta_x, float delta_y);
@@ -40,6 +45,7 @@ private:
   float pitch;
   float yaw;
   float fovy;
+  vec2 jitter;
 };
 
 #endif // CAMERA_H
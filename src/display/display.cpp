@@ -1,72 +1,658 @@
 #include "display.h"
+#include "framebuffer/bandwidth.h"
 #include "util/data.h"
 #include "display/window.h"
+#include "util/logging.h"
 #include "util/profiling/profiling.h"
 
+#include <array>
+#include <cmath>
+#include <iterator>
+#include <numeric>
+#include <string>
+
 #include <glm/gtc/matrix_transform.hpp>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
 constexpr vec3 POINT_LIGHT_POS = vec3(0.0f, 3.0f, 2.0f);
+constexpr vec3 DIR_LIGHT_DIRECTION = vec3(-0.3f, -1.0f, -0.2f);
+constexpr int OCCLUSION_WIDTH = 320;
+constexpr int SHADOW_FACE_BUDGET = 12;
+constexpr int DIR_SHADOW_RESOLUTION = 2048;
+constexpr int NUM_SHADOW_CASCADES = 3;
+constexpr int SHADOW_FILTER_TAP_STEP = 4;
+constexpr int BLOOM_DEPTH = 6;
+// Same number of passes as GaussianBlur
+constexpr int COMPUTE_BLUR_PASSES = 5;
+// GPU time per frame the render scale is chosen to stay within
+constexpr float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+constexpr unsigned int NUM_RANDOM_LIGHTS = 5;
+// Sets the influence radius of the random lights, see Lights::get_radius
+constexpr vec3 RANDOM_LIGHT_ATTENUATION = vec3(1.0f, 0.045f, 0.016f);
+constexpr float RANDOM_LIGHT_BOB_HEIGHT = 0.5f;
+
+// Every count is drawn with every radius in both lighting modes
+constexpr size_t SWEEP_LIGHT_COUNTS[] = { 16, 64, 256, 1024 };
+constexpr float SWEEP_LIGHT_RADII[] = { 2.0f, 5.0f, 10.0f, 20.0f };
+constexpr int NUM_SWEEP_SETUPS = std::size(SWEEP_LIGHT_COUNTS) * std::size(SWEEP_LIGHT_RADII);
+constexpr int NUM_SWEEP_STEPS = 2 * NUM_SWEEP_SETUPS;
+// Frames left out after each change, the GPU times are read a few frames late
+constexpr int SWEEP_WARMUP_FRAMES = 30;
+constexpr int SWEEP_MEASURED_FRAMES = 120;
+
+static const std::vector<Object::Transform> CUBE_TRANSFORMS {
+  { {}, {}, vec3(0.0f, -2.0f, 0.0f) },
+  { {}, {}, vec3(2.0f, 4.0f, 2.0f) },
+  { {}, {}, vec3(-1.0f, 0.0f, -1.0f) },
+};
+
+static const Object::Transform BOX_TRANSFORM { vec3(15.0f), {}, {} };
+
+// Instances of the scene BVH, cubes are followed by the point light volumes
+constexpr unsigned int BOX_INSTANCE = 0;
+constexpr unsigned int MODEL_INSTANCE = 1;
+constexpr unsigned int FIRST_CUBE_INSTANCE = 2;
+
+// The random lights are added after the fixed point light
+constexpr size_t FIRST_RANDOM_LIGHT = 1;
 
 Display::Display(std::shared_ptr<Camera> camera)
   : camera(camera),
     model_nanosuit("../../assets/nanosuit_reflection/nanosuit.obj"),
-    point_shadow(1024, 1024, Window::width(), Window::height(), POINT_LIGHT_POS),
     blur(Window::width(), Window::height(),
          "../../shaders/processing/blur.vert", "../../shaders/processing/blur.frag",
          "../../shaders/processing/fb.vert", "../../shaders/processing/fb.frag"),
-    gbuffer(Window::width(), Window::height(),
-            "../../shaders/processing/deferred.vert", "../../shaders/processing/deferred.frag",
-            { GL_RGB16F, GL_RGB16F, GL_RGBA, GL_RGB16F, GL_RGB16F, GL_RGB16F }),
-    lights(camera)
+    bloom(Window::width(), Window::height(), BLOOM_DEPTH),
+    bloom_mode(BloomMode::MIP_CHAIN),
+    compute_post_process(Window::width(), Window::height()),
+    post_process_mode(PostProcessMode::FRAGMENT),
+    post_composer(PostComposer::BLOOM | PostComposer::EXPOSURE | PostComposer::TONEMAP |
+                  PostComposer::VIGNETTE),
+    dynamic_resolution(Window::width(), Window::height(), FRAME_BUDGET_MS),
+    upscaler(Window::width(), Window::height()),
+    upscale_preset(Upscaler::Preset::NATIVE),
+    spatial_upscaling(true),
+    anti_aliasing(Window::width(), Window::height(), AntiAliasing::Mode::FXAA),
+    visibility_buffer(Window::width(), Window::height()),
+    geometry_mode(GeometryMode::G_BUFFER),
+    lights(camera),
+    shadow_cache(Window::width(), Window::height(), SHADOW_FACE_BUDGET),
+    dir_shadow(DIR_SHADOW_RESOLUTION, NUM_SHADOW_CASCADES, Window::width(), Window::height(),
+               DIR_LIGHT_DIRECTION),
+    lighting_mode(LightingMode::FULL_SCREEN),
+    lights_animated(false),
+    sweep_step(-1),
+    sweep_frame(0),
+    sweep_gpu_ms(0.0),
+    occlusion_culler(OCCLUSION_WIDTH, OCCLUSION_WIDTH * Window::height() / Window::width()),
+    model_visible(true),
+    previous_view_projection(1.0f),
+    previous_sky_view_projection(1.0f),
+    previous_model_matrix(1.0f)
 {
   srand(static_cast<unsigned int>(time(nullptr)));
 
   init_shaders();
+  init_gbuffer(GBuffer::Layout::COMPACT_RG16);
   init_buffers();
   init_textures();
+  init_scene_bvh();
+  init_shadow_casters();
 }
 
-void Display::draw() const {
+void Display::draw() {
   PROFILE_SCOPE("Draw")
-  Object::set_world_space_transform(camera->perspective(), camera->lookat());
+  dynamic_resolution.begin_frame();
+  update_light_sweep();
 
-//  point_shadow.bind_depth_map();
+  // Targets stay at the window's size, only the top left part of them is rendered to
+  const int render_width = dynamic_resolution.get_width();
+  const int render_height = dynamic_resolution.get_height();
+  visibility_buffer.set_render_size(render_width, render_height);
+  bloom.set_render_size(render_width, render_height);
+  compute_post_process.set_render_size(render_width, render_height);
+  anti_aliasing.set_render_size(render_width, render_height);
+  camera->set_jitter(anti_aliasing.begin_frame());
 
-//  draw_model(*point_depth_shaders);
-//  draw_cubes(*point_depth_shaders);
+  const mat4 perspective = camera->perspective();
+  const mat4 view = camera->lookat();
+  Object::set_world_space_transform(perspective, view);
 
-//  point_shadow.bind_shadow_map("shadow_map", { gbuffer.get_shader() });
+  // Motion vectors leave the jitter out, so still surfaces don't move
+  const mat4 view_projection = camera->unjittered_perspective() * view;
+  const mat4 sky_view_projection = camera->unjittered_perspective() * mat4(mat3(view));
+  const mat4 sky_reprojection = previous_sky_view_projection * glm::inverse(sky_view_projection);
+  Object::set_motion_transforms(view_projection, previous_view_projection);
 
-  lights.update();
+  model_transform = {
+    vec3(0.2f),
+    std::make_pair(-static_cast<float>(glfwGetTime()), vec3(0.0f, 1.0f, 0.0f)),
+    vec3(0.0f, -0.5f, 0.0f)
+  };
 
-  PROFILE_SECTION_START("Geometry Pass")
-  gbuffer.bind_framebuffer();
+  if (lights_animated) {
+    PROFILE_SECTION_START("Animate Lights")
+    animate_lights(static_cast<float>(glfwGetTime()));
+    PROFILE_SECTION_END()
+  }
 
-  draw_cubes(*gbuffer_shaders);
-  draw_box(*gbuffer_shaders);
-  draw_model(*gbuffer_shaders);
+  lights.update();
+
+  if (lighting_mode == LightingMode::FULL_SCREEN) {
+    PROFILE_SECTION_START("Light Clustering")
+    light_clusters.update(perspective, view, lights.get_point_lights());
+    PROFILE_SECTION_END()
+  }
 
-  gbuffer.unbind_framebuffer();
+  PROFILE_SECTION_START("Culling")
+  cull_instances(perspective * view);
   PROFILE_SECTION_END()
 
-  PROFILE_SECTION_START("Lighting Pass")
-  blur.bind_framebuffer();
+  // The targets up to the HDR scene belong to their objects, the graph orders passes around
+  // them and owns the post-processing targets
+  render_graph.reset();
+  const auto shadow_maps = render_graph.import_texture("Shadow Maps", 0);
+  const auto gbuffer_targets = render_graph.import_texture("G-Buffer", 0);
+  const auto hdr = render_graph.import_texture("HDR", blur.get_hdr_texture());
+  const auto bright = render_graph.import_texture("Bright Colors", blur.get_bright_texture());
+  const auto backbuffer = render_graph.import_texture("Backbuffer", 0);
+  render_graph.mark_output(backbuffer);
 
-  gbuffer.draw_scene();
-  gbuffer.blit_depth();
-  PROFILE_SECTION_END()
+  render_graph.add_pass(PROFILE_ID("Shadow Maps"), {}, { shadow_maps },
+                        [&] (const RenderGraph&) {
+    caster_bounds.assign(scene_bounds.begin(),
+                         scene_bounds.begin() + FIRST_CUBE_INSTANCE + CUBE_TRANSFORMS.size());
+    update_shadow_casters();
+    shadow_cache.update(lights.get_point_lights(), caster_bounds, perspective * view,
+                        camera->get_position(), shadow_casters);
+    shadow_cache.bind_shadow_maps("shadow_maps", "shadow_compare_maps",
+                                  { gbuffer->get_shader(), gbuffer->get_dir_light_shader(),
+                                    light_volume_shaders });
 
-  PROFILE_SECTION_START("Forward Rendering")
-  draw_lights(*light_shaders);
-  draw_skybox(*skybox_shaders);
-  PROFILE_SECTION_END()
+    // The room is left out so the directional light can reach inside
+    caster_bounds[BOX_INSTANCE] = AABB();
+    dir_shadow.update(perspective, view, caster_bounds,
+                      [this] (const Shader& shader, const Frustum& frustum) {
+      draw_shadow_casters(shader, frustum, false);
+    });
+    dir_shadow.bind_shadow_map("dir_shadow_map", { gbuffer->get_shader(),
+                                                   gbuffer->get_dir_light_shader() });
+  });
+
+  // Motion vectors are only written out for TAA
+  const bool taa = anti_aliasing.get_mode() == AntiAliasing::Mode::TAA;
+  std::vector<FrameBuffer::StoreAction> gbuffer_stores(
+    static_cast<size_t>(gbuffer->get_num_color_targets()), FrameBuffer::StoreAction::STORE);
+  gbuffer_stores.back() = taa ? FrameBuffer::StoreAction::STORE
+                              : FrameBuffer::StoreAction::DISCARD;
+
+  if (geometry_mode == GeometryMode::G_BUFFER) {
+    render_graph.add_pass(geometry_pass_name, {}, { gbuffer_targets },
+                          [&] (const RenderGraph&) {
+      dynamic_resolution.set_viewport();
+      gbuffer->bind_framebuffer();
+
+      draw_cubes(*gbuffer_shaders, visible_cubes);
+      draw_box(*gbuffer_shaders);
+      if (model_visible) {
+        // The model turns every frame, its motion vectors need where it was
+        gbuffer_shaders->use_shader_program();
+        glUniformMatrix4fv(gbuffer_shaders->get_uniform_location("previous_model"), 1, GL_FALSE,
+                           &previous_model_matrix[0][0]);
+        glUniform1i(gbuffer_shaders->get_uniform_location("has_previous_model"), 1);
+        draw_model(*gbuffer_shaders);
+        glUniform1i(gbuffer_shaders->get_uniform_location("has_previous_model"), 0);
+      }
+
+      gbuffer->store_framebuffer(gbuffer_stores, FrameBuffer::StoreAction::STORE);
+      gbuffer->unbind_framebuffer();
+    });
+  } else {
+    render_graph.add_pass(visibility_geometry_pass_name, {}, { gbuffer_targets },
+                          [&] (const RenderGraph&) {
+      dynamic_resolution.set_viewport();
+      draw_visibility(perspective * view);
+      gbuffer->store_framebuffer(gbuffer_stores, FrameBuffer::StoreAction::STORE);
+      gbuffer->unbind_framebuffer();
+    });
+  }
+
+  if (lighting_mode == LightingMode::FULL_SCREEN) {
+    render_graph.add_pass(lighting_pass_name, { gbuffer_targets, shadow_maps },
+                          { hdr, bright }, [&] (const RenderGraph&) {
+      // Every pixel is lit and the depth is copied over, so neither needs to be cleared
+      dynamic_resolution.set_viewport();
+      blur.bind_framebuffer({ FrameBuffer::LoadAction::DONT_CARE },
+                            FrameBuffer::LoadAction::DONT_CARE);
+      gbuffer->draw_scene();
+      gbuffer->blit_depth();
+      gbuffer->discard_targets(taa);
+      blur.store_framebuffer({ FrameBuffer::StoreAction::STORE }, FrameBuffer::StoreAction::STORE);
+    });
+  } else {
+    render_graph.add_pass(light_volume_pass_name, { gbuffer_targets, shadow_maps },
+                          { hdr, bright }, [&] (const RenderGraph&) {
+      // The directional lights cover every pixel like in the full-screen pass, the point
+      // lights are added on top of them
+      dynamic_resolution.set_viewport();
+      blur.bind_framebuffer({ FrameBuffer::LoadAction::DONT_CARE },
+                            FrameBuffer::LoadAction::DONT_CARE);
+      gbuffer->draw_dir_lights();
+      gbuffer->blit_depth();
+      draw_light_volumes(*light_volume_shaders);
+      gbuffer->discard_targets(taa);
+      blur.store_framebuffer({ FrameBuffer::StoreAction::STORE }, FrameBuffer::StoreAction::STORE);
+    });
+  }
+
+  render_graph.add_pass(PROFILE_ID("Forward Rendering"), { hdr, bright }, { hdr, bright },
+                        [&] (const RenderGraph&) {
+    // Draws over the lit scene, its depth isn't needed after
+    dynamic_resolution.set_viewport();
+    blur.bind_framebuffer({ FrameBuffer::LoadAction::LOAD }, FrameBuffer::LoadAction::LOAD);
+    draw_lights(*light_shaders);
+    draw_skybox(*skybox_shaders);
+    blur.store_framebuffer({ FrameBuffer::StoreAction::STORE }, FrameBuffer::StoreAction::DISCARD);
+    blur.unbind_framebuffer();
+  });
+
+  // The resolved history stands in for the HDR scene in everything after it
+  const auto scene = taa ? render_graph.import_texture("TAA History",
+                                                       anti_aliasing.get_history_target())
+                         : hdr;
+
+  if (taa) {
+    render_graph.add_pass(PROFILE_ID("Anti-Aliasing (TAA)"), { hdr, gbuffer_targets },
+                          { scene }, [&] (const RenderGraph& graph) {
+      dynamic_resolution.set_viewport();
+      anti_aliasing.resolve(graph.get_texture(hdr), gbuffer->get_velocity_texture(),
+                            sky_reprojection);
+      gbuffer->discard_targets(false);
+    });
+  }
+
+  // Every bloom is declared, the ones the final pass doesn't read are culled along with
+  // their targets. Both blurs finish in their first target. Blurred light needs neither
+  // alpha nor the precision of RGBA16F, packed floats halve its traffic.
+  const RenderGraph::TextureDesc screen_desc {
+    Window::width(), Window::height(), GL_R11F_G11F_B10F
+  };
+  const RenderGraph::TextureDesc compute_desc {
+    Window::width(), Window::height(), compute_post_process.get_blur_format()
+  };
+  const std::array<RenderGraph::Resource, 2> blur_targets {
+    render_graph.create_texture("Blur Ping", screen_desc),
+    render_graph.create_texture("Blur Pong", screen_desc),
+  };
+  const std::array<RenderGraph::Resource, 2> compute_blur_targets {
+    render_graph.create_texture("Compute Blur Ping", compute_desc),
+    render_graph.create_texture("Compute Blur Pong", compute_desc),
+  };
+  std::vector<RenderGraph::Resource> bloom_levels;
+
+  for (int i = 0; i < bloom.get_depth(); i++) {
+    const auto [level_width, level_height] = bloom.get_level_size(i);
+    bloom_levels.emplace_back(render_graph.create_texture("Bloom Level " + std::to_string(i),
+                                                          { level_width, level_height,
+                                                            GL_R11F_G11F_B10F }));
+  }
+
+  render_graph.add_pass(PROFILE_ID("Blur"), { bright },
+                        { blur_targets.begin(), blur_targets.end() },
+                        [&] (const RenderGraph& graph) {
+    dynamic_resolution.set_viewport();
+    blur.blur({ graph.get_texture(blur_targets[0]), graph.get_texture(blur_targets[1]) });
+  });
+
+  render_graph.add_pass(PROFILE_ID("Blur (Compute)"), { bright },
+                        { compute_blur_targets.begin(), compute_blur_targets.end() },
+                        [&] (const RenderGraph& graph) {
+    compute_post_process.blur(graph.get_texture(bright), COMPUTE_BLUR_PASSES,
+                              { graph.get_texture(compute_blur_targets[0]),
+                                graph.get_texture(compute_blur_targets[1]) });
+  });
+
+  render_graph.add_pass(bloom_pass_name, { scene }, bloom_levels, [&] (const RenderGraph& graph) {
+    std::vector<unsigned int> targets;
+    for (const auto level : bloom_levels) {
+      targets.emplace_back(graph.get_texture(level));
+    }
+
+    bloom.render(graph.get_texture(scene), targets);
+  });
+
+  const bool compute = post_process_mode == PostProcessMode::COMPUTE;
+  RenderGraph::Resource bloom_result;
+  float bloom_strength;
+
+  if (bloom_mode == BloomMode::GAUSSIAN) {
+    bloom_result = compute ? compute_blur_targets[0] : blur_targets[0];
+    bloom_strength = 1.0f;
+  } else {
+    bloom_result = bloom_levels.front();
+    bloom_strength = bloom.get_strength();
+  }
+
+  // Below the window's size the frame is finished at the render size and upscaled after,
+  // otherwise the last pass upscales bilinearly on its way to the backbuffer
+  const bool upscale = spatial_upscaling && render_width < Window::width();
+  const bool fxaa = anti_aliasing.get_mode() == AntiAliasing::Mode::FXAA;
+  // FXAA and the upscaler both read the frame from a target at the render size
+  const bool intermediate = upscale || fxaa;
+  RenderGraph::Resource composed = backbuffer;
+  bool encoded = false;
+
+  // Resources declared in the branches below are captured by value, the passes run after
+  // they go out of scope
+  if (compute) {
+    const auto tonemapped = render_graph.create_texture("Tonemapped", {
+      Window::width(), Window::height(), GL_RGBA8
+    });
+
+    render_graph.add_pass(PROFILE_ID("Tonemap (Compute)"), { scene, bloom_result },
+                          { tonemapped }, [&, tonemapped] (const RenderGraph& graph) {
+      compute_post_process.tonemap(graph.get_texture(scene), graph.get_texture(bloom_result),
+                                   bloom_strength, graph.get_texture(tonemapped));
+    });
+
+    if (intermediate) {
+      composed = tonemapped;
+      encoded = true;
+    } else {
+      render_graph.add_pass(PROFILE_ID("Present"), { tonemapped }, { backbuffer },
+                            [&, tonemapped] (const RenderGraph& graph) {
+        dynamic_resolution.set_full_viewport();
+        compute_post_process.present(graph.get_texture(tonemapped));
+      });
+    }
+  } else {
+    if (intermediate) {
+      composed = render_graph.create_texture("Composed", {
+        Window::width(), Window::height(), GL_RGB10_A2
+      });
+      encoded = post_composer.is_output_encoded();
+    }
+
+    render_graph.add_pass(compose_pass_name, { scene, bloom_result }, { composed },
+                          [&, composed] (const RenderGraph& graph) {
+      if (intermediate) {
+        upscaler.bind_target(graph.get_texture(composed));
+        dynamic_resolution.set_viewport();
+      } else {
+        dynamic_resolution.set_full_viewport();
+      }
+
+      post_composer.draw(graph.get_texture(scene), graph.get_texture(bloom_result),
+                         bloom_strength);
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    });
+  }
+
+  RenderGraph::Resource antialiased = composed;
+
+  if (fxaa) {
+    antialiased = upscale ? render_graph.create_texture("Anti-Aliased", {
+                              Window::width(), Window::height(), GL_RGB10_A2
+                            })
+                          : backbuffer;
+
+    render_graph.add_pass(PROFILE_ID("Anti-Aliasing (FXAA)"), { composed }, { antialiased },
+                          [&, composed, antialiased] (const RenderGraph& graph) {
+      if (upscale) {
+        anti_aliasing.bind_target(graph.get_texture(antialiased));
+        dynamic_resolution.set_viewport();
+      } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        dynamic_resolution.set_full_viewport();
+      }
+
+      anti_aliasing.fxaa(graph.get_texture(composed), encoded);
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    });
+  }
+
+  if (upscale) {
+    const auto upscaled = render_graph.create_texture("Upscaled", {
+      Window::width(), Window::height(), GL_RGB10_A2
+    });
+
+    render_graph.add_pass(PROFILE_ID("Upscale (EASU)"), { antialiased }, { upscaled },
+                          [&, antialiased, upscaled] (const RenderGraph& graph) {
+      upscaler.upscale(graph.get_texture(antialiased), render_width, render_height, encoded,
+                       graph.get_texture(upscaled));
+    });
 
-  PROFILE_SECTION_START("Blur")
-  blur.unbind_framebuffer();
-  blur.blur_scene();
+    render_graph.add_pass(PROFILE_ID("Sharpen (RCAS)"), { upscaled }, { backbuffer },
+                          [&, upscaled] (const RenderGraph& graph) {
+      upscaler.sharpen(graph.get_texture(upscaled), encoded);
+    });
+  }
+
+  render_graph.compile();
+
+  // The render scale is logged by DynamicResolution when it changes
+  PROFILE_SECTION_START("Frame")
+  render_graph.execute();
   PROFILE_SECTION_END()
+
+  dynamic_resolution.end_frame();
+  BandwidthStats::end_frame();
+
+  previous_view_projection = view_projection;
+  previous_sky_view_projection = sky_view_projection;
+  previous_model_matrix = Object::get_model_matrix(model_transform);
+}
+
+void Display::cycle_lighting_mode()
+{
+  switch (lighting_mode) {
+    case LightingMode::FULL_SCREEN:
+      lighting_mode = LightingMode::LIGHT_VOLUMES;
+      break;
+    case LightingMode::LIGHT_VOLUMES:
+      lighting_mode = LightingMode::FULL_SCREEN;
+      break;
+  }
+}
+
+void Display::toggle_light_animation()
+{
+  lights_animated = !lights_animated;
+}
+
+void Display::start_light_sweep()
+{
+  dynamic_resolution.set_fixed_scale(1.0f);
+  sweep_step = 0;
+  set_light_sweep_step();
+}
+
+bool Display::is_light_sweep_done() const
+{
+  return sweep_step >= NUM_SWEEP_STEPS;
+}
+
+void Display::cycle_shadow_cascades()
+{
+  dir_shadow.set_num_cascades(dir_shadow.get_num_cascades() % MAX_CASCADES + 1);
+}
+
+void Display::cycle_shadow_resolution()
+{
+  const int resolution = dir_shadow.get_resolution();
+  dir_shadow.set_resolution(resolution >= 4096 ? 512 : 2 * resolution);
+}
+
+void Display::cycle_point_shadow_mode()
+{
+  switch (shadow_cache.get_render_mode()) {
+    case PointShadowCache::RenderMode::VERTEX_LAYER:
+      shadow_cache.set_render_mode(PointShadowCache::RenderMode::GEOMETRY_SHADER);
+      break;
+    case PointShadowCache::RenderMode::GEOMETRY_SHADER:
+      shadow_cache.set_render_mode(PointShadowCache::RenderMode::PER_FACE);
+      break;
+    case PointShadowCache::RenderMode::PER_FACE:
+      shadow_cache.set_render_mode(PointShadowCache::RenderMode::VERTEX_LAYER);
+      break;
+  }
+}
+
+void Display::cycle_shadow_filter()
+{
+  switch (shadow_cache.get_filter()) {
+    case PointShadowCache::ShadowFilter::MANUAL:
+      shadow_cache.set_filter(PointShadowCache::ShadowFilter::HARDWARE);
+      break;
+    case PointShadowCache::ShadowFilter::HARDWARE:
+      shadow_cache.set_filter(PointShadowCache::ShadowFilter::POISSON);
+      break;
+    case PointShadowCache::ShadowFilter::POISSON:
+      shadow_cache.set_filter(PointShadowCache::ShadowFilter::POISSON_EARLY_OUT);
+      break;
+    case PointShadowCache::ShadowFilter::POISSON_EARLY_OUT:
+      shadow_cache.set_filter(PointShadowCache::ShadowFilter::MANUAL);
+      break;
+  }
+
+  update_pass_names();
+}
+
+void Display::cycle_shadow_filter_taps()
+{
+  const int taps = shadow_cache.get_filter_taps();
+  shadow_cache.set_filter_taps(taps >= MAX_SHADOW_FILTER_TAPS ? SHADOW_FILTER_TAP_STEP
+                                                              : taps + SHADOW_FILTER_TAP_STEP);
+  update_pass_names();
+}
+
+void Display::cycle_gbuffer_layout()
+{
+  switch (gbuffer->get_layout()) {
+    case GBuffer::Layout::WIDE:
+      init_gbuffer(GBuffer::Layout::COMPACT_RG16);
+      break;
+    case GBuffer::Layout::COMPACT_RG16:
+      init_gbuffer(GBuffer::Layout::COMPACT_RGB10A2);
+      break;
+    case GBuffer::Layout::COMPACT_RGB10A2:
+      // The visibility buffer resolves into the compact targets only
+      init_gbuffer(geometry_mode == GeometryMode::G_BUFFER ? GBuffer::Layout::WIDE
+                                                           : GBuffer::Layout::COMPACT_RG16);
+      break;
+  }
+}
+
+void Display::cycle_geometry_mode()
+{
+  switch (geometry_mode) {
+    case GeometryMode::G_BUFFER:
+      geometry_mode = GeometryMode::VISIBILITY_BUFFER;
+
+      if (gbuffer->get_layout() == GBuffer::Layout::WIDE) {
+        init_gbuffer(GBuffer::Layout::COMPACT_RG16);
+      }
+      break;
+    case GeometryMode::VISIBILITY_BUFFER:
+      geometry_mode = GeometryMode::G_BUFFER;
+      break;
+  }
+}
+
+void Display::cycle_bloom_mode()
+{
+  log_bloom_time();
+
+  switch (bloom_mode) {
+    case BloomMode::GAUSSIAN:
+      bloom_mode = BloomMode::MIP_CHAIN;
+      break;
+    case BloomMode::MIP_CHAIN:
+      bloom_mode = BloomMode::GAUSSIAN;
+      break;
+  }
+}
+
+void Display::cycle_bloom_depth()
+{
+  log_bloom_time();
+  bloom.set_depth(bloom.get_depth() >= MAX_BLOOM_DEPTH ? 1 : bloom.get_depth() + 1);
+  update_pass_names();
+}
+
+void Display::cycle_post_process_mode()
+{
+  switch (post_process_mode) {
+    case PostProcessMode::FRAGMENT:
+      post_process_mode = PostProcessMode::COMPUTE;
+      break;
+    case PostProcessMode::COMPUTE:
+      post_process_mode = PostProcessMode::FRAGMENT;
+      break;
+  }
+}
+
+void Display::toggle_post_effect(int index)
+{
+  post_composer.toggle_effect(static_cast<PostComposer::Effect>(1 << index));
+  update_pass_names();
+}
+
+void Display::toggle_dynamic_resolution()
+{
+  dynamic_resolution.set_enabled(!dynamic_resolution.is_enabled());
+}
+
+void Display::cycle_upscale_preset()
+{
+  switch (upscale_preset) {
+    case Upscaler::Preset::NATIVE:
+      upscale_preset = Upscaler::Preset::ULTRA_QUALITY;
+      break;
+    case Upscaler::Preset::ULTRA_QUALITY:
+      upscale_preset = Upscaler::Preset::QUALITY;
+      break;
+    case Upscaler::Preset::QUALITY:
+      upscale_preset = Upscaler::Preset::BALANCED;
+      break;
+    case Upscaler::Preset::BALANCED:
+      upscale_preset = Upscaler::Preset::PERFORMANCE;
+      break;
+    case Upscaler::Preset::PERFORMANCE:
+      upscale_preset = Upscaler::Preset::NATIVE;
+      break;
+  }
+
+  // A preset fixes the scale until dynamic resolution is turned back on
+  dynamic_resolution.set_fixed_scale(Upscaler::get_scale(upscale_preset));
+
+  logger_t logger = Logging::get_logger();
+  logger << "Upscaling preset " << Upscaler::get_preset_name(upscale_preset) << ": rendering at "
+         << dynamic_resolution.get_width() << "x" << dynamic_resolution.get_height() << std::endl;
+}
+
+void Display::toggle_spatial_upscaling()
+{
+  spatial_upscaling = !spatial_upscaling;
+}
+
+void Display::cycle_anti_aliasing()
+{
+  switch (anti_aliasing.get_mode()) {
+    case AntiAliasing::Mode::NONE:
+      anti_aliasing.set_mode(AntiAliasing::Mode::FXAA);
+      break;
+    case AntiAliasing::Mode::FXAA:
+      anti_aliasing.set_mode(AntiAliasing::Mode::TAA);
+      break;
+    case AntiAliasing::Mode::TAA:
+      anti_aliasing.set_mode(AntiAliasing::Mode::NONE);
+      break;
+  }
+
+  logger_t logger = Logging::get_logger();
+  logger << "Anti-aliasing: " << anti_aliasing.get_mode_name() << std::endl;
 }
 
 void Display::init_buffers() {
@@ -83,6 +669,13 @@ void Display::init_buffers() {
   skybox.add_vertex_attribs({ 3 });
   skybox.finalize_setup();
 
+  lights.add_dir_light({
+   DIR_LIGHT_DIRECTION,
+   vec3(0.02f),
+   vec3(0.2f),
+   vec3(0.2f),
+  });
+
   lights.add_point_light({
    POINT_LIGHT_POS,
    vec3(0.05f),
@@ -91,18 +684,94 @@ void Display::init_buffers() {
    vec3(1.0f, 0.045f, 0.016f),
   });
 
-  for (unsigned int i = 0; i < 5; i++) {
+  add_random_lights(NUM_RANDOM_LIGHTS, RANDOM_LIGHT_ATTENUATION);
+}
+
+void Display::add_random_lights(size_t count, const vec3& attenuation)
+{
+  std::vector<Lights::PointLight> random_lights;
+  random_lights.reserve(count);
+
+  for (size_t i = 0; i < count; i++) {
     float x = (static_cast<float>((rand() % 100)) / 100.0f) * 12.0f - 6.0f;
     float y = (static_cast<float>((rand() % 100)) / 100.0f) * 12.0f - 6.0f;
     float z = (static_cast<float>((rand() % 100)) / 100.0f) * 12.0f - 6.0f;
-    lights.add_point_light({
+    random_light_positions.emplace_back(x, y, z);
+    random_lights.push_back({
      vec3(x, y, z),
      vec3(0.05f),
      vec3(0.5f, 0.5f, 2.0f),
      vec3(0.5f, 0.5f, 2.0f),
-     vec3(1.0f, 0.045f, 0.016f),
+     attenuation,
     });
   }
+
+  lights.add_point_lights(std::move(random_lights));
+  resize_scene_bounds();
+}
+
+void Display::animate_lights(float time)
+{
+  const auto& point_lights = lights.get_point_lights();
+  animated_lights.assign(point_lights.begin() + FIRST_RANDOM_LIGHT, point_lights.end());
+
+  for (size_t i = 0; i < animated_lights.size(); i++) {
+    animated_lights[i].position = random_light_positions[i] +
+      vec3(0.0f, std::sin(time + static_cast<float>(i)) * RANDOM_LIGHT_BOB_HEIGHT, 0.0f);
+  }
+
+  lights.update_point_lights(FIRST_RANDOM_LIGHT, animated_lights);
+}
+
+void Display::set_light_sweep_step()
+{
+  const int setup = sweep_step % NUM_SWEEP_SETUPS;
+  const size_t count = SWEEP_LIGHT_COUNTS[setup / std::size(SWEEP_LIGHT_RADII)];
+  const float radius = SWEEP_LIGHT_RADII[setup % std::size(SWEEP_LIGHT_RADII)];
+  lighting_mode = sweep_step < NUM_SWEEP_SETUPS ? LightingMode::FULL_SCREEN
+                                                : LightingMode::LIGHT_VOLUMES;
+
+  std::vector<size_t> random_lights(lights.get_point_lights().size() - FIRST_RANDOM_LIGHT);
+  std::iota(random_lights.begin(), random_lights.end(), FIRST_RANDOM_LIGHT);
+  lights.remove_point_lights(std::move(random_lights));
+  random_light_positions.clear();
+
+  // Without a linear term the radius goes with one over the root of the quadratic term
+  const float unit_radius = Lights::get_radius({
+    {}, {}, vec3(0.5f, 0.5f, 2.0f), vec3(0.5f, 0.5f, 2.0f), vec3(1.0f, 0.0f, 1.0f)
+  });
+  add_random_lights(count, vec3(1.0f, 0.0f, std::pow(unit_radius / radius, 2.0f)));
+
+  sweep_frame = 0;
+  sweep_gpu_ms = 0.0;
+}
+
+void Display::update_light_sweep()
+{
+  if (sweep_step < 0 || is_light_sweep_done()) {
+    return;
+  }
+
+  if (sweep_frame >= SWEEP_WARMUP_FRAMES) {
+    sweep_gpu_ms += dynamic_resolution.get_gpu_ms();
+  }
+
+  if (++sweep_frame < SWEEP_WARMUP_FRAMES + SWEEP_MEASURED_FRAMES) {
+    return;
+  }
+
+  const size_t num_random_lights = lights.get_point_lights().size() - FIRST_RANDOM_LIGHT;
+  const float radius = Lights::get_radius(lights.get_point_lights().back());
+
+  logger_t logger = Logging::get_logger();
+  logger << "Light sweep: "
+         << (lighting_mode == LightingMode::FULL_SCREEN ? "full screen" : "light volumes") << ", "
+         << num_random_lights << " lights of radius " << radius << ": "
+         << sweep_gpu_ms / SWEEP_MEASURED_FRAMES << " ms GPU per frame" << std::endl;
+
+  if (++sweep_step < NUM_SWEEP_STEPS) {
+    set_light_sweep_step();
+  }
 }
 
 void Display::init_textures() {
@@ -131,24 +800,232 @@ void Display::init_shaders() {
                                            "../../shaders/object/model.frag");
   skybox_shaders = std::make_shared<Shader>("../../shaders/object/skybox.vert",
                                             "../../shaders/object/skybox.frag");
-  point_depth_shaders = std::make_shared<Shader>("../../shaders/shadow/point_depth.vert",
-                                                 "../../shaders/shadow/point_depth.frag",
-                                                 "../../shaders/shadow/point_depth.geom");
+}
+
+void Display::init_gbuffer(GBuffer::Layout layout)
+{
+  gbuffer = std::make_unique<GBuffer>(Window::width(), Window::height(), layout);
+
+  // Everything writing or reading the G-buffer is compiled for its layout
   gbuffer_shaders = std::make_shared<Shader>("../../shaders/processing/gbuffer.vert",
-                                             "../../shaders/processing/gbuffer.frag");
+                                             "../../shaders/processing/gbuffer.frag",
+                                             std::nullopt, gbuffer->get_shader_defines());
+  light_volume_shaders = std::make_shared<Shader>("../../shaders/processing/light_volume.vert",
+                                                  "../../shaders/processing/light_volume.frag",
+                                                  std::nullopt, gbuffer->get_shader_defines() +
+                                                  PointShadowCache::get_shader_source());
+  update_pass_names();
 }
 
-void Display::draw_cubes(const Shader& shader) const
+void Display::update_pass_names()
 {
-  static const std::vector<Object::Transform> transforms {
-    { {}, {}, vec3(0.0f, -2.0f, 0.0f) },
-    { {}, {}, vec3(2.0f, 4.0f, 2.0f) },
-    { {}, {}, vec3(-1.0f, 0.0f, -1.0f) },
-    { {}, {}, vec3(2.0f, 0.0f, 0.0f) }
-  };
+  // Named after the G-buffer layout, the shadow filter, the bloom depth and the post effects
+  // so the cost of each shows up separately
+  const char* layout = gbuffer->get_layout_name();
+  geometry_pass_name = Profiling::intern_format("Geometry Pass (%s)", layout);
+  visibility_geometry_pass_name = Profiling::intern_format("Visibility Geometry Pass (%s)",
+                                                           layout);
+  lighting_pass_name = Profiling::intern_format("Lighting Pass (%s, %s %d)", layout,
+                                                shadow_cache.get_filter_name(),
+                                                shadow_cache.get_filter_taps());
+  light_volume_pass_name = Profiling::intern_format("Light Volume Pass (%s, %s %d)", layout,
+                                                    shadow_cache.get_filter_name(),
+                                                    shadow_cache.get_filter_taps());
+  bloom_pass_name = Profiling::intern_format("Bloom (Mip Chain %d)", bloom.get_depth());
+  compose_pass_name = Profiling::intern("Compose (" + post_composer.get_effect_names() + ")");
+}
+
+void Display::log_bloom_time() const
+{
+  // GPU time of the bloom being switched away from, to compare them at the render size
+  std::string name = Profiling::get_name(bloom_pass_name);
+  if (bloom_mode == BloomMode::GAUSSIAN) {
+    name = post_process_mode == PostProcessMode::COMPUTE ? "Blur (Compute)" : "Blur";
+  }
+
+  const Profiling::Statistics statistics = Profiling::get_statistics(name, true);
+  if (statistics.get_count() == 0) {
+    return;
+  }
+
+  logger_t logger = Logging::get_logger();
+  logger << name << " at " << dynamic_resolution.get_width() << "x"
+         << dynamic_resolution.get_height() << ": "
+         << statistics.get_percentile(0.5) / 1e6 << " ms GPU median over "
+         << statistics.get_count() << " frames" << std::endl;
+}
+
+void Display::init_scene_bvh()
+{
+  model_transform = { vec3(0.2f), {}, vec3(0.0f, -0.5f, 0.0f) };
+
+  const AABB cube_bounds { vec3(-0.5f), vec3(0.5f) };
+  scene_bounds[BOX_INSTANCE] = cube_bounds.transform(Object::get_model_matrix(BOX_TRANSFORM));
+
+  for (unsigned int i = 0; i < CUBE_TRANSFORMS.size(); i++) {
+    scene_bounds[FIRST_CUBE_INSTANCE + i] =
+      cube_bounds.transform(Object::get_model_matrix(CUBE_TRANSFORMS[i]));
+  }
+
+  resize_scene_bounds();
+}
+
+void Display::resize_scene_bounds()
+{
+  // Point lights come last, a change in their number leaves the other instances in place
+  // but changes the leaves, so the BVH is built again rather than refit
+  scene_bounds.resize(FIRST_CUBE_INSTANCE + CUBE_TRANSFORMS.size() +
+                      lights.get_point_lights().size());
+  update_scene_bounds();
+  scene_bvh.build(scene_bounds);
+}
+
+void Display::init_shadow_casters()
+{
+  cube_caster_mesh = shadow_casters.add_mesh(CUBE_VERTICES, 8,
+                                             sizeof (CUBE_VERTICES) / (8 * sizeof (float)),
+                                             CUBE_INDICES, 36);
+
+  for (const Mesh& mesh : model_nanosuit.meshes) {
+    model_caster_meshes.emplace_back(shadow_casters.add_mesh(
+      mesh.get_positions().data(), static_cast<int>(mesh.get_positions().size()),
+      mesh.get_indices().data(), static_cast<int>(mesh.get_indices().size())));
+  }
+}
+
+void Display::update_scene_bounds()
+{
+  scene_bounds[MODEL_INSTANCE] =
+    model_nanosuit.get_bounds().transform(Object::get_model_matrix(model_transform));
+
+  const auto& point_lights = lights.get_point_lights();
+  const size_t first_light_instance = FIRST_CUBE_INSTANCE + CUBE_TRANSFORMS.size();
+
+  for (size_t i = 0; i < point_lights.size(); i++) {
+    const float radius = Lights::get_radius(point_lights[i]);
+    scene_bounds[first_light_instance + i] = {
+      point_lights[i].position - vec3(radius), point_lights[i].position + vec3(radius)
+    };
+  }
+}
+
+void Display::cull_instances(const mat4& view_projection)
+{
+  PROFILE_SCOPE("SceneCulling")
+
+  PROFILE_SECTION_START("Refit BVH")
+  update_scene_bounds();
+  scene_bvh.refit(scene_bounds);
+  PROFILE_SECTION_END()
+
+  PROFILE_SECTION_START("Frustum Culling")
+  scene_bvh.query_frustum(Frustum(view_projection), visible_instances);
+  PROFILE_SECTION_END()
+
+  PROFILE_SECTION_START("Occlusion Culling")
+  occlusion_culler.begin_frame(view_projection);
+  occlusion_culler.add_occluder(CUBE_VERTICES, 8, CUBE_INDICES, 36,
+                                Object::get_model_matrix(BOX_TRANSFORM));
+  occlusion_culler.rasterize();
+
+  visible_cubes.clear();
+  model_visible = false;
+
+  for (unsigned int instance : visible_instances) {
+    const bool is_cube = instance >= FIRST_CUBE_INSTANCE &&
+                         instance < FIRST_CUBE_INSTANCE + CUBE_TRANSFORMS.size();
+
+    if (instance != MODEL_INSTANCE && !is_cube) {
+      continue;
+    }
+
+    if (!occlusion_culler.is_visible(scene_bounds[instance])) {
+      continue;
+    }
+
+    if (is_cube) {
+      visible_cubes.emplace_back(CUBE_TRANSFORMS[instance - FIRST_CUBE_INSTANCE]);
+    } else {
+      model_visible = true;
+    }
+  }
+  PROFILE_SECTION_END()
+}
+
+void Display::draw_shadow_casters(const Shader& shader, const Frustum& frustum,
+                                  bool draw_room) const
+{
+  std::vector<Object::Transform> cubes;
+
+  for (unsigned int i = 0; i < CUBE_TRANSFORMS.size(); i++) {
+    if (frustum.intersects(scene_bounds[FIRST_CUBE_INSTANCE + i])) {
+      cubes.emplace_back(CUBE_TRANSFORMS[i]);
+    }
+  }
+
+  draw_cubes(shader, cubes);
+
+  if (draw_room && frustum.intersects(scene_bounds[BOX_INSTANCE])) {
+    draw_box(shader);
+  }
+
+  if (frustum.intersects(scene_bounds[MODEL_INSTANCE])) {
+    draw_model(shader);
+  }
+}
+
+void Display::update_shadow_casters()
+{
+  shadow_casters.clear_instances();
+  shadow_casters.add_instance(cube_caster_mesh, Object::get_model_matrix(BOX_TRANSFORM),
+                              scene_bounds[BOX_INSTANCE]);
+
+  for (unsigned int i = 0; i < CUBE_TRANSFORMS.size(); i++) {
+    shadow_casters.add_instance(cube_caster_mesh, Object::get_model_matrix(CUBE_TRANSFORMS[i]),
+                                scene_bounds[FIRST_CUBE_INSTANCE + i]);
+  }
+
+  const mat4 model_matrix = Object::get_model_matrix(model_transform);
+  for (size_t i = 0; i < model_caster_meshes.size(); i++) {
+    shadow_casters.add_instance(model_caster_meshes[i], model_matrix,
+                                model_nanosuit.meshes[i].get_bounds().transform(model_matrix));
+  }
+}
+
+void Display::draw_visibility(const mat4& view_projection)
+{
+  const AABB unit_cube { vec3(-0.5f), vec3(0.5f) };
+  AABB cube_bounds;
+
+  for (const auto& transform : visible_cubes) {
+    cube_bounds.extend(unit_cube.transform(Object::get_model_matrix(transform)));
+  }
+
+  visibility_buffer.begin_frame();
+  visibility_buffer.add_draw(cube, toybox_textures, visible_cubes, cube_bounds, { "parallax" });
+  visibility_buffer.add_draw(cube, cube_textures, { BOX_TRANSFORM }, scene_bounds[BOX_INSTANCE],
+                             { "reverse_normal", "parallax" });
+
+  if (model_visible) {
+    const mat4 model_matrix = Object::get_model_matrix(model_transform);
+
+    for (const Mesh& mesh : model_nanosuit.meshes) {
+      visibility_buffer.add_draw(mesh.get_object(), mesh.get_textures(), { model_transform },
+                                 mesh.get_bounds().transform(model_matrix), { "gamma" });
+    }
+  }
+
+  visibility_buffer.render(*gbuffer, view_projection);
+}
+
+void Display::draw_cubes(const Shader& shader, const std::vector<Object::Transform>& transforms) const
+{
+  if (transforms.empty()) {
+    return;
+  }
 
   Object::set_model_transforms(transforms);
-  cube.draw_instanced(shader, 3, toybox_textures, { "parallax" });
+  cube.draw_instanced(shader, static_cast<int>(transforms.size()), toybox_textures, { "parallax" });
 }
 
 void Display::draw_lights(const Shader& shader) const
@@ -156,23 +1033,36 @@ void Display::draw_lights(const Shader& shader) const
   lights.draw(shader);
 }
 
+void Display::draw_light_volumes(const Shader& shader) const
+{
+  // Back faces that are behind the stored depth bound the pixels a light can reach, which
+  // also keeps working once the camera is inside a volume. Depth clamping stops volumes
+  // crossing the far plane from losing their back faces.
+  glDepthMask(GL_FALSE);
+  glDepthFunc(GL_GEQUAL);
+  glCullFace(GL_FRONT);
+  glEnable(GL_DEPTH_CLAMP);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+
+  lights.draw_volumes(shader, gbuffer->get_textures());
+
+  glDisable(GL_BLEND);
+  glDisable(GL_DEPTH_CLAMP);
+  glCullFace(GL_BACK);
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+}
+
 void Display::draw_box(const Shader& shader) const
 {
-  Object::set_model_transforms({
-   { vec3(15.0f), {}, {} }
-  });
+  Object::set_model_transforms({ BOX_TRANSFORM });
   cube.draw(shader, cube_textures, { "reverse_normal", "parallax" });
 }
 
 void Display::draw_model(const Shader& shader) const
 {
-  Object::set_model_transforms({
-    {
-      vec3(0.2f),
-      std::make_pair(-static_cast<float>(glfwGetTime()), vec3(0.0f, 1.0f, 0.0f)),
-      vec3(0.0f, -0.5f, 0.0f)
-    },
-  });
+  Object::set_model_transforms({ model_transform });
   model_nanosuit.draw(shader, { "gamma" });
 }
 
@@ -6,30 +6,101 @@
 #include <glm/glm.hpp>
 
 #include "display/camera.h"
+#include "display/dynamic_resolution.h"
 #include "shader/shader.h"
 #include "shader/textures.h"
 #include "model/model.h"
 #include "model/object.h"
 #include "model/lights.h"
-#include "shadow/point_shadow.h"
+#include "shadow/point_shadow_cache.h"
+#include "shadow/directional_shadow.h"
 #include "framebuffer/gaussianblur.h"
+#include "framebuffer/bloom.h"
+#include "framebuffer/post_process.h"
+#include "framebuffer/post_composer.h"
+#include "framebuffer/render_graph.h"
+#include "framebuffer/upscaler.h"
+#include "framebuffer/anti_aliasing.h"
+#include "framebuffer/gbuffer.h"
+#include "framebuffer/visibility_buffer.h"
 #include "framebuffer/multisampleframebuffer.h"
+#include "culling/occlusion_culler.h"
+#include "culling/bvh.h"
+#include "culling/light_clusters.h"
 
 typedef glm::vec3 vec3;
 typedef glm::mat3 mat3;
 
 class Display {
 public:
+  enum class LightingMode {
+    FULL_SCREEN,
+    LIGHT_VOLUMES,
+  };
+
+  enum class GeometryMode {
+    G_BUFFER,
+    VISIBILITY_BUFFER,
+  };
+
+  enum class BloomMode {
+    GAUSSIAN,
+    MIP_CHAIN,
+  };
+
+  enum class PostProcessMode {
+    FRAGMENT,
+    COMPUTE,
+  };
+
   Display(std::shared_ptr<Camera> camera);
 
-  void draw() const;
+  void draw();
+  void cycle_lighting_mode();
+  // Moving lights invalidate their shadow faces every frame, so they only bob when toggled on
+  void toggle_light_animation();
+  void cycle_shadow_cascades();
+  void cycle_shadow_resolution();
+  void cycle_point_shadow_mode();
+  void cycle_shadow_filter();
+  void cycle_shadow_filter_taps();
+  void cycle_gbuffer_layout();
+  void cycle_geometry_mode();
+  void cycle_bloom_mode();
+  void cycle_bloom_depth();
+  void cycle_post_process_mode();
+  void toggle_post_effect(int index);
+  void toggle_dynamic_resolution();
+  void cycle_upscale_preset();
+  void toggle_spatial_upscaling();
+  void cycle_anti_aliasing();
+  // Steps through random light counts and radii in both lighting modes at full resolution,
+  // logging the average GPU frame time of each step
+  void start_light_sweep();
+  bool is_light_sweep_done() const;
 
 private:
   void init_buffers();
   void init_textures();
   void init_shaders();
-  void draw_cubes(const Shader& shader) const;
+  void init_gbuffer(GBuffer::Layout layout);
+  void init_scene_bvh();
+  void init_shadow_casters();
+  void add_random_lights(size_t count, const vec3& attenuation);
+  void animate_lights(float time);
+  void set_light_sweep_step();
+  void update_light_sweep();
+  void update_pass_names();
+  void log_bloom_time() const;
+  void resize_scene_bounds();
+  void update_scene_bounds();
+  void cull_instances(const mat4& view_projection);
+  void draw_shadow_casters(const Shader& shader, const Frustum& frustum, bool draw_room) const;
+  void update_shadow_casters();
+  void draw_visibility(const mat4& view_projection);
+  void draw_cubes(const Shader& shader, const std::vector<Object::Transform>& transforms) const;
   void draw_lights(const Shader& shader) const;
+  void draw_light_volumes(const Shader& shader) const;
   void draw_box(const Shader& shader) const;
   void draw_model(const Shader& shader) const;
   void draw_skybox(const Shader& shader) const;
@@ -37,9 +108,9 @@ private:
   std::shared_ptr<Shader> cube_shaders;
   std::shared_ptr<Shader> skybox_shaders;
   std::shared_ptr<Shader> model_shaders;
-  std::shared_ptr<Shader> point_depth_shaders;
   std::shared_ptr<Shader> light_shaders;
   std::shared_ptr<Shader> gbuffer_shaders;
+  std::shared_ptr<Shader> light_volume_shaders;
   std::shared_ptr<Camera> camera;
 
   Textures cube_textures;
@@ -50,11 +121,55 @@ private:
   Object cube;
 
   Model model_nanosuit;
-  PointShadow point_shadow;
   GaussianBlur blur;
-  FrameBuffer gbuffer;
+  Bloom bloom;
+  BloomMode bloom_mode;
+  ComputePostProcess compute_post_process;
+  PostProcessMode post_process_mode;
+  PostComposer post_composer;
+  RenderGraph render_graph;
+  // Names of the passes that depend on the settings, interned again when those change
+  Profiling::ScopeId geometry_pass_name, visibility_geometry_pass_name;
+  Profiling::ScopeId lighting_pass_name, light_volume_pass_name;
+  Profiling::ScopeId bloom_pass_name, compose_pass_name;
+  DynamicResolution dynamic_resolution;
+  Upscaler upscaler;
+  Upscaler::Preset upscale_preset;
+  bool spatial_upscaling;
+  AntiAliasing anti_aliasing;
+  std::unique_ptr<GBuffer> gbuffer;
+  VisibilityBuffer visibility_buffer;
+  GeometryMode geometry_mode;
 
   Lights lights;
+  LightClusters light_clusters;
+  PointShadowCache shadow_cache;
+  ShadowCasters shadow_casters;
+  unsigned int cube_caster_mesh;
+  std::vector<unsigned int> model_caster_meshes;
+  DirectionalShadow dir_shadow;
+  std::vector<AABB> caster_bounds;
+  LightingMode lighting_mode;
+  std::vector<vec3> random_light_positions;
+  std::vector<Lights::PointLight> animated_lights;
+  bool lights_animated;
+  // Negative until a light sweep is started
+  int sweep_step;
+  int sweep_frame;
+  double sweep_gpu_ms;
+
+  BVH scene_bvh;
+  std::vector<AABB> scene_bounds;
+  std::vector<unsigned int> visible_instances;
+  OcclusionCuller occlusion_culler;
+  std::vector<Object::Transform> visible_cubes;
+  Object::Transform model_transform;
+  bool model_visible;
+
+  // Last frame's unjittered view projections and model matrix, for motion vectors
+  mat4 previous_view_projection;
+  mat4 previous_sky_view_projection;
+  mat4 previous_model_matrix;
 };
 
 #endif // DISPLAY_H
@@ -0,0 +1,170 @@
+#include "dynamic_resolution.h"
+#include "util/logging.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+constexpr float MIN_SCALE = 0.5f;
+constexpr float MAX_SCALE = 1.0f;
+// Scales are rounded to steps so small changes in frame time don't resize every frame
+constexpr float SCALE_STEP = 0.05f;
+// Fraction of the budget aimed for, leaving room for spikes
+constexpr float BUDGET_HEADROOM = 0.9f;
+constexpr float GPU_TIME_SMOOTHING = 0.1f;
+constexpr int VIEWPORT_BINDING = 14;
+
+DynamicResolution::DynamicResolution(int max_width, int max_height, float frame_budget_ms)
+  : max_width(max_width),
+    max_height(max_height),
+    frame_budget_ms(frame_budget_ms),
+    enabled(true),
+    scale(MAX_SCALE),
+    smoothed_gpu_ms(0.0f),
+    last_gpu_ms(0.0f),
+    frame(0)
+{
+  glGenQueries(static_cast<int>(queries.size()), queries.data());
+
+  glGenBuffers(1, &UBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof (glm::vec2), nullptr, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, VIEWPORT_BINDING, UBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  update_uniforms();
+}
+
+DynamicResolution::~DynamicResolution()
+{
+  glDeleteQueries(static_cast<int>(queries.size()), queries.data());
+  glDeleteBuffers(1, &UBO);
+}
+
+void DynamicResolution::begin_frame()
+{
+  // The oldest query was issued a full ring of frames ago and is almost always done
+  if (frame >= queries.size()) {
+    const unsigned int query = queries[frame % queries.size()];
+    int available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (available) {
+      GLuint64 elapsed_ns = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_ns);
+      last_gpu_ms = static_cast<float>(elapsed_ns) / 1.0e6f;
+      update_scale(last_gpu_ms);
+    }
+  }
+
+  glBeginQuery(GL_TIME_ELAPSED, queries[frame % queries.size()]);
+}
+
+void DynamicResolution::end_frame()
+{
+  glEndQuery(GL_TIME_ELAPSED);
+  frame++;
+}
+
+void DynamicResolution::set_enabled(bool enabled)
+{
+  this->enabled = enabled;
+
+  if (!enabled) {
+    set_scale(MAX_SCALE);
+  }
+}
+
+void DynamicResolution::set_fixed_scale(float scale)
+{
+  enabled = false;
+  set_scale(std::clamp(scale, MIN_SCALE, MAX_SCALE));
+}
+
+bool DynamicResolution::is_enabled() const
+{
+  return enabled;
+}
+
+float DynamicResolution::get_scale() const
+{
+  return scale;
+}
+
+float DynamicResolution::get_gpu_ms() const
+{
+  return last_gpu_ms;
+}
+
+int DynamicResolution::get_width() const
+{
+  return std::max(static_cast<int>(std::round(static_cast<float>(max_width) * scale)), 1);
+}
+
+int DynamicResolution::get_height() const
+{
+  return std::max(static_cast<int>(std::round(static_cast<float>(max_height) * scale)), 1);
+}
+
+void DynamicResolution::set_viewport() const
+{
+  glViewport(0, 0, get_width(), get_height());
+}
+
+void DynamicResolution::set_full_viewport() const
+{
+  glViewport(0, 0, max_width, max_height);
+}
+
+void DynamicResolution::update_scale(float gpu_ms)
+{
+  smoothed_gpu_ms = smoothed_gpu_ms == 0.0f
+                    ? gpu_ms : glm::mix(smoothed_gpu_ms, gpu_ms, GPU_TIME_SMOOTHING);
+
+  if (!enabled) {
+    return;
+  }
+
+  // Cost goes with the number of pixels, so with the square of the scale
+  const float target_ms = frame_budget_ms * BUDGET_HEADROOM;
+  const float ideal = scale * std::sqrt(target_ms / std::max(smoothed_gpu_ms, 0.01f));
+  const float stepped = std::floor(ideal / SCALE_STEP + 0.5f) * SCALE_STEP;
+  const float new_scale = std::clamp(stepped, MIN_SCALE, MAX_SCALE);
+
+  if (std::abs(new_scale - scale) < SCALE_STEP * 0.5f) {
+    return;
+  }
+
+  // Frames still in flight were timed at the old scale
+  smoothed_gpu_ms *= (new_scale * new_scale) / (scale * scale);
+  set_scale(new_scale);
+}
+
+void DynamicResolution::set_scale(float new_scale)
+{
+  if (new_scale == scale) {
+    return;
+  }
+
+  scale = new_scale;
+  update_uniforms();
+
+  logger_t logger = Logging::get_logger();
+  logger << "Dynamic resolution: rendering at " << get_width() << "x" << get_height() << " ("
+         << std::lround(scale * 100.0f) << "% scale), GPU frame " << smoothed_gpu_ms << " ms"
+         << std::endl;
+}
+
+void DynamicResolution::update_uniforms() const
+{
+  const glm::vec2 viewport[2] = {
+    glm::vec2(get_width(), get_height()) / glm::vec2(max_width, max_height),
+    glm::vec2(get_width(), get_height()),
+  };
+
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof (viewport), viewport);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,55 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <array>
+
+// Picks the fraction of the full size render targets drawn each frame from the GPU time of
+// the frames before, so the frame stays within a time budget. Targets are allocated at the
+// full size, passes render to the top left of them with set_viewport and the final pass
+// upscales to the window. The Viewport uniform block (binding 14) holds the fraction of the
+// targets covered and the size rendered, for full screen passes to sample the right area.
+class DynamicResolution
+{
+public:
+  DynamicResolution(int max_width, int max_height, float frame_budget_ms);
+  ~DynamicResolution();
+
+  // Time the GPU spends between these is what the scale is chosen from
+  void begin_frame();
+  void end_frame();
+
+  void set_enabled(bool enabled);
+  // Turns the controller off and renders at the given scale
+  void set_fixed_scale(float scale);
+  bool is_enabled() const;
+
+  float get_scale() const;
+  // GPU time of the latest frame whose query was read, a few frames behind
+  float get_gpu_ms() const;
+  int get_width() const;
+  int get_height() const;
+
+  // Viewport of the scaled render, or of the whole target for the upscale
+  void set_viewport() const;
+  void set_full_viewport() const;
+
+private:
+  void update_scale(float gpu_ms);
+  // Logs the new size when it changes, profiling sections aren't split by scale
+  void set_scale(float new_scale);
+  void update_uniforms() const;
+
+  int max_width, max_height;
+  float frame_budget_ms;
+  bool enabled;
+  float scale;
+  float smoothed_gpu_ms;
+  float last_gpu_ms;
+
+  unsigned int UBO;
+  // Queries are read a few frames later so the CPU never waits on the GPU
+  std::array<unsigned int, 4> queries;
+  unsigned int frame;
+};
+
+#endif // DYNAMIC_RESOLUTION_H
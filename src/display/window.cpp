@@ -4,14 +4,17 @@
 #include "util/profiling/profiling.h"
 
 constexpr float MOUSE_SENSITIVITY = 0.05f;
+// Frames in a trace captured with the key, about 5 seconds
+constexpr unsigned long long TRACE_FRAMES = 300;
 
-Window::Window()
+Window::Window(bool light_sweep)
 {
   glfwInit();
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-  glfwWindowHint(GLFW_SAMPLES, NUM_AA_SAMPLES);
+  // Only full screen passes reach the default framebuffer, anti-aliasing is done by Display
+  glfwWindowHint(GLFW_SAMPLES, 0);
 
   const int width = Window::width();
   const int height = Window::height();
@@ -41,6 +44,10 @@ Window::Window()
 
   try {
     display = std::make_unique<Display>(camera);
+
+    if (light_sweep) {
+      display->start_light_sweep();
+    }
   } catch (...) {
     glfwDestroyWindow(window);
     std::rethrow_exception(std::current_exception());
@@ -54,16 +61,12 @@ Window::~Window() {
 
 void Window::main_loop() {
   glEnable(GL_DEPTH_TEST);
-  glEnable(GL_MULTISAMPLE);
   glEnable(GL_FRAMEBUFFER_SRGB);
 
   try {
     while (!glfwWindowShouldClose(window)) {
       PROFILE_SCOPE("Main Loop")
 
-      glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
       PROFILE_SECTION_START("Update Camera")
       camera->update_frames();
       PROFILE_SECTION_END()
@@ -72,6 +75,10 @@ void Window::main_loop() {
       display->draw();
       PROFILE_SECTION_END()
 
+      if (display->is_light_sweep_done()) {
+        glfwSetWindowShouldClose(window, true);
+      }
+
       PROFILE_SECTION_START("Swap buffers")
       glfwSwapBuffers(window);
       PROFILE_SECTION_END()
@@ -81,6 +88,8 @@ void Window::main_loop() {
       key_callback();
       mouse_callback();
       PROFILE_SECTION_END()
+
+      PROFILE_FRAME_END()
     }
   } catch (...) {
     glfwDestroyWindow(window);
@@ -110,6 +119,62 @@ void Window::key_callback() {
   if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
     cycle_fill_mode();
   }
+  if (key_pressed(GLFW_KEY_L)) {
+    display->cycle_lighting_mode();
+  }
+  if (key_pressed(GLFW_KEY_Q)) {
+    display->toggle_light_animation();
+  }
+  if (key_pressed(GLFW_KEY_C)) {
+    display->cycle_shadow_cascades();
+  }
+  if (key_pressed(GLFW_KEY_V)) {
+    display->cycle_shadow_resolution();
+  }
+  if (key_pressed(GLFW_KEY_P)) {
+    display->cycle_point_shadow_mode();
+  }
+  if (key_pressed(GLFW_KEY_F)) {
+    display->cycle_shadow_filter();
+  }
+  if (key_pressed(GLFW_KEY_G)) {
+    display->cycle_shadow_filter_taps();
+  }
+  if (key_pressed(GLFW_KEY_B)) {
+    display->cycle_gbuffer_layout();
+  }
+  if (key_pressed(GLFW_KEY_I)) {
+    display->cycle_geometry_mode();
+  }
+  if (key_pressed(GLFW_KEY_M)) {
+    display->cycle_bloom_mode();
+  }
+  if (key_pressed(GLFW_KEY_N)) {
+    display->cycle_bloom_depth();
+  }
+  if (key_pressed(GLFW_KEY_K)) {
+    display->cycle_post_process_mode();
+  }
+  if (key_pressed(GLFW_KEY_R)) {
+    display->toggle_dynamic_resolution();
+  }
+  if (key_pressed(GLFW_KEY_U)) {
+    display->cycle_upscale_preset();
+  }
+  if (key_pressed(GLFW_KEY_J)) {
+    display->toggle_spatial_upscaling();
+  }
+  if (key_pressed(GLFW_KEY_H)) {
+    display->cycle_anti_aliasing();
+  }
+  if (key_pressed(GLFW_KEY_O)) {
+    PROFILE_CAPTURE_TRACE(TRACE_FRAMES)
+  }
+  for (int i = 0; i < PostComposer::NUM_EFFECTS; i++) {
+    if (key_pressed(GLFW_KEY_1 + i)) {
+      display->toggle_post_effect(i);
+    }
+  }
   if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
     camera->move(Camera::Direction::FORWARD);
   }
@@ -130,6 +195,15 @@ void Window::key_callback() {
   }
 }
 
+bool Window::key_pressed(int key) {
+  const bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
+  bool& was_pressed = key_states[key];
+  const bool first_press = pressed && !was_pressed;
+  was_pressed = pressed;
+
+  return first_press;
+}
+
 void Window::mouse_callback() {
   static double prev_x, prev_y;
   double x, y;
@@ -5,6 +5,7 @@
 #include "display/camera.h"
 
 #include <memory>
+#include <unordered_map>
 
 #include <GLFW/glfw3.h>
 
@@ -13,7 +14,8 @@ typedef glm::mat4 mat4;
 
 class Window {
 public:
-  Window();
+  // The light sweep closes the window once it is done, see Display::start_light_sweep
+  Window(bool light_sweep = false);
   ~Window();
 
   void main_loop();
@@ -24,10 +26,12 @@ public:
 private:
   static void framebuffer_size_callback(GLFWwindow* window, int width, int height);
   void key_callback();
+  bool key_pressed(int key);
   void mouse_callback();
   static void cycle_fill_mode();
 
   GLFWwindow* window;
+  std::unordered_map<int, bool> key_states;
   std::unique_ptr<Display> display;
   std::shared_ptr<Camera> camera;
 };
@@ -0,0 +1,187 @@
+#include "anti_aliasing.h"
+#include "util/data.h"
+
+#include <glad/glad.h>
+
+// Jitters cycle through the first points of the Halton (2, 3) sequence
+constexpr unsigned int NUM_JITTERS = 8;
+// Weight of the current frame in the history
+constexpr float TAA_BLEND = 0.1f;
+constexpr int CURRENT_UNIT = 0;
+constexpr int HISTORY_UNIT = 1;
+constexpr int VELOCITY_UNIT = 2;
+
+static float halton(unsigned int index, unsigned int base)
+{
+  float result = 0.0f;
+  float fraction = 1.0f;
+
+  while (index > 0) {
+    fraction /= static_cast<float>(base);
+    result += fraction * static_cast<float>(index % base);
+    index /= base;
+  }
+
+  return result;
+}
+
+AntiAliasing::AntiAliasing(int width, int height, Mode mode)
+  : width(width),
+    height(height),
+    render_width(width),
+    render_height(height),
+    mode(mode),
+    frame(0),
+    history_valid(false),
+    history_textures { 0, 0 },
+    taa_shader(std::make_unique<Shader>("../../shaders/processing/fb.vert",
+                                        "../../shaders/processing/taa.frag")),
+    fxaa_shader(std::make_unique<Shader>("../../shaders/processing/fb.vert",
+                                         "../../shaders/processing/fxaa.frag"))
+{
+  glGenFramebuffers(1, &FBO);
+
+  rect.start_setup();
+  rect.add_vertices(QUAD_VERTICES, 6, sizeof (QUAD_VERTICES));
+  rect.add_vertex_attribs({ 2, 2 });
+  rect.finalize_setup();
+}
+
+AntiAliasing::~AntiAliasing()
+{
+  glDeleteFramebuffers(1, &FBO);
+  glDeleteTextures(2, history_textures.data());
+}
+
+void AntiAliasing::set_mode(Mode mode)
+{
+  this->mode = mode;
+  history_valid = false;
+}
+
+AntiAliasing::Mode AntiAliasing::get_mode() const
+{
+  return mode;
+}
+
+const char* AntiAliasing::get_mode_name() const
+{
+  switch (mode) {
+    case Mode::NONE:
+      return "None";
+    case Mode::FXAA:
+      return "FXAA";
+    case Mode::TAA:
+      return "TAA";
+  }
+
+  return "";
+}
+
+void AntiAliasing::set_render_size(int width, int height)
+{
+  if (width != render_width || height != render_height) {
+    history_valid = false;
+  }
+
+  render_width = width;
+  render_height = height;
+}
+
+vec2 AntiAliasing::begin_frame()
+{
+  if (mode != Mode::TAA) {
+    history_valid = false;
+    return vec2(0.0f);
+  }
+
+  frame++;
+
+  // Within half a pixel of the center
+  const unsigned int index = frame % NUM_JITTERS + 1;
+  const vec2 jitter(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+
+  return 2.0f * jitter / vec2(render_width, render_height);
+}
+
+unsigned int AntiAliasing::get_history_target()
+{
+  init_history();
+
+  return history_textures[frame % 2];
+}
+
+void AntiAliasing::resolve(unsigned int current, unsigned int velocity,
+                           const mat4& sky_reprojection)
+{
+  init_history();
+
+  bind_target(history_textures[frame % 2]);
+  glDisable(GL_DEPTH_TEST);
+
+  taa_shader->use_shader_program();
+  glUniform1i(taa_shader->get_uniform_location("current"), CURRENT_UNIT);
+  glUniform1i(taa_shader->get_uniform_location("history"), HISTORY_UNIT);
+  glUniform1i(taa_shader->get_uniform_location("velocity"), VELOCITY_UNIT);
+  glUniform1i(taa_shader->get_uniform_location("history_valid"), history_valid);
+  glUniform1f(taa_shader->get_uniform_location("blend"), TAA_BLEND);
+  glUniformMatrix4fv(taa_shader->get_uniform_location("sky_reprojection"), 1, GL_FALSE,
+                     &sky_reprojection[0][0]);
+
+  glActiveTexture(GL_TEXTURE0 + CURRENT_UNIT);
+  glBindTexture(GL_TEXTURE_2D, current);
+  glActiveTexture(GL_TEXTURE0 + HISTORY_UNIT);
+  glBindTexture(GL_TEXTURE_2D, history_textures[(frame + 1) % 2]);
+  glActiveTexture(GL_TEXTURE0 + VELOCITY_UNIT);
+  glBindTexture(GL_TEXTURE_2D, velocity);
+  rect.draw(*taa_shader);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  history_valid = true;
+}
+
+void AntiAliasing::bind_target(unsigned int texture) const
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+}
+
+void AntiAliasing::fxaa(unsigned int source, bool encoded) const
+{
+  glDisable(GL_DEPTH_TEST);
+
+  // Encoded values go to the framebuffer as they are
+  if (encoded) {
+    glDisable(GL_FRAMEBUFFER_SRGB);
+  }
+
+  fxaa_shader->use_shader_program();
+  glUniform1i(fxaa_shader->get_uniform_location("source"), CURRENT_UNIT);
+  glUniform1i(fxaa_shader->get_uniform_location("encoded"), encoded);
+
+  glActiveTexture(GL_TEXTURE0 + CURRENT_UNIT);
+  glBindTexture(GL_TEXTURE_2D, source);
+  rect.draw(*fxaa_shader);
+
+  glEnable(GL_FRAMEBUFFER_SRGB);
+}
+
+void AntiAliasing::init_history()
+{
+  if (history_textures[0] != 0) {
+    return;
+  }
+
+  glGenTextures(2, history_textures.data());
+
+  for (const unsigned int texture : history_textures) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,68 @@
+#ifndef ANTI_ALIASING_H
+#define ANTI_ALIASING_H
+
+#include "shader/shader.h"
+#include "model/object.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+
+typedef glm::vec2 vec2;
+typedef glm::mat4 mat4;
+
+// Anti-aliasing as a stage of the post-processing instead of multisampled targets. FXAA
+// (fxaa.frag) smooths the edges it finds in the finished frame. TAA (taa.frag) renders every
+// frame with a different sub-pixel jitter of the projection and blends it into a history
+// reprojected with the G-buffer's motion vectors, which also resolves detail within pixels.
+class AntiAliasing
+{
+public:
+  enum class Mode {
+    NONE,
+    FXAA,
+    TAA,
+  };
+
+  AntiAliasing(int width, int height, Mode mode);
+  ~AntiAliasing();
+
+  void set_mode(Mode mode);
+  Mode get_mode() const;
+  const char* get_mode_name() const;
+  // Part of the targets rendered to, the history is dropped when it changes
+  void set_render_size(int width, int height);
+
+  // Moves on to the next jitter and returns it as an offset of the projection in normalized
+  // device coordinates, zero unless TAA is on
+  vec2 begin_frame();
+  // Texture this frame's resolve writes to, the next frame reprojects it
+  unsigned int get_history_target();
+  // Blends the HDR frame into the history at the render size. Pixels without motion vectors
+  // are taken to be at the far plane, sky_reprojection maps their normalized device
+  // coordinates to the last frame's.
+  void resolve(unsigned int current, unsigned int velocity, const mat4& sky_reprojection);
+
+  // Binds a target of the output size for FXAA to draw into at the render size
+  void bind_target(unsigned int texture) const;
+  // Draws into the bound framebuffer, encoded sources are handled as in Upscaler
+  void fxaa(unsigned int source, bool encoded) const;
+
+private:
+  void init_history();
+
+  int width, height;
+  int render_width, render_height;
+  Mode mode;
+  unsigned int frame;
+  bool history_valid;
+  unsigned int FBO;
+  // Allocated the first time TAA runs, the resolve alternates between them
+  std::array<unsigned int, 2> history_textures;
+  std::unique_ptr<Shader> taa_shader;
+  std::unique_ptr<Shader> fxaa_shader;
+  Object rect;
+};
+
+#endif // ANTI_ALIASING_H
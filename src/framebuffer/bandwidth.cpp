@@ -0,0 +1,44 @@
+#include "bandwidth.h"
+#include "util/logging.h"
+
+#include <cstdlib>
+
+constexpr double BYTES_PER_MB = 1024.0 * 1024.0;
+
+std::map<std::string, BandwidthStats::Traffic> BandwidthStats::frame_traffic;
+long long BandwidthStats::logged_total = 0;
+
+void BandwidthStats::add_read(const std::string& target, long long bytes)
+{
+  frame_traffic[target].read += bytes;
+}
+
+void BandwidthStats::add_written(const std::string& target, long long bytes)
+{
+  frame_traffic[target].written += bytes;
+}
+
+void BandwidthStats::end_frame()
+{
+  long long total = 0;
+
+  for (const auto& [target, traffic] : frame_traffic) {
+    total += traffic.read + traffic.written;
+  }
+
+  if (std::llabs(total - logged_total) * 10 > logged_total) {
+    logged_total = total;
+
+    logger_t logger = Logging::get_logger();
+    logger << "Render target traffic: " << static_cast<double>(total) / BYTES_PER_MB
+           << " MB per frame" << std::endl;
+
+    for (const auto& [target, traffic] : frame_traffic) {
+      logger << "  " << target << ": " << static_cast<double>(traffic.read) / BYTES_PER_MB
+             << " MB read, " << static_cast<double>(traffic.written) / BYTES_PER_MB
+             << " MB written" << std::endl;
+    }
+  }
+
+  frame_traffic.clear();
+}
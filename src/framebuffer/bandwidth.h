@@ -0,0 +1,31 @@
+#ifndef BANDWIDTH_H
+#define BANDWIDTH_H
+
+#include <map>
+#include <string>
+
+// Estimate of the bytes moved between memory and the render targets in a frame by the load
+// and store actions of framebuffers, which is the traffic a tile-based GPU pays for. Loads
+// read the attachment back in and stores write it out, while clears, don't-cares and
+// discards stay in tile memory. Counted per target over the viewport's pixels.
+class BandwidthStats
+{
+public:
+  BandwidthStats() = delete;
+
+  static void add_read(const std::string& target, long long bytes);
+  static void add_written(const std::string& target, long long bytes);
+  // Logs the frame's traffic when it moved by more than a tenth since it was last logged
+  static void end_frame();
+
+private:
+  struct Traffic {
+    long long read;
+    long long written;
+  };
+
+  static std::map<std::string, Traffic> frame_traffic;
+  static long long logged_total;
+};
+
+#endif // BANDWIDTH_H
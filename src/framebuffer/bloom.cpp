@@ -0,0 +1,134 @@
+#include "bloom.h"
+#include "util/data.h"
+#include "util/logging.h"
+#include "util/profiling/profiling.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <string>
+
+// Luminance above which pixels bloom, as in filter_bright_colors, softened over the knee
+constexpr float BLOOM_THRESHOLD = 1.0f;
+constexpr float BLOOM_KNEE = 0.5f;
+constexpr int DOWNSAMPLE_TAPS = 5;
+constexpr int UPSAMPLE_TAPS = 9;
+
+Bloom::Bloom(int width, int height, int depth)
+  : width(width),
+    height(height),
+    render_width(width),
+    render_height(height),
+    depth(1),
+    downsample_shader(std::make_unique<Shader>("../../shaders/processing/fb.vert",
+                                               "../../shaders/processing/bloom_downsample.frag")),
+    upsample_shader(std::make_unique<Shader>("../../shaders/processing/fb.vert",
+                                             "../../shaders/processing/bloom_upsample.frag"))
+{
+  glGenFramebuffers(1, &FBO);
+
+  rect.start_setup();
+  rect.add_vertices(QUAD_VERTICES, 6, sizeof (QUAD_VERTICES));
+  rect.add_vertex_attribs({ 2, 2 });
+  rect.finalize_setup();
+
+  set_depth(depth);
+}
+
+Bloom::~Bloom()
+{
+  glDeleteFramebuffers(1, &FBO);
+}
+
+void Bloom::set_render_size(int width, int height)
+{
+  render_width = width;
+  render_height = height;
+}
+
+void Bloom::set_depth(int depth)
+{
+  this->depth = std::clamp(depth, 1, MAX_BLOOM_DEPTH);
+
+  // Bilinear taps per screen pixel, against 45 for five 9-tap passes at full resolution
+  double taps = 0.0;
+  for (int i = 0; i < this->depth; i++) {
+    const auto [level_width, level_height] = get_level_size(i);
+    const double pixels = static_cast<double>(level_width) * level_height;
+
+    taps += DOWNSAMPLE_TAPS * pixels;
+    if (i + 1 < this->depth) {
+      taps += UPSAMPLE_TAPS * pixels;
+    }
+  }
+
+  logger_t logger = Logging::get_logger();
+  logger << "Bloom chain depth " << this->depth << ": "
+         << taps / (static_cast<double>(width) * height) << " taps per pixel" << std::endl;
+}
+
+int Bloom::get_depth() const
+{
+  return depth;
+}
+
+float Bloom::get_strength() const
+{
+  return 1.0f / static_cast<float>(depth);
+}
+
+std::pair<int, int> Bloom::get_level_size(int level) const
+{
+  return { std::max(width >> (level + 1), 1), std::max(height >> (level + 1), 1) };
+}
+
+void Bloom::render(unsigned int source_texture, const std::vector<unsigned int>& targets) const
+{
+  PROFILE_GPU_SCOPE("Bloom")
+
+  glDisable(GL_DEPTH_TEST);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+  PROFILE_SECTION_START("Downsample")
+  downsample_shader->use_shader_program();
+  glUniform1i(downsample_shader->get_uniform_location("prefilter"), 1);
+  glUniform1f(downsample_shader->get_uniform_location("threshold"), BLOOM_THRESHOLD);
+  glUniform1f(downsample_shader->get_uniform_location("knee"), BLOOM_KNEE);
+  draw_level(0, targets[0], source_texture, *downsample_shader);
+  glUniform1i(downsample_shader->get_uniform_location("prefilter"), 0);
+
+  for (int i = 1; i < depth; i++) {
+    draw_level(i, targets[static_cast<size_t>(i)], targets[static_cast<size_t>(i - 1)],
+               *downsample_shader);
+  }
+  PROFILE_SECTION_END()
+
+  PROFILE_SECTION_START("Upsample")
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+
+  for (int i = depth - 1; i > 0; i--) {
+    draw_level(i - 1, targets[static_cast<size_t>(i - 1)], targets[static_cast<size_t>(i)],
+               *upsample_shader);
+  }
+
+  glDisable(GL_BLEND);
+  PROFILE_SECTION_END()
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, width, height);
+}
+
+void Bloom::draw_level(int level, unsigned int target, unsigned int source,
+                       const Shader& shader) const
+{
+  const int level_width = std::max(render_width >> (level + 1), 1);
+  const int level_height = std::max(render_height >> (level + 1), 1);
+
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+  glViewport(0, 0, level_width, level_height);
+
+  Textures textures;
+  textures.add_texture("source", source);
+  rect.draw(shader, textures);
+}
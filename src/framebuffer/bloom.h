@@ -0,0 +1,48 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include "shader/shader.h"
+#include "model/object.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Most levels of the bloom chain, the first one has half the screen resolution
+constexpr int MAX_BLOOM_DEPTH = 8;
+
+// Bloom from a chain of progressively halved R11F_G11F_B10F targets. The first downsample also
+// thresholds the HDR scene, the rest of the chain is built with 5 bilinear taps per texel, then
+// every level is tent filtered and added into the next larger one. The blur radius grows with the
+// depth of the chain while each pass only touches a fraction of the screen's pixels.
+class Bloom
+{
+public:
+  Bloom(int width, int height, int depth);
+  ~Bloom();
+
+  // Part of the source rendered to, every level covers the same part of its target
+  void set_render_size(int width, int height);
+  void set_depth(int depth);
+  int get_depth() const;
+  // Each upsample adds a level, the result is scaled back by this in the composite
+  float get_strength() const;
+
+  // Size of a level of the chain, the first one is half the screen
+  std::pair<int, int> get_level_size(int level) const;
+  // Targets has a texture for each level of the current depth, the first ends up with the bloom
+  void render(unsigned int source_texture, const std::vector<unsigned int>& targets) const;
+
+private:
+  void draw_level(int level, unsigned int target, unsigned int source, const Shader& shader) const;
+
+  int width, height;
+  int render_width, render_height;
+  int depth;
+  unsigned int FBO;
+  std::unique_ptr<Shader> downsample_shader;
+  std::unique_ptr<Shader> upsample_shader;
+  Object rect;
+};
+
+#endif // BLOOM_H
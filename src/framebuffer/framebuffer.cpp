@@ -1,51 +1,92 @@
 #include "framebuffer.h"
+#include "framebuffer/bandwidth.h"
 #include "util/exception.h"
 #include "util/data.h"
+#include "util/logging.h"
+
+#include <unordered_map>
+
+// Black, like the main loop's clear color
+constexpr float CLEAR_COLOR[4] { 0.0f, 0.0f, 0.0f, 1.0f };
+// Depth attachments are counted as 4 bytes whatever the driver picks
+constexpr int DEPTH_BYTES = 4;
+
+static long long get_viewport_pixels()
+{
+  int viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  return static_cast<long long>(viewport[2]) * viewport[3];
+}
 
 FrameBuffer::FrameBuffer(int width, int height,
                          const char* vertex_path,
                          const char* frag_path,
                          const std::vector<GLenum>& buffer_formats,
                          bool renderbuffer,
-                         bool stencil)
-  : width(width),
+                         bool stencil,
+                         const std::string& shader_defines)
+  : RBO(0),
+    depth_texture(0),
+    depth_attachment(0),
+    name("Framebuffer"),
+    width(width),
     height(height),
-    shader(std::make_shared<Shader>(vertex_path, frag_path))
+    shader(std::make_shared<Shader>(vertex_path, frag_path, std::nullopt, shader_defines))
 {
   unsigned int rb_storage_type = stencil ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT;
   unsigned int rb_attachment_type = stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
 
   glGenFramebuffers(1, &FBO);
-
-  color_textures.resize(buffer_formats.size());
-  glGenTextures(static_cast<int>(buffer_formats.size()), color_textures.data());
-
   glBindFramebuffer(GL_FRAMEBUFFER, FBO);
 
-  for (unsigned int i = 0; i < buffer_formats.size(); i++) {
-    const auto [pixel_format, pixel_type] = get_pixel_format_type(buffer_formats[i]);
+  for (const GLenum buffer_format : buffer_formats) {
+    const GLenum format = get_supported_format(buffer_format);
+    const auto [pixel_format, pixel_type] = get_pixel_format_type(format);
+    const bool depth = pixel_format == GL_DEPTH_COMPONENT || pixel_format == GL_DEPTH_STENCIL;
+    unsigned int texture;
 
-    glBindTexture(GL_TEXTURE_2D, color_textures[i]);
-    glTexImage2D(GL_TEXTURE_2D, 0, static_cast<int>(buffer_formats[i]),
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, static_cast<int>(format),
                  width, height, 0, pixel_format, pixel_type, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, depth ? GL_NEAREST : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, depth ? GL_NEAREST : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
-                           GL_TEXTURE_2D, color_textures[i], 0);
-    textures.add_texture("texture_screen", color_textures[i]);
-  }
 
-  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-    throw FrameBufferException("Framebuffer not complete");
+    // A depth format takes the place of the renderbuffer as a texture shaders can sample
+    if (depth) {
+      if (depth_texture != 0) {
+        throw FrameBufferException("Framebuffer can only have one depth format");
+      }
+
+      depth_texture = texture;
+      depth_attachment = pixel_format == GL_DEPTH_STENCIL ? GL_DEPTH_STENCIL_ATTACHMENT
+                                                          : GL_DEPTH_ATTACHMENT;
+      glFramebufferTexture2D(GL_FRAMEBUFFER, depth_attachment, GL_TEXTURE_2D, texture, 0);
+      textures.add_texture("texture_depth", texture);
+      continue;
+    }
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER,
+                           GL_COLOR_ATTACHMENT0 + static_cast<unsigned int>(color_textures.size()),
+                           GL_TEXTURE_2D, texture, 0);
+    color_textures.emplace_back(texture);
+    formats.emplace_back(format);
+    textures.add_texture("texture_screen", texture);
   }
 
-  if (renderbuffer) {
+  if (renderbuffer && depth_texture == 0) {
     glGenRenderbuffers(1, &RBO);
     glBindRenderbuffer(GL_RENDERBUFFER, RBO);
     glRenderbufferStorage(GL_RENDERBUFFER, rb_storage_type, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, rb_attachment_type, GL_RENDERBUFFER, RBO);
+    depth_attachment = rb_attachment_type;
+  }
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    throw FrameBufferException("Framebuffer not complete");
   }
 
   rect.start_setup();
@@ -63,12 +104,14 @@ FrameBuffer::~FrameBuffer()
   glDeleteFramebuffers(1, &FBO);
   glDeleteRenderbuffers(1, &RBO);
   glDeleteTextures(static_cast<int>(color_textures.size()), color_textures.data());
+  glDeleteTextures(1, &depth_texture);
 }
 
 std::tuple<GLenum, GLenum> FrameBuffer::get_pixel_format_type(GLenum buffer_format)
 {
   switch (buffer_format) {
     case GL_RGBA:
+    case GL_RGBA8:
     case GL_RGBA16:
       return std::make_tuple(GL_RGBA, GL_UNSIGNED_BYTE);
     case GL_RGBA16F:
@@ -80,40 +123,234 @@ std::tuple<GLenum, GLenum> FrameBuffer::get_pixel_format_type(GLenum buffer_form
     case GL_RGB16F:
     case GL_RGB32F:
       return std::make_tuple(GL_RGB, GL_FLOAT);
+    case GL_R11F_G11F_B10F:
+      return std::make_tuple(GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV);
     case GL_RG:
+    case GL_RG8:
     case GL_RG16:
       return std::make_tuple(GL_RG, GL_UNSIGNED_BYTE);
     case GL_RG16F:
     case GL_RG32F:
       return std::make_tuple(GL_RG, GL_FLOAT);
+    case GL_RG16_SNORM:
+      return std::make_tuple(GL_RG, GL_SHORT);
+    case GL_R8:
+      return std::make_tuple(GL_RED, GL_UNSIGNED_BYTE);
+    case GL_R16F:
+    case GL_R32F:
+      return std::make_tuple(GL_RED, GL_FLOAT);
+    case GL_RGB10_A2:
+      return std::make_tuple(GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV);
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+      return std::make_tuple(GL_DEPTH_COMPONENT, GL_FLOAT);
+    case GL_DEPTH24_STENCIL8:
+      return std::make_tuple(GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+    case GL_DEPTH32F_STENCIL8:
+      return std::make_tuple(GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV);
     default:
       throw FrameBufferException("Unknown framebuffer type: " + std::to_string(buffer_format));
   }
 }
 
+GLenum FrameBuffer::get_supported_format(GLenum buffer_format)
+{
+  static std::unordered_map<GLenum, GLenum> supported_formats;
+
+  const auto cached = supported_formats.find(buffer_format);
+  if (cached != supported_formats.end()) {
+    return cached->second;
+  }
+
+  // Only formats with a fallback are queried, the rest are used as they are
+  GLenum format = buffer_format;
+  GLenum fallback = get_fallback_format(format);
+
+  while (fallback != GL_NONE) {
+    int support = GL_NONE;
+    glGetInternalformativ(GL_TEXTURE_2D, format, GL_FRAMEBUFFER_RENDERABLE, 1, &support);
+
+    if (support == GL_FULL_SUPPORT) {
+      break;
+    }
+
+    logger_t logger = Logging::get_logger();
+    logger << "Render target format 0x" << std::hex << format << " isn't fully supported, "
+           << "falling back to 0x" << fallback << std::dec << std::endl;
+
+    format = fallback;
+    fallback = get_fallback_format(format);
+  }
+
+  supported_formats.emplace(buffer_format, format);
+
+  return format;
+}
+
+GLenum FrameBuffer::get_fallback_format(GLenum buffer_format)
+{
+  switch (buffer_format) {
+    case GL_R11F_G11F_B10F:
+    case GL_R16F:
+      return GL_RGBA16F;
+    case GL_RGB10_A2:
+    case GL_R8:
+      return GL_RGBA8;
+    // Signed normalized formats aren't required to be renderable
+    case GL_RG16_SNORM:
+      return GL_RG16F;
+    case GL_DEPTH_COMPONENT32F:
+      return GL_DEPTH_COMPONENT24;
+    case GL_DEPTH24_STENCIL8:
+      return GL_DEPTH32F_STENCIL8;
+    default:
+      return GL_NONE;
+  }
+}
+
+int FrameBuffer::get_bytes_per_pixel(GLenum buffer_format)
+{
+  switch (buffer_format) {
+    case GL_R8:
+      return 1;
+    case GL_RG:
+    case GL_RG8:
+    case GL_R16F:
+      return 2;
+    case GL_RGB:
+      return 3;
+    case GL_RGB16F:
+    case GL_RGB16:
+      return 6;
+    case GL_RGBA16F:
+    case GL_RGBA16:
+    case GL_RG32F:
+    case GL_DEPTH32F_STENCIL8:
+      return 8;
+    case GL_RGB32F:
+      return 12;
+    case GL_RGBA32F:
+      return 16;
+    default:
+      return 4;
+  }
+}
+
 void FrameBuffer::bind_framebuffer() const
+{
+  bind_framebuffer({ LoadAction::CLEAR }, LoadAction::CLEAR);
+}
+
+void FrameBuffer::bind_framebuffer(const std::vector<LoadAction>& color_loads,
+                                   LoadAction depth_load) const
 {
   glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glEnable(GL_DEPTH_TEST);
+  set_draw_buffers(color_textures.size());
+  load_attachments(color_loads, depth_load, depth_attachment, 1);
+}
 
-  if (color_textures.size() == 1) {
+void FrameBuffer::store_framebuffer(const std::vector<StoreAction>& color_stores,
+                                    StoreAction depth_store) const
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  store_attachments(color_stores, depth_store, depth_attachment, 1);
+}
+
+void FrameBuffer::unbind_framebuffer() const
+{
+  // Every pass reaching the default framebuffer covers it, so it isn't cleared here
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FrameBuffer::set_draw_buffers(size_t num_color_targets) const
+{
+  if (num_color_targets == 1) {
     return;
   }
 
   std::vector<unsigned int> attachments;
 
-  for (unsigned int i = 0; i < color_textures.size(); i++) {
+  for (unsigned int i = 0; i < num_color_targets; i++) {
     attachments.emplace_back(GL_COLOR_ATTACHMENT0 + i);
   }
 
-  glDrawBuffers(static_cast<int>(color_textures.size()), attachments.data());
+  glDrawBuffers(static_cast<int>(num_color_targets), attachments.data());
 }
 
-void FrameBuffer::unbind_framebuffer() const
+void FrameBuffer::load_attachments(const std::vector<LoadAction>& color_loads,
+                                   LoadAction depth_load, GLenum depth, int samples) const
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glClear(GL_COLOR_BUFFER_BIT);
+  const long long pixels = get_viewport_pixels() * samples;
+  std::vector<GLenum> invalidated;
+
+  for (size_t i = 0; i < formats.size(); i++) {
+    switch (color_loads.size() == 1 ? color_loads.front() : color_loads[i]) {
+      case LoadAction::CLEAR:
+        glClearBufferfv(GL_COLOR, static_cast<int>(i), CLEAR_COLOR);
+        break;
+      case LoadAction::LOAD:
+        BandwidthStats::add_read(name, pixels * get_bytes_per_pixel(formats[i]));
+        break;
+      case LoadAction::DONT_CARE:
+        invalidated.emplace_back(GL_COLOR_ATTACHMENT0 + i);
+        break;
+    }
+  }
+
+  if (depth != 0) {
+    switch (depth_load) {
+      case LoadAction::CLEAR:
+        glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+        break;
+      case LoadAction::LOAD:
+        BandwidthStats::add_read(name, pixels * DEPTH_BYTES);
+        break;
+      case LoadAction::DONT_CARE:
+        invalidated.emplace_back(depth);
+        break;
+    }
+  }
+
+  if (!invalidated.empty()) {
+    glInvalidateFramebuffer(GL_FRAMEBUFFER, static_cast<int>(invalidated.size()),
+                            invalidated.data());
+  }
+}
+
+void FrameBuffer::store_attachments(const std::vector<StoreAction>& color_stores,
+                                    StoreAction depth_store, GLenum depth, int samples) const
+{
+  const long long pixels = get_viewport_pixels() * samples;
+  std::vector<GLenum> invalidated;
+
+  for (size_t i = 0; i < formats.size(); i++) {
+    switch (color_stores.size() == 1 ? color_stores.front() : color_stores[i]) {
+      case StoreAction::STORE:
+        BandwidthStats::add_written(name, pixels * get_bytes_per_pixel(formats[i]));
+        break;
+      case StoreAction::DISCARD:
+        invalidated.emplace_back(GL_COLOR_ATTACHMENT0 + i);
+        break;
+    }
+  }
+
+  if (depth != 0) {
+    switch (depth_store) {
+      case StoreAction::STORE:
+        BandwidthStats::add_written(name, pixels * DEPTH_BYTES);
+        break;
+      case StoreAction::DISCARD:
+        invalidated.emplace_back(depth);
+        break;
+    }
+  }
+
+  if (!invalidated.empty()) {
+    glInvalidateFramebuffer(GL_FRAMEBUFFER, static_cast<int>(invalidated.size()),
+                            invalidated.data());
+  }
 }
 
 void FrameBuffer::draw_scene() const
@@ -128,9 +365,17 @@ void FrameBuffer::blit_depth() const
   int current_FBO;
   glGetIntegerv(GL_FRAMEBUFFER_BINDING, &current_FBO);
 
+  // Only the part rendered to is copied, the destination's write is counted by its store
+  int viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  const int x1 = viewport[0] + viewport[2];
+  const int y1 = viewport[1] + viewport[3];
+  BandwidthStats::add_read(name, get_viewport_pixels() * DEPTH_BYTES);
+
   glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<unsigned int>(current_FBO));
-  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+  glBlitFramebuffer(viewport[0], viewport[1], x1, y1, viewport[0], viewport[1], x1, y1,
+                    GL_DEPTH_BUFFER_BIT, GL_NEAREST);
   glBindFramebuffer(GL_FRAMEBUFFER, static_cast<unsigned int>(current_FBO));
 }
 
@@ -138,3 +383,18 @@ std::shared_ptr<Shader> FrameBuffer::get_shader() const
 {
   return shader;
 }
+
+const Textures& FrameBuffer::get_textures() const
+{
+  return textures;
+}
+
+int FrameBuffer::get_num_color_targets() const
+{
+  return static_cast<int>(color_textures.size());
+}
+
+void FrameBuffer::set_name(const std::string& name)
+{
+  this->name = name;
+}
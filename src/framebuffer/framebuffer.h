@@ -6,6 +6,7 @@
 #include "shader/textures.h"
 
 #include <glad/glad.h>
+#include <string>
 #include <tuple>
 #include <vector>
 #include <memory>
@@ -15,24 +16,72 @@ class FrameBuffer
   friend class GaussianBlur;
 
 public:
+  // What a pass starts from in each attachment. Don't-care attachments are invalidated, the
+  // pass must write every pixel it uses.
+  enum class LoadAction {
+    CLEAR,
+    LOAD,
+    DONT_CARE,
+  };
+
+  // What is kept of each attachment after a pass, discarded ones are invalidated
+  enum class StoreAction {
+    STORE,
+    DISCARD,
+  };
+
+  // Depth formats among the buffer formats are attached as a depth texture
   FrameBuffer(int width, int height,
               const char* vertex_path, const char* frag_path,
               const std::vector<GLenum>& buffer_formats = { GL_RGBA },
               bool renderbuffer = true,
-              bool stencil = false);
+              bool stencil = false,
+              const std::string& shader_defines = "");
   virtual ~FrameBuffer();
 
-  virtual void bind_framebuffer() const;
+  // Clears every attachment
+  void bind_framebuffer() const;
+  // One action per color attachment in order, or a single one for all of them, and one for
+  // depth. Traffic is counted over the current viewport, so set it first.
+  virtual void bind_framebuffer(const std::vector<LoadAction>& color_loads,
+                                LoadAction depth_load) const;
+  // Ends a pass, or releases attachments later passes no longer read
+  virtual void store_framebuffer(const std::vector<StoreAction>& color_stores,
+                                 StoreAction depth_store) const;
   virtual void unbind_framebuffer() const;
   virtual void draw_scene() const;
   virtual void blit_depth() const;
   virtual std::shared_ptr<Shader> get_shader() const;
+  const Textures& get_textures() const;
+  int get_num_color_targets() const;
+  // Name the target's traffic is counted under, see BandwidthStats
+  void set_name(const std::string& name);
+
+  // The format itself when the driver fully supports rendering to it, otherwise the first
+  // of its fallbacks that it does. Results are cached.
+  static GLenum get_supported_format(GLenum buffer_format);
+  static int get_bytes_per_pixel(GLenum buffer_format);
 
 protected:
   static std::tuple<GLenum, GLenum> get_pixel_format_type(GLenum buffer_format);
+  static GLenum get_fallback_format(GLenum buffer_format);
+
+  // Apply to the bound framebuffer, with every sample of an attachment counted
+  void set_draw_buffers(size_t num_color_targets) const;
+  void load_attachments(const std::vector<LoadAction>& color_loads, LoadAction depth_load,
+                        GLenum depth, int samples) const;
+  void store_attachments(const std::vector<StoreAction>& color_stores, StoreAction depth_store,
+                         GLenum depth, int samples) const;
 
   unsigned int RBO, FBO;
+  // Created instead of the renderbuffer when the formats include a depth format
+  unsigned int depth_texture;
   std::vector<unsigned int> color_textures;
+  // Of the color targets, after falling back to supported formats
+  std::vector<GLenum> formats;
+  // Depth or depth stencil attachment point, 0 without one
+  GLenum depth_attachment;
+  std::string name;
   int width, height;
   std::shared_ptr<Shader> shader;
   Object rect;
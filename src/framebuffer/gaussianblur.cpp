@@ -4,14 +4,30 @@
 GaussianBlur::GaussianBlur(int width, int height,
                            const char* blur_vertex_path, const char* blur_frag_path,
                            const char* fb_vertex_path, const char* fb_frag_path)
-  : hdr_buffer(width, height, fb_vertex_path, fb_frag_path, { GL_RGBA16F, GL_RGBA16F }, true, false),
-    blur_buffer(width, height, blur_vertex_path, blur_frag_path, { GL_RGBA16F }, false, false)
+  // Lit colors without alpha, packed floats take half the bytes of RGBA16F
+  : hdr_buffer(width, height, fb_vertex_path, fb_frag_path,
+               { GL_R11F_G11F_B10F, GL_R11F_G11F_B10F }, true, false),
+    blur_shader(std::make_unique<Shader>(blur_vertex_path, blur_frag_path))
 {
+  hdr_buffer.set_name("HDR");
+  glGenFramebuffers(1, &blur_FBO);
 }
 
-void GaussianBlur::bind_framebuffer() const
+GaussianBlur::~GaussianBlur()
 {
-  hdr_buffer.bind_framebuffer();
+  glDeleteFramebuffers(1, &blur_FBO);
+}
+
+void GaussianBlur::bind_framebuffer(const std::vector<FrameBuffer::LoadAction>& color_loads,
+                                    FrameBuffer::LoadAction depth_load) const
+{
+  hdr_buffer.bind_framebuffer(color_loads, depth_load);
+}
+
+void GaussianBlur::store_framebuffer(const std::vector<FrameBuffer::StoreAction>& color_stores,
+                                     FrameBuffer::StoreAction depth_store) const
+{
+  hdr_buffer.store_framebuffer(color_stores, depth_store);
 }
 
 void GaussianBlur::unbind_framebuffer() const
@@ -19,44 +35,46 @@ void GaussianBlur::unbind_framebuffer() const
   hdr_buffer.unbind_framebuffer();
 }
 
-void GaussianBlur::blur() const
+unsigned int GaussianBlur::blur(const std::array<unsigned int, 2>& targets) const
 {
-  PROFILE_SCOPE("GaussianBlur");
+  PROFILE_GPU_SCOPE("GaussianBlur");
+
+  constexpr unsigned int amount = 5;
 
-  constexpr int amount = 5;
+  glDisable(GL_DEPTH_TEST);
+  glBindFramebuffer(GL_FRAMEBUFFER, blur_FBO);
 
-  glBindFramebuffer(GL_FRAMEBUFFER, blur_buffer.FBO);
+  unsigned int source = hdr_buffer.color_textures[1];
 
-  PROFILE_SECTION_START("Blur1");
-  Textures textures;
-  textures.add_texture("image", hdr_buffer.color_textures[1]);
-  blur_buffer.rect.draw(*blur_buffer.shader, textures);
+  for (unsigned int i = 0; i < amount; i++) {
+    PROFILE_SECTION_START_ID(PROFILE_IDS("Blur%d", 1, amount)[i]);
+    const unsigned int target = targets[i & 1];
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
 
-  textures.clear();
-  textures.add_texture("image", blur_buffer.color_textures.front());
-  PROFILE_SECTION_END();
+    Textures textures;
+    textures.add_texture("image", source);
 
-  for (unsigned int i = 1; i < amount; i++) {
-    PROFILE_SECTION_START("Blur" + std::to_string(i + 1));
     if ((i & 1) == 1) {
-      blur_buffer.rect.draw(*blur_buffer.shader, textures, { "horizontal" });
+      hdr_buffer.rect.draw(*blur_shader, textures, { "horizontal" });
     } else {
-      blur_buffer.rect.draw(*blur_buffer.shader, textures);
+      hdr_buffer.rect.draw(*blur_shader, textures);
     }
+
+    source = target;
     PROFILE_SECTION_END();
   }
 
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  return source;
 }
 
-void GaussianBlur::blur_scene() const
+unsigned int GaussianBlur::get_hdr_texture() const
 {
-  glDisable(GL_DEPTH_TEST);
-
-  blur();
+  return hdr_buffer.color_textures.front();
+}
 
-  Textures textures;
-  textures.add_texture("hdr", hdr_buffer.color_textures.front());
-  textures.add_texture("bloom", blur_buffer.color_textures.front());
-  hdr_buffer.rect.draw(*hdr_buffer.shader, textures);
+unsigned int GaussianBlur::get_bright_texture() const
+{
+  return hdr_buffer.color_textures[1];
 }
@@ -3,22 +3,32 @@
 
 #include "framebuffer/framebuffer.h"
 
+#include <array>
+
 class GaussianBlur
 {
 public:
   GaussianBlur(int width, int height,
                const char* blur_vertex_path, const char* blur_frag_path,
                const char* fb_vertex_path, const char* fb_frag_path);
+  ~GaussianBlur();
 
-  void bind_framebuffer() const;
+  void bind_framebuffer(const std::vector<FrameBuffer::LoadAction>& color_loads,
+                        FrameBuffer::LoadAction depth_load) const;
+  void store_framebuffer(const std::vector<FrameBuffer::StoreAction>& color_stores,
+                         FrameBuffer::StoreAction depth_store) const;
   void unbind_framebuffer() const;
-  void blur_scene() const;
+  // Blurs the bright colors, ping-ponging between two targets of the screen's size, and
+  // returns the one holding the result
+  unsigned int blur(const std::array<unsigned int, 2>& targets) const;
 
-private:
-  void blur() const;
+  unsigned int get_hdr_texture() const;
+  unsigned int get_bright_texture() const;
 
+private:
   FrameBuffer hdr_buffer;
-  FrameBuffer blur_buffer;
+  unsigned int blur_FBO;
+  std::unique_ptr<Shader> blur_shader;
 };
 
 #endif // GAUSSIANBLUR_H
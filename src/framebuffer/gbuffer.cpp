@@ -0,0 +1,148 @@
+#include "gbuffer.h"
+#include "shadow/point_shadow_cache.h"
+#include "util/exception.h"
+#include "util/logging.h"
+
+constexpr const char* LAYOUT_NAMES[] {
+  "Wide",
+  "Compact RG16",
+  "Compact RGB10A2",
+};
+
+// The depth buffer is counted as 4 bytes whatever the driver picks
+constexpr int DEPTH_BYTES = 4;
+
+GBuffer::GBuffer(int width, int height, Layout layout)
+  : FrameBuffer(width, height,
+                "../../shaders/processing/deferred.vert", "../../shaders/processing/deferred.frag",
+                get_formats(layout), layout == Layout::WIDE, false,
+                generate_defines(layout) + PointShadowCache::get_shader_source()),
+    layout(layout),
+    shader_defines(generate_defines(layout)),
+    dir_light_shader(std::make_shared<Shader>("../../shaders/processing/deferred.vert",
+                                              "../../shaders/processing/deferred.frag",
+                                              std::nullopt, shader_defines +
+                                              "#define DIR_LIGHTS_ONLY\n" +
+                                              PointShadowCache::get_shader_source()))
+{
+  set_name("G-Buffer");
+
+  logger_t logger = Logging::get_logger();
+  logger << "G-buffer layout " << get_layout_name() << ": " << get_bytes_per_pixel()
+         << " bytes per pixel, " << static_cast<double>(get_bytes_per_pixel()) * width * height /
+            (1024.0 * 1024.0) << " MB" << std::endl;
+}
+
+GBuffer::Layout GBuffer::get_layout() const
+{
+  return layout;
+}
+
+const char* GBuffer::get_layout_name() const
+{
+  return LAYOUT_NAMES[static_cast<size_t>(layout)];
+}
+
+const std::string& GBuffer::get_shader_defines() const
+{
+  return shader_defines;
+}
+
+int GBuffer::get_bytes_per_pixel() const
+{
+  int bytes = DEPTH_BYTES;
+
+  for (GLenum format : formats) {
+    bytes += FrameBuffer::get_bytes_per_pixel(format);
+  }
+
+  return bytes;
+}
+
+unsigned int GBuffer::get_depth_texture() const
+{
+  return depth_texture;
+}
+
+unsigned int GBuffer::get_velocity_texture() const
+{
+  return color_textures.back();
+}
+
+void GBuffer::bind_framebuffer(const std::vector<LoadAction>& color_loads,
+                               LoadAction depth_load) const
+{
+  FrameBuffer::bind_framebuffer(color_loads, depth_load);
+
+  if ((color_loads.size() == 1 ? color_loads.front() : color_loads.back()) == LoadAction::CLEAR) {
+    clear_velocity();
+  }
+}
+
+void GBuffer::bind_color_targets() const
+{
+  std::vector<unsigned int> attachments;
+
+  for (unsigned int i = 0; i < color_textures.size(); i++) {
+    attachments.emplace_back(GL_COLOR_ATTACHMENT0 + i);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glDrawBuffers(static_cast<int>(attachments.size()), attachments.data());
+  glClear(GL_COLOR_BUFFER_BIT);
+  clear_velocity();
+}
+
+void GBuffer::draw_dir_lights() const
+{
+  glDisable(GL_DEPTH_TEST);
+  rect.draw(*dir_light_shader, textures);
+}
+
+std::shared_ptr<Shader> GBuffer::get_dir_light_shader() const
+{
+  return dir_light_shader;
+}
+
+void GBuffer::discard_targets(bool keep_velocity) const
+{
+  std::vector<GLenum> attachments { depth_attachment };
+  const size_t num_discarded = color_textures.size() - (keep_velocity ? 1 : 0);
+
+  for (unsigned int i = 0; i < num_discarded; i++) {
+    attachments.emplace_back(GL_COLOR_ATTACHMENT0 + i);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glInvalidateFramebuffer(GL_FRAMEBUFFER, static_cast<int>(attachments.size()),
+                          attachments.data());
+}
+
+void GBuffer::clear_velocity() const
+{
+  const float no_motion[4] { NO_MOTION, NO_MOTION, 0.0f, 0.0f };
+  glClearBufferfv(GL_COLOR, static_cast<int>(color_textures.size() - 1), no_motion);
+}
+
+std::vector<GLenum> GBuffer::get_formats(Layout layout)
+{
+  switch (layout) {
+    case Layout::WIDE:
+      // Position, tangent space normal, albedo and specular, tangent, bitangent, normal and
+      // velocity
+      return { GL_RGB16F, GL_RGB16F, GL_RGBA, GL_RGB16F, GL_RGB16F, GL_RGB16F, GL_RG16F };
+    // Depth is unsized like the renderbuffers it gets blitted into, blits need matching
+    // formats
+    case Layout::COMPACT_RG16:
+      return { GL_RG16, GL_RGBA, GL_RG16F, GL_DEPTH_COMPONENT };
+    case Layout::COMPACT_RGB10A2:
+      return { GL_RGB10_A2, GL_RGBA, GL_RG16F, GL_DEPTH_COMPONENT };
+  }
+
+  return {};
+}
+
+std::string GBuffer::generate_defines(Layout layout)
+{
+  return "#define GBUFFER_COMPACT " + std::to_string(layout == Layout::WIDE ? 0 : 1) + "\n";
+}
@@ -0,0 +1,63 @@
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include "framebuffer/framebuffer.h"
+
+#include <string>
+#include <vector>
+
+// Matches taa.frag, far outside of any motion that keeps a pixel on screen
+constexpr float NO_MOTION = 1e4f;
+
+// Geometry buffer of the deferred renderer together with the lighting shader reading it.
+// The wide layout stores world positions, tangent space normals and the tangent frame. The
+// compact layouts only store an octahedral world space normal and albedo with specular in
+// RGBA8, positions are rebuilt from a depth texture. Every layout ends with screen space
+// motion vectors for temporal anti-aliasing. Shaders reading or writing the buffer
+// are compiled with get_shader_defines() so they match the layout.
+class GBuffer : public FrameBuffer
+{
+public:
+  enum class Layout {
+    WIDE,
+    COMPACT_RG16,
+    COMPACT_RGB10A2,
+  };
+
+  GBuffer(int width, int height, Layout layout);
+
+  using FrameBuffer::bind_framebuffer;
+  // A cleared velocity target is set to NO_MOTION
+  void bind_framebuffer(const std::vector<LoadAction>& color_loads,
+                        LoadAction depth_load) const override;
+
+  Layout get_layout() const;
+  const char* get_layout_name() const;
+  const std::string& get_shader_defines() const;
+  int get_bytes_per_pixel() const;
+  unsigned int get_depth_texture() const;
+  // Motion since the last frame in texture coordinates, pixels no geometry was drawn to
+  // are left at NO_MOTION
+  unsigned int get_velocity_texture() const;
+  // Binds the color targets for writing without clearing depth, used to resolve a
+  // visibility buffer that already filled the depth texture
+  void bind_color_targets() const;
+  // Lights the scene with the directional lights alone, the light volumes add the point
+  // lights on top
+  void draw_dir_lights() const;
+  std::shared_ptr<Shader> get_dir_light_shader() const;
+  // Invalidates the targets once lighting has read them, TAA still needs the motion vectors
+  void discard_targets(bool keep_velocity) const;
+
+private:
+  void clear_velocity() const;
+  static std::vector<GLenum> get_formats(Layout layout);
+  static std::string generate_defines(Layout layout);
+
+  Layout layout;
+  std::string shader_defines;
+  // The lighting shader without the point lights
+  std::shared_ptr<Shader> dir_light_shader;
+};
+
+#endif // GBUFFER_H
@@ -1,28 +1,32 @@
 #include "multisampleframebuffer.h"
 #include "util/exception.h"
 #include "util/data.h"
+#include "framebuffer/bandwidth.h"
 
 MultiSampleFrameBuffer::MultiSampleFrameBuffer(int width, int height,
                                                const char* vertex_path, const char* frag_path,
                                                const std::vector<GLenum>& buffer_formats,
                                                bool renderbuffer,
                                                bool stencil)
-  : FrameBuffer (width, height, vertex_path, frag_path, buffer_formats, false, stencil)
+  : FrameBuffer (width, height, vertex_path, frag_path, buffer_formats, false, stencil),
+    multiRBO(0),
+    multi_depth_attachment(0)
 {
   unsigned int rb_storage_type = stencil ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT;
   unsigned int rb_attachment_type = stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
 
   glGenFramebuffers(1, &multiFBO);
 
-  multi_color_textures.resize(buffer_formats.size());
-  glGenTextures(static_cast<int>(buffer_formats.size()), multi_color_textures.data());
+  // The resolved formats, after any fallback
+  multi_color_textures.resize(formats.size());
+  glGenTextures(static_cast<int>(formats.size()), multi_color_textures.data());
 
   glBindFramebuffer(GL_FRAMEBUFFER, multiFBO);
 
-  for (unsigned int i = 0; i < buffer_formats.size(); i++) {
+  for (unsigned int i = 0; i < formats.size(); i++) {
     glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, multi_color_textures[i]);
     glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, NUM_AA_SAMPLES,
-                            buffer_formats[i], width, height, GL_TRUE);
+                            formats[i], width, height, GL_TRUE);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
                            GL_TEXTURE_2D_MULTISAMPLE, multi_color_textures[i], 0);
   }
@@ -32,6 +36,7 @@ MultiSampleFrameBuffer::MultiSampleFrameBuffer(int width, int height,
     glBindRenderbuffer(GL_RENDERBUFFER, multiRBO);
     glRenderbufferStorageMultisample(GL_RENDERBUFFER, NUM_AA_SAMPLES, rb_storage_type, width, height);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, rb_attachment_type, GL_RENDERBUFFER, multiRBO);
+    multi_depth_attachment = rb_attachment_type;
   }
 
   if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
@@ -49,35 +54,49 @@ MultiSampleFrameBuffer::~MultiSampleFrameBuffer()
   glDeleteTextures(static_cast<int>(multi_color_textures.size()), multi_color_textures.data());
 }
 
-void MultiSampleFrameBuffer::bind_framebuffer() const
+void MultiSampleFrameBuffer::bind_framebuffer(const std::vector<LoadAction>& color_loads,
+                                              LoadAction depth_load) const
 {
   glBindFramebuffer(GL_FRAMEBUFFER, multiFBO);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glEnable(GL_DEPTH_TEST);
-
-  if (multi_color_textures.size() == 1) {
-    return;
-  }
-
-  std::vector<unsigned int> attachments;
-
-  for (unsigned int i = 0; i < multi_color_textures.size(); i++) {
-    attachments.emplace_back(GL_COLOR_ATTACHMENT0 + i);
-  }
-
-  glDrawBuffers(static_cast<int>(multi_color_textures.size()), attachments.data());
+  set_draw_buffers(multi_color_textures.size());
+  load_attachments(color_loads, depth_load, multi_depth_attachment, NUM_AA_SAMPLES);
 }
 
-void MultiSampleFrameBuffer::unbind_framebuffer() const
+void MultiSampleFrameBuffer::store_framebuffer(const std::vector<StoreAction>& color_stores,
+                                               StoreAction depth_store) const
 {
+  int viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  const int x1 = viewport[0] + viewport[2];
+  const int y1 = viewport[1] + viewport[3];
+
   glBindFramebuffer(GL_READ_FRAMEBUFFER, multiFBO);
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
 
-  for (unsigned int i = 0; i < color_textures.size(); i++) {
+  for (unsigned int i = 0; i < multi_color_textures.size(); i++) {
+    if ((color_stores.size() == 1 ? color_stores.front() : color_stores[i]) ==
+        StoreAction::DISCARD) {
+      continue;
+    }
+
     glReadBuffer(GL_COLOR_ATTACHMENT0 + i);
     glDrawBuffer(GL_COLOR_ATTACHMENT0 + i);
-    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBlitFramebuffer(viewport[0], viewport[1], x1, y1, viewport[0], viewport[1], x1, y1,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
   }
 
+  // The resolve writes the single sample colors, the samples never leave the tile
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  store_attachments(color_stores, StoreAction::DISCARD, 0, 1);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, multiFBO);
+  store_attachments({ StoreAction::DISCARD }, depth_store, multi_depth_attachment,
+                    NUM_AA_SAMPLES);
+}
+
+void MultiSampleFrameBuffer::unbind_framebuffer() const
+{
+  store_framebuffer({ StoreAction::STORE }, StoreAction::DISCARD);
   FrameBuffer::unbind_framebuffer();
 }
@@ -6,6 +6,8 @@
 #include <glad/glad.h>
 #include <vector>
 
+// Renders into multisampled attachments and resolves them into the single sample textures.
+// Stored colors are resolved, the samples themselves are always invalidated after.
 class MultiSampleFrameBuffer : public FrameBuffer
 {
 public:
@@ -16,11 +18,17 @@ public:
                          bool stencil = false);
   ~MultiSampleFrameBuffer() override;
 
-  void bind_framebuffer() const override;
+  using FrameBuffer::bind_framebuffer;
+  void bind_framebuffer(const std::vector<LoadAction>& color_loads,
+                        LoadAction depth_load) const override;
+  void store_framebuffer(const std::vector<StoreAction>& color_stores,
+                         StoreAction depth_store) const override;
+  // Resolves every color
   void unbind_framebuffer() const override;
 
 private:
   unsigned int multiFBO, multiRBO;
+  GLenum multi_depth_attachment;
   std::vector<unsigned int> multi_color_textures;
 };
 
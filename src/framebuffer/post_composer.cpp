@@ -0,0 +1,204 @@
+#include "post_composer.h"
+#include "util/data.h"
+#include "util/logging.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <vector>
+
+constexpr int LUT_SIZE = 16;
+constexpr int HDR_UNIT = 0;
+constexpr int BLOOM_UNIT = 1;
+constexpr int LUT_UNIT = 2;
+
+PostComposer::PostComposer(int effects)
+  : effects(-1),
+    exposure(1.0f),
+    vignette(0.3f),
+    gamma(2.2f)
+{
+  create_lut();
+
+  rect.start_setup();
+  rect.add_vertices(QUAD_VERTICES, 6, sizeof (QUAD_VERTICES));
+  rect.add_vertex_attribs({ 2, 2 });
+  rect.finalize_setup();
+
+  set_effects(effects);
+}
+
+PostComposer::~PostComposer()
+{
+  glDeleteTextures(1, &lut_texture);
+}
+
+void PostComposer::set_effects(int effects)
+{
+  if (effects == this->effects) {
+    return;
+  }
+
+  this->effects = effects;
+
+  if (shaders.find(effects) == shaders.end()) {
+    shaders.emplace(effects, std::make_unique<Shader>("../../shaders/processing/fb.vert",
+                                                      "../../shaders/processing/compose.frag",
+                                                      std::nullopt,
+                                                      get_shader_defines(effects)));
+  }
+
+  logger_t logger = Logging::get_logger();
+  logger << "Post composer: " << get_effect_names() << ", " << shaders.size()
+         << " variants compiled" << std::endl;
+}
+
+int PostComposer::get_effects() const
+{
+  return effects;
+}
+
+void PostComposer::toggle_effect(Effect effect)
+{
+  set_effects(effects ^ effect);
+}
+
+std::string PostComposer::get_effect_names() const
+{
+  std::string names;
+
+  for (int i = 0; i < NUM_EFFECTS; i++) {
+    const Effect effect = static_cast<Effect>(1 << i);
+
+    if (effects & effect) {
+      names += (names.empty() ? "" : "+") + std::string(get_effect_name(effect));
+    }
+  }
+
+  return names.empty() ? "None" : names;
+}
+
+bool PostComposer::is_output_encoded() const
+{
+  return (effects & GAMMA) != 0;
+}
+
+void PostComposer::set_exposure(float exposure)
+{
+  this->exposure = exposure;
+}
+
+void PostComposer::set_vignette(float vignette)
+{
+  this->vignette = vignette;
+}
+
+void PostComposer::set_gamma(float gamma)
+{
+  this->gamma = gamma;
+}
+
+void PostComposer::draw(unsigned int hdr_texture, unsigned int bloom_texture,
+                        float bloom_strength) const
+{
+  const Shader& shader = *shaders.at(effects);
+
+  glDisable(GL_DEPTH_TEST);
+  // With the gamma effect the shader encodes, otherwise the sRGB framebuffer does
+  if (effects & GAMMA) {
+    glDisable(GL_FRAMEBUFFER_SRGB);
+  }
+
+  shader.use_shader_program();
+  glUniform1i(shader.get_uniform_location("hdr"), HDR_UNIT);
+  glUniform1i(shader.get_uniform_location("bloom"), BLOOM_UNIT);
+  glUniform1i(shader.get_uniform_location("lut"), LUT_UNIT);
+  glUniform1f(shader.get_uniform_location("bloom_strength"), bloom_strength);
+  glUniform1f(shader.get_uniform_location("exposure"), exposure);
+  glUniform1f(shader.get_uniform_location("vignette"), vignette);
+  glUniform1f(shader.get_uniform_location("gamma"), gamma);
+
+  glActiveTexture(GL_TEXTURE0 + HDR_UNIT);
+  glBindTexture(GL_TEXTURE_2D, hdr_texture);
+  glActiveTexture(GL_TEXTURE0 + BLOOM_UNIT);
+  glBindTexture(GL_TEXTURE_2D, bloom_texture);
+  glActiveTexture(GL_TEXTURE0 + LUT_UNIT);
+  glBindTexture(GL_TEXTURE_3D, lut_texture);
+
+  rect.draw(shader);
+
+  glBindTexture(GL_TEXTURE_3D, 0);
+  glEnable(GL_FRAMEBUFFER_SRGB);
+}
+
+const char* PostComposer::get_effect_name(Effect effect)
+{
+  switch (effect) {
+    case BLOOM:
+      return "Bloom";
+    case EXPOSURE:
+      return "Exposure";
+    case TONEMAP:
+      return "Tonemap";
+    case COLOR_GRADING:
+      return "Color Grading";
+    case VIGNETTE:
+      return "Vignette";
+    case GAMMA:
+      return "Gamma";
+  }
+
+  return "";
+}
+
+std::string PostComposer::get_shader_defines(int effects)
+{
+  std::string defines;
+
+  defines += "#define EFFECT_BLOOM " + std::to_string((effects & BLOOM) != 0) + "\n";
+  defines += "#define EFFECT_EXPOSURE " + std::to_string((effects & EXPOSURE) != 0) + "\n";
+  defines += "#define EFFECT_TONEMAP " + std::to_string((effects & TONEMAP) != 0) + "\n";
+  defines += "#define EFFECT_COLOR_GRADING " +
+             std::to_string((effects & COLOR_GRADING) != 0) + "\n";
+  defines += "#define EFFECT_VIGNETTE " + std::to_string((effects & VIGNETTE) != 0) + "\n";
+  defines += "#define EFFECT_GAMMA " + std::to_string((effects & GAMMA) != 0) + "\n";
+
+  return defines;
+}
+
+void PostComposer::create_lut()
+{
+  // A warm grade: shadows lifted towards blue, highlights pushed towards orange, slightly
+  // more contrast and saturation. Graded colors are looked up by their LDR value.
+  std::vector<unsigned char> data;
+  data.reserve(LUT_SIZE * LUT_SIZE * LUT_SIZE * 3);
+
+  for (int b = 0; b < LUT_SIZE; b++) {
+    for (int g = 0; g < LUT_SIZE; g++) {
+      for (int r = 0; r < LUT_SIZE; r++) {
+        vec3 color = vec3(r, g, b) / static_cast<float>(LUT_SIZE - 1);
+        const float luminance = glm::dot(color, vec3(0.2126f, 0.7152f, 0.0722f));
+
+        color = glm::mix(vec3(luminance), color, 1.15f);
+        color = glm::mix(color, color * color * (3.0f - 2.0f * color), 0.3f);
+        color += glm::mix(vec3(-0.01f, 0.0f, 0.04f), vec3(0.04f, 0.01f, -0.03f), luminance);
+        color = glm::clamp(color, vec3(0.0f), vec3(1.0f));
+
+        data.push_back(static_cast<unsigned char>(color.x * 255.0f + 0.5f));
+        data.push_back(static_cast<unsigned char>(color.y * 255.0f + 0.5f));
+        data.push_back(static_cast<unsigned char>(color.z * 255.0f + 0.5f));
+      }
+    }
+  }
+
+  glGenTextures(1, &lut_texture);
+  glBindTexture(GL_TEXTURE_3D, lut_texture);
+  glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB8, LUT_SIZE, LUT_SIZE, LUT_SIZE, 0,
+               GL_RGB, GL_UNSIGNED_BYTE, data.data());
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_3D, 0);
+}
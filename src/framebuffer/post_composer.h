@@ -0,0 +1,59 @@
+#ifndef POST_COMPOSER_H
+#define POST_COMPOSER_H
+
+#include "shader/shader.h"
+#include "model/object.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Fuses the per-pixel effects at the end of the frame into one full screen pass, so the
+// HDR scene is read and the framebuffer written once whatever is enabled. The shader is
+// compose.frag with a define per enabled effect, compiled the first time a set is used.
+// Effects that read neighbouring pixels, like the bloom blurs, stay separate passes and
+// only hand their result in as a texture.
+class PostComposer
+{
+public:
+  // In the order they're applied
+  enum Effect {
+    BLOOM = 1 << 0,
+    EXPOSURE = 1 << 1,
+    TONEMAP = 1 << 2,
+    COLOR_GRADING = 1 << 3,
+    VIGNETTE = 1 << 4,
+    GAMMA = 1 << 5,
+  };
+
+  static constexpr int NUM_EFFECTS = 6;
+
+  PostComposer(int effects);
+  ~PostComposer();
+
+  void set_effects(int effects);
+  int get_effects() const;
+  void toggle_effect(Effect effect);
+  std::string get_effect_names() const;
+  // With the gamma effect the output holds display values rather than linear ones
+  bool is_output_encoded() const;
+
+  void set_exposure(float exposure);
+  void set_vignette(float vignette);
+  void set_gamma(float gamma);
+
+  void draw(unsigned int hdr_texture, unsigned int bloom_texture, float bloom_strength) const;
+
+private:
+  static const char* get_effect_name(Effect effect);
+  static std::string get_shader_defines(int effects);
+  void create_lut();
+
+  int effects;
+  float exposure, vignette, gamma;
+  unsigned int lut_texture;
+  std::unordered_map<int, std::unique_ptr<Shader>> shaders;
+  Object rect;
+};
+
+#endif // POST_COMPOSER_H
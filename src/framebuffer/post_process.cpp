@@ -0,0 +1,126 @@
+#include "post_process.h"
+#include "framebuffer/framebuffer.h"
+#include "util/data.h"
+#include "util/profiling/profiling.h"
+
+#include <algorithm>
+
+// Must match the local sizes in blur.comp and tonemap.comp
+constexpr int BLUR_TILE_SIZE = 128;
+constexpr int TONEMAP_TILE_SIZE = 16;
+constexpr int INPUT_UNIT = 0;
+constexpr int BLOOM_UNIT = 1;
+constexpr int OUTPUT_IMAGE = 0;
+// Blur passes timed under their own names, the ones past them are timed under the last
+constexpr int NAMED_BLUR_PASSES = 16;
+
+static int num_groups(int size, int tile_size)
+{
+  return (size + tile_size - 1) / tile_size;
+}
+
+ComputePostProcess::ComputePostProcess(int width, int height)
+  : render_width(width),
+    render_height(height),
+    blur_format(FrameBuffer::get_supported_format(GL_R11F_G11F_B10F)),
+    blur_shader(std::make_unique<Shader>("../../shaders/processing/blur.comp",
+                                         generate_blur_defines(blur_format))),
+    tonemap_shader(std::make_unique<Shader>("../../shaders/processing/tonemap.comp")),
+    present_shader(std::make_unique<Shader>("../../shaders/processing/fb.vert",
+                                            "../../shaders/processing/present.frag"))
+{
+  rect.start_setup();
+  rect.add_vertices(QUAD_VERTICES, 6, sizeof (QUAD_VERTICES));
+  rect.add_vertex_attribs({ 2, 2 });
+  rect.finalize_setup();
+}
+
+void ComputePostProcess::set_render_size(int width, int height)
+{
+  render_width = width;
+  render_height = height;
+}
+
+unsigned int ComputePostProcess::blur(unsigned int source_texture, int passes,
+                                      const std::array<unsigned int, 2>& targets) const
+{
+  PROFILE_GPU_SCOPE("Compute Blur")
+
+  blur_shader->use_shader_program();
+  glUniform1i(blur_shader->get_uniform_location("source"), INPUT_UNIT);
+  const int horizontal_location = blur_shader->get_uniform_location("horizontal");
+
+  unsigned int input = source_texture;
+
+  for (int i = 0; i < passes; i++) {
+    PROFILE_SECTION_START_ID(PROFILE_IDS("Blur%d", 1, NAMED_BLUR_PASSES)[
+      static_cast<size_t>(std::min(i, NAMED_BLUR_PASSES - 1))])
+    const unsigned int output = targets[static_cast<size_t>(i & 1)];
+    const bool horizontal = (i & 1) == 1;
+
+    glActiveTexture(GL_TEXTURE0 + INPUT_UNIT);
+    glBindTexture(GL_TEXTURE_2D, input);
+    glBindImageTexture(OUTPUT_IMAGE, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, blur_format);
+    glUniform1i(horizontal_location, horizontal);
+
+    // Work groups run along the filtered axis, one per segment of a row or column
+    if (horizontal) {
+      dispatch(num_groups(render_width, BLUR_TILE_SIZE), render_height);
+    } else {
+      dispatch(num_groups(render_height, BLUR_TILE_SIZE), render_width);
+    }
+
+    input = output;
+    PROFILE_SECTION_END()
+  }
+
+  return input;
+}
+
+void ComputePostProcess::tonemap(unsigned int hdr_texture, unsigned int bloom_texture,
+                                 float bloom_strength, unsigned int target) const
+{
+  PROFILE_GPU_SCOPE("Compute Tonemap")
+
+  tonemap_shader->use_shader_program();
+  glUniform1i(tonemap_shader->get_uniform_location("hdr"), INPUT_UNIT);
+  glUniform1i(tonemap_shader->get_uniform_location("bloom"), BLOOM_UNIT);
+  glUniform1f(tonemap_shader->get_uniform_location("bloom_strength"), bloom_strength);
+
+  glActiveTexture(GL_TEXTURE0 + INPUT_UNIT);
+  glBindTexture(GL_TEXTURE_2D, hdr_texture);
+  glActiveTexture(GL_TEXTURE0 + BLOOM_UNIT);
+  glBindTexture(GL_TEXTURE_2D, bloom_texture);
+  // sRGB formats can't be image stores, the tonemap encodes by hand and present decodes
+  glBindImageTexture(OUTPUT_IMAGE, target, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+  dispatch(num_groups(render_width, TONEMAP_TILE_SIZE),
+           num_groups(render_height, TONEMAP_TILE_SIZE));
+}
+
+void ComputePostProcess::present(unsigned int texture) const
+{
+  glDisable(GL_DEPTH_TEST);
+
+  Textures textures;
+  textures.add_texture("image", texture);
+  rect.draw(*present_shader, textures);
+}
+
+void ComputePostProcess::dispatch(int groups_x, int groups_y) const
+{
+  glDispatchCompute(static_cast<unsigned int>(groups_x), static_cast<unsigned int>(groups_y), 1);
+  // The next effect samples what this one stored
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+}
+
+GLenum ComputePostProcess::get_blur_format() const
+{
+  return blur_format;
+}
+
+std::string ComputePostProcess::generate_blur_defines(GLenum format)
+{
+  return std::string("#define BLUR_FORMAT ") +
+         (format == GL_R11F_G11F_B10F ? "r11f_g11f_b10f" : "rgba16f") + "\n";
+}
@@ -0,0 +1,52 @@
+#ifndef POST_PROCESS_H
+#define POST_PROCESS_H
+
+#include "shader/shader.h"
+#include "model/object.h"
+
+#include <glad/glad.h>
+
+#include <array>
+#include <memory>
+#include <string>
+
+// Full screen effects as compute dispatches over 2D tiles instead of quads through the raster
+// pipeline. Every effect reads its inputs as textures and writes its result with image stores,
+// so one effect's output is the next one's input with only a memory barrier in between and no
+// framebuffer is bound until the result is presented.
+class ComputePostProcess
+{
+public:
+  ComputePostProcess(int width, int height);
+
+  // Part of the targets rendered to, effects only run over it
+  void set_render_size(int width, int height);
+
+  // Separable Gaussian alternating vertical and horizontal passes like GaussianBlur, each
+  // work group loads its row or column segment and the apron around it into shared memory.
+  // Ping-pongs between two targets of the blur format and returns the one holding the result.
+  unsigned int blur(unsigned int source_texture, int passes,
+                    const std::array<unsigned int, 2>& targets) const;
+  // Adds the bloom to the HDR scene and tonemaps it like fb.frag into an RGBA8 target
+  void tonemap(unsigned int hdr_texture, unsigned int bloom_texture, float bloom_strength,
+               unsigned int target) const;
+  // Copies an effect's output into the bound framebuffer, the chain's only draw
+  void present(unsigned int texture) const;
+
+  // R11F_G11F_B10F where it can be rendered to, RGBA16F otherwise
+  GLenum get_blur_format() const;
+
+private:
+  void dispatch(int groups_x, int groups_y) const;
+  // Image stores need the format spelled out in the shader
+  static std::string generate_blur_defines(GLenum format);
+
+  int render_width, render_height;
+  GLenum blur_format;
+  std::unique_ptr<Shader> blur_shader;
+  std::unique_ptr<Shader> tonemap_shader;
+  std::unique_ptr<Shader> present_shader;
+  Object rect;
+};
+
+#endif // POST_PROCESS_H
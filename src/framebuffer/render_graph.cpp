@@ -0,0 +1,340 @@
+#include "render_graph.h"
+#include "framebuffer/framebuffer.h"
+#include "util/exception.h"
+#include "util/logging.h"
+#include "util/profiling/profiling.h"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+// Pooled textures no pass asked for in this many frames are deleted
+constexpr int MAX_UNUSED_FRAMES = 120;
+
+bool RenderGraph::TextureDesc::operator==(const TextureDesc& other) const
+{
+  return width == other.width && height == other.height && format == other.format;
+}
+
+RenderGraph::RenderGraph()
+  : logged_declared_bytes(-1),
+    logged_pool_bytes(-1),
+    logged_passes(0),
+    logged_culled(0)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+  for (const auto& pooled : pool) {
+    glDeleteTextures(1, &pooled.texture);
+  }
+}
+
+void RenderGraph::reset()
+{
+  resources.clear();
+  passes.clear();
+}
+
+RenderGraph::Resource RenderGraph::create_texture(const std::string& name,
+                                                  const TextureDesc& desc)
+{
+  TextureDesc supported = desc;
+  supported.format = FrameBuffer::get_supported_format(desc.format);
+
+  resources.push_back({ name, supported, false, false, 0, -1, -1 });
+  return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::import_texture(const std::string& name, unsigned int texture)
+{
+  resources.push_back({ name, { 0, 0, GL_NONE }, true, false, texture, -1, -1 });
+  return static_cast<Resource>(resources.size() - 1);
+}
+
+void RenderGraph::mark_output(Resource resource)
+{
+  resources[static_cast<size_t>(resource)].output = true;
+}
+
+void RenderGraph::add_pass(Profiling::ScopeId name, std::vector<Resource> reads,
+                           std::vector<Resource> writes, Execute execute)
+{
+  passes.push_back({ name, std::move(reads), std::move(writes), std::move(execute), false });
+}
+
+void RenderGraph::compile()
+{
+  sort_passes();
+  cull_passes();
+
+  long long declared_bytes = 0;
+  for (const auto& resource : resources) {
+    if (!resource.imported) {
+      declared_bytes += get_bytes(resource.desc);
+    }
+  }
+
+  assign_textures();
+  trim_pool();
+  log_memory(declared_bytes);
+}
+
+void RenderGraph::execute() const
+{
+  PROFILE_GPU_SCOPE("Render Graph")
+
+  for (const auto& pass : passes) {
+    if (pass.culled) {
+      continue;
+    }
+
+    PROFILE_SECTION_START_ID(pass.name)
+    pass.execute(*this);
+    PROFILE_SECTION_END()
+  }
+}
+
+unsigned int RenderGraph::get_texture(Resource resource) const
+{
+  return resources[static_cast<size_t>(resource)].texture;
+}
+
+long long RenderGraph::get_bytes(const TextureDesc& desc)
+{
+  return static_cast<long long>(FrameBuffer::get_bytes_per_pixel(desc.format)) *
+         desc.width * desc.height;
+}
+
+void RenderGraph::sort_passes()
+{
+  std::vector<std::vector<size_t>> successors(passes.size());
+  std::vector<int> num_predecessors(passes.size(), 0);
+
+  const auto add_edge = [&] (size_t from, size_t to) {
+    successors[from].push_back(to);
+    num_predecessors[to]++;
+  };
+
+  const auto accesses = [] (const std::vector<Resource>& resources, Resource resource) {
+    return std::find(resources.begin(), resources.end(), resource) != resources.end();
+  };
+
+  for (size_t r = 0; r < resources.size(); r++) {
+    const Resource resource = static_cast<Resource>(r);
+    std::vector<size_t> writers, updaters, readers;
+
+    for (size_t i = 0; i < passes.size(); i++) {
+      const bool reads = accesses(passes[i].reads, resource);
+
+      if (accesses(passes[i].writes, resource)) {
+        (reads ? updaters : writers).push_back(i);
+      } else if (reads) {
+        readers.push_back(i);
+      }
+    }
+
+    if (writers.empty() && !resources[r].imported && (!updaters.empty() || !readers.empty())) {
+      const size_t reader = updaters.empty() ? readers.front() : updaters.front();
+      throw RenderGraphException("Pass " + Profiling::get_name(passes[reader].name) + " reads " +
+                                 resources[r].name + " but no pass writes it");
+    }
+
+    // Writers, then updaters, each in the order they were added, then every reader
+    std::vector<size_t> chain = writers;
+    chain.insert(chain.end(), updaters.begin(), updaters.end());
+
+    for (size_t i = 1; i < chain.size(); i++) {
+      add_edge(chain[i - 1], chain[i]);
+    }
+
+    if (!chain.empty()) {
+      for (size_t reader : readers) {
+        add_edge(chain.back(), reader);
+      }
+    }
+  }
+
+  // Kahn's algorithm, taking the ready pass added first
+  std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+  std::vector<Pass> sorted;
+  sorted.reserve(passes.size());
+
+  for (size_t i = 0; i < passes.size(); i++) {
+    if (num_predecessors[i] == 0) {
+      ready.push(i);
+    }
+  }
+
+  while (!ready.empty()) {
+    const size_t pass = ready.top();
+    ready.pop();
+    sorted.push_back(std::move(passes[pass]));
+
+    for (size_t successor : successors[pass]) {
+      if (--num_predecessors[successor] == 0) {
+        ready.push(successor);
+      }
+    }
+  }
+
+  if (sorted.size() < passes.size()) {
+    std::string cycle;
+
+    for (size_t i = 0; i < passes.size(); i++) {
+      if (num_predecessors[i] > 0) {
+        cycle += (cycle.empty() ? "" : ", ") + Profiling::get_name(passes[i].name);
+      }
+    }
+
+    throw RenderGraphException("Passes " + cycle + " are in or wait on a cycle");
+  }
+
+  passes = std::move(sorted);
+}
+
+void RenderGraph::cull_passes()
+{
+  // Walking back from the outputs, a pass is needed when a needed pass after it reads
+  // something it writes
+  std::vector<bool> needed(resources.size(), false);
+
+  for (size_t i = 0; i < resources.size(); i++) {
+    needed[i] = resources[i].output;
+  }
+
+  for (auto pass = passes.rbegin(); pass != passes.rend(); pass++) {
+    pass->culled = std::none_of(pass->writes.begin(), pass->writes.end(), [&] (Resource write) {
+      return needed[static_cast<size_t>(write)];
+    });
+
+    if (!pass->culled) {
+      for (Resource read : pass->reads) {
+        needed[static_cast<size_t>(read)] = true;
+      }
+    }
+  }
+}
+
+void RenderGraph::assign_textures()
+{
+  for (int i = 0; i < static_cast<int>(passes.size()); i++) {
+    const Pass& pass = passes[static_cast<size_t>(i)];
+
+    if (pass.culled) {
+      continue;
+    }
+
+    const auto use = [&] (Resource resource) {
+      ResourceNode& node = resources[static_cast<size_t>(resource)];
+
+      if (node.first_pass < 0) {
+        node.first_pass = i;
+      }
+      node.last_pass = i;
+    };
+
+    std::for_each(pass.reads.begin(), pass.reads.end(), use);
+    std::for_each(pass.writes.begin(), pass.writes.end(), use);
+  }
+
+  for (auto& pooled : pool) {
+    pooled.in_use = false;
+    pooled.unused_frames++;
+  }
+
+  // Textures go back to the pool after their last pass, for later ones to take over
+  for (int i = 0; i < static_cast<int>(passes.size()); i++) {
+    for (auto& node : resources) {
+      if (!node.imported && node.first_pass == i) {
+        node.texture = acquire(node.desc);
+      }
+    }
+
+    for (const auto& node : resources) {
+      if (!node.imported && node.last_pass == i) {
+        release(node.texture);
+      }
+    }
+  }
+}
+
+unsigned int RenderGraph::acquire(const TextureDesc& desc)
+{
+  for (auto& pooled : pool) {
+    if (!pooled.in_use && pooled.desc == desc) {
+      pooled.in_use = true;
+      pooled.unused_frames = 0;
+      return pooled.texture;
+    }
+  }
+
+  PooledTexture pooled { desc, 0, true, 0 };
+
+  glGenTextures(1, &pooled.texture);
+  glBindTexture(GL_TEXTURE_2D, pooled.texture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, desc.format, desc.width, desc.height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  pool.emplace_back(pooled);
+
+  return pooled.texture;
+}
+
+void RenderGraph::release(unsigned int texture)
+{
+  for (auto& pooled : pool) {
+    if (pooled.texture == texture) {
+      pooled.in_use = false;
+      return;
+    }
+  }
+}
+
+void RenderGraph::trim_pool()
+{
+  for (auto it = pool.begin(); it != pool.end();) {
+    if (it->unused_frames > MAX_UNUSED_FRAMES) {
+      glDeleteTextures(1, &it->texture);
+      it = pool.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void RenderGraph::log_memory(long long declared_bytes)
+{
+  long long pool_bytes = 0;
+  for (const auto& pooled : pool) {
+    if (pooled.unused_frames == 0) {
+      pool_bytes += get_bytes(pooled.desc);
+    }
+  }
+
+  const size_t culled = static_cast<size_t>(std::count_if(passes.begin(), passes.end(),
+                                                          [] (const Pass& pass) {
+    return pass.culled;
+  }));
+
+  if (declared_bytes == logged_declared_bytes && pool_bytes == logged_pool_bytes &&
+      passes.size() == logged_passes && culled == logged_culled) {
+    return;
+  }
+
+  logged_declared_bytes = declared_bytes;
+  logged_pool_bytes = pool_bytes;
+  logged_passes = passes.size();
+  logged_culled = culled;
+
+  constexpr double MB = 1024.0 * 1024.0;
+  logger_t logger = Logging::get_logger();
+  logger << "Render graph: " << passes.size() << " passes, " << culled << " culled, "
+         << static_cast<double>(declared_bytes) / MB << " MB of transient targets declared, "
+         << static_cast<double>(pool_bytes) / MB << " MB allocated" << std::endl;
+}
@@ -0,0 +1,95 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include "util/profiling/scopenames.h"
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Frame described as passes declaring the textures they read and write. Compile orders the
+// passes by those textures, drops every pass whose writes nothing later reads and that
+// doesn't write an output, and hands transient textures out of a pool by lifetime, so
+// targets of culled passes aren't allocated and targets that are never alive at the same
+// time share one texture. Imported textures belong to someone else and are only tracked.
+class RenderGraph
+{
+public:
+  typedef int Resource;
+  typedef std::function<void(const RenderGraph&)> Execute;
+
+  struct TextureDesc {
+    int width, height;
+    GLenum format;
+
+    bool operator==(const TextureDesc& other) const;
+  };
+
+  RenderGraph();
+  ~RenderGraph();
+
+  // Clears the passes and resources of the last frame, the pooled textures stay
+  void reset();
+  Resource create_texture(const std::string& name, const TextureDesc& desc);
+  Resource import_texture(const std::string& name, unsigned int texture);
+  // Passes writing an output are never culled
+  void mark_output(Resource resource);
+  // Passes are added every frame, so their names are interned once by the caller, see
+  // PROFILE_ID
+  void add_pass(Profiling::ScopeId name, std::vector<Resource> reads,
+                std::vector<Resource> writes, Execute execute);
+
+  // Passes reading a texture run after the passes writing it. Passes both reading and writing
+  // it update it in place, after the ones only writing it. Passes that don't depend on each
+  // other, and several writers or updaters of one texture, keep the order they were added in.
+  // Throws when passes depend on each other in a cycle or read what no pass writes.
+  void compile();
+  void execute() const;
+
+  unsigned int get_texture(Resource resource) const;
+
+private:
+  struct ResourceNode {
+    std::string name;
+    TextureDesc desc;
+    bool imported;
+    bool output;
+    unsigned int texture;
+    int first_pass, last_pass;
+  };
+
+  struct Pass {
+    Profiling::ScopeId name;
+    std::vector<Resource> reads, writes;
+    Execute execute;
+    bool culled;
+  };
+
+  struct PooledTexture {
+    TextureDesc desc;
+    unsigned int texture;
+    bool in_use;
+    int unused_frames;
+  };
+
+  static long long get_bytes(const TextureDesc& desc);
+  void sort_passes();
+  void cull_passes();
+  void assign_textures();
+  unsigned int acquire(const TextureDesc& desc);
+  void release(unsigned int texture);
+  void trim_pool();
+  void log_memory(long long declared_bytes);
+
+  std::vector<ResourceNode> resources;
+  std::vector<Pass> passes;
+  std::vector<PooledTexture> pool;
+
+  // Last logged layout, the report is only repeated when it changes
+  long long logged_declared_bytes, logged_pool_bytes;
+  size_t logged_passes, logged_culled;
+};
+
+#endif // RENDER_GRAPH_H
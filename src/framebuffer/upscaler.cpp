@@ -0,0 +1,120 @@
+#include "upscaler.h"
+#include "util/data.h"
+
+#include <glad/glad.h>
+
+constexpr float DEFAULT_SHARPNESS = 0.2f;
+constexpr int SOURCE_UNIT = 0;
+
+Upscaler::Upscaler(int width, int height)
+  : width(width),
+    height(height),
+    sharpness(DEFAULT_SHARPNESS),
+    easu_shader(std::make_unique<Shader>("../../shaders/processing/fb.vert",
+                                         "../../shaders/processing/easu.frag")),
+    rcas_shader(std::make_unique<Shader>("../../shaders/processing/fb.vert",
+                                         "../../shaders/processing/rcas.frag"))
+{
+  glGenFramebuffers(1, &FBO);
+
+  rect.start_setup();
+  rect.add_vertices(QUAD_VERTICES, 6, sizeof (QUAD_VERTICES));
+  rect.add_vertex_attribs({ 2, 2 });
+  rect.finalize_setup();
+}
+
+Upscaler::~Upscaler()
+{
+  glDeleteFramebuffers(1, &FBO);
+}
+
+float Upscaler::get_scale(Preset preset)
+{
+  switch (preset) {
+    case Preset::NATIVE:
+      return 1.0f;
+    case Preset::ULTRA_QUALITY:
+      return 1.0f / 1.3f;
+    case Preset::QUALITY:
+      return 1.0f / 1.5f;
+    case Preset::BALANCED:
+      return 1.0f / 1.7f;
+    case Preset::PERFORMANCE:
+      return 1.0f / 2.0f;
+  }
+
+  return 1.0f;
+}
+
+const char* Upscaler::get_preset_name(Preset preset)
+{
+  switch (preset) {
+    case Preset::NATIVE:
+      return "Native";
+    case Preset::ULTRA_QUALITY:
+      return "Ultra Quality";
+    case Preset::QUALITY:
+      return "Quality";
+    case Preset::BALANCED:
+      return "Balanced";
+    case Preset::PERFORMANCE:
+      return "Performance";
+  }
+
+  return "";
+}
+
+void Upscaler::set_sharpness(float sharpness)
+{
+  this->sharpness = sharpness;
+}
+
+void Upscaler::bind_target(unsigned int texture) const
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+}
+
+void Upscaler::upscale(unsigned int source, int render_width, int render_height, bool encoded,
+                       unsigned int target) const
+{
+  bind_target(target);
+  glViewport(0, 0, width, height);
+  glDisable(GL_DEPTH_TEST);
+
+  easu_shader->use_shader_program();
+  glUniform1i(easu_shader->get_uniform_location("source"), SOURCE_UNIT);
+  glUniform2f(easu_shader->get_uniform_location("input_size"),
+              static_cast<float>(render_width), static_cast<float>(render_height));
+  glUniform2f(easu_shader->get_uniform_location("output_size"),
+              static_cast<float>(width), static_cast<float>(height));
+  glUniform1i(easu_shader->get_uniform_location("encoded"), encoded);
+
+  glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+  glBindTexture(GL_TEXTURE_2D, source);
+  rect.draw(*easu_shader);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Upscaler::sharpen(unsigned int source, bool encoded) const
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(0, 0, width, height);
+  glDisable(GL_DEPTH_TEST);
+
+  // Encoded values go to the framebuffer as they are
+  if (encoded) {
+    glDisable(GL_FRAMEBUFFER_SRGB);
+  }
+
+  rcas_shader->use_shader_program();
+  glUniform1i(rcas_shader->get_uniform_location("source"), SOURCE_UNIT);
+  glUniform1f(rcas_shader->get_uniform_location("sharpness"), sharpness);
+
+  glActiveTexture(GL_TEXTURE0 + SOURCE_UNIT);
+  glBindTexture(GL_TEXTURE_2D, source);
+  rect.draw(*rcas_shader);
+
+  glEnable(GL_FRAMEBUFFER_SRGB);
+}
@@ -0,0 +1,52 @@
+#ifndef UPSCALER_H
+#define UPSCALER_H
+
+#include "shader/shader.h"
+#include "model/object.h"
+
+#include <memory>
+
+// Spatial upscaler for frames rendered below the window's size, in the style of FSR1. An
+// edge adaptive upscale (easu.frag) brings the composed frame to the output size, then a
+// contrast adaptive sharpen (rcas.frag) restores the detail lost to the lower resolution.
+// Both run after tonemapping, on values that are at most 1.
+class Upscaler
+{
+public:
+  // Render scale of each preset, as in FSR1's quality modes
+  enum class Preset {
+    NATIVE,
+    ULTRA_QUALITY,
+    QUALITY,
+    BALANCED,
+    PERFORMANCE,
+  };
+
+  Upscaler(int width, int height);
+  ~Upscaler();
+
+  static float get_scale(Preset preset);
+  static const char* get_preset_name(Preset preset);
+
+  // In stops, 0 is the strongest
+  void set_sharpness(float sharpness);
+
+  // Binds a target of the output size for the composite to draw into at the render size
+  void bind_target(unsigned int texture) const;
+  // Encoded sources hold display values, like the compute tonemap's or a gamma corrected
+  // composite, otherwise they're linear and the sRGB framebuffer encodes the result
+  void upscale(unsigned int source, int render_width, int render_height, bool encoded,
+               unsigned int target) const;
+  // Sharpens into the default framebuffer
+  void sharpen(unsigned int source, bool encoded) const;
+
+private:
+  int width, height;
+  float sharpness;
+  unsigned int FBO;
+  std::unique_ptr<Shader> easu_shader;
+  std::unique_ptr<Shader> rcas_shader;
+  Object rect;
+};
+
+#endif // UPSCALER_H
@@ -0,0 +1,299 @@
+#include "visibility_buffer.h"
+#include "util/data.h"
+#include "util/exception.h"
+#include "util/profiling/profiling.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Matches the packing in the visibility shaders, the high bits hold the instance
+constexpr int TRIANGLE_BITS = 24;
+constexpr unsigned int MAX_INSTANCES = 1u << (32 - TRIANGLE_BITS);
+constexpr unsigned int EMPTY_ID = 0xFFFFFFFFu;
+constexpr int VISIBILITY_UNIT = 16;
+// Must match visibility_classify.comp and visibility_resolve.vert, a thread per pixel of a
+// tile and a thread per draw that may be in it
+constexpr int TILE_SIZE = 16;
+static_assert(TILE_SIZE * TILE_SIZE == MAX_INSTANCES, "A draw has at least one instance");
+constexpr int INSTANCE_DRAW_BINDING = 8;
+constexpr int DRAW_TILES_BINDING = 9;
+constexpr int TILE_BINDING = 10;
+// Quad per tile
+constexpr unsigned int TILE_VERTICES = 6;
+
+static int num_tiles(int size)
+{
+  return (size + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+VisibilityBuffer::VisibilityBuffer(int width, int height)
+  : width(width),
+    height(height),
+    render_width(width),
+    render_height(height),
+    attached_depth(0),
+    visibility_shader(std::make_unique<Shader>("../../shaders/processing/visibility.vert",
+                                               "../../shaders/processing/visibility.frag")),
+    classify_shader(std::make_unique<Shader>(
+      "../../shaders/processing/visibility_classify.comp")),
+    resolve_shader(std::make_unique<Shader>("../../shaders/processing/visibility_resolve.vert",
+                                            "../../shaders/processing/visibility_resolve.frag"))
+{
+  glGenTextures(1, &id_texture);
+  glBindTexture(GL_TEXTURE_2D, id_texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0,
+               GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glGenFramebuffers(1, &FBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, id_texture, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  glGenBuffers(1, &instance_SSBO);
+  glGenBuffers(1, &instance_draw_SSBO);
+  glGenBuffers(1, &draw_tiles_SSBO);
+  glGenBuffers(1, &tile_SSBO);
+
+  rect.start_setup();
+  rect.add_vertices(QUAD_VERTICES, 6, sizeof (QUAD_VERTICES));
+  rect.add_vertex_attribs({ 2, 2 });
+  rect.finalize_setup();
+}
+
+VisibilityBuffer::~VisibilityBuffer()
+{
+  glDeleteFramebuffers(1, &FBO);
+  glDeleteTextures(1, &id_texture);
+  glDeleteBuffers(1, &instance_SSBO);
+  glDeleteBuffers(1, &instance_draw_SSBO);
+  glDeleteBuffers(1, &draw_tiles_SSBO);
+  glDeleteBuffers(1, &tile_SSBO);
+}
+
+void VisibilityBuffer::set_render_size(int width, int height)
+{
+  render_width = width;
+  render_height = height;
+}
+
+void VisibilityBuffer::begin_frame()
+{
+  draws.clear();
+  instance_models.clear();
+  instance_draws.clear();
+}
+
+void VisibilityBuffer::add_draw(const Object& object, const Textures& textures,
+                                const std::vector<Object::Transform>& transforms,
+                                const AABB& bounds,
+                                std::initializer_list<std::string_view> flags)
+{
+  if (transforms.empty()) {
+    return;
+  }
+
+  if (instance_models.size() + transforms.size() > MAX_INSTANCES) {
+    throw FrameBufferException("Too many visibility buffer instances");
+  }
+
+  Draw draw { &object, &textures, transforms, static_cast<unsigned int>(instance_models.size()),
+              bounds, {} };
+
+  for (const auto& flag : flags) {
+    draw.flags.emplace_back(flag);
+  }
+
+  for (const auto& transform : transforms) {
+    instance_models.emplace_back(Object::get_model_matrix(transform));
+    instance_draws.emplace_back(static_cast<unsigned int>(draws.size()));
+  }
+
+  draws.emplace_back(std::move(draw));
+}
+
+void VisibilityBuffer::render(const GBuffer& gbuffer, const mat4& view_projection)
+{
+  PROFILE_GPU_SCOPE("VisibilityBuffer")
+
+  // The depth written here is the one the lighting reads, so it's shared with the G-buffer
+  if (attached_depth != gbuffer.get_depth_texture()) {
+    attached_depth = gbuffer.get_depth_texture();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, attached_depth, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      throw FrameBufferException("Visibility buffer not complete");
+    }
+  }
+
+  PROFILE_SECTION_START("Visibility Pass")
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_SSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<long>(instance_models.size() * sizeof (mat4)),
+               instance_models.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, instance_SSBO);
+
+  render_visibility();
+  PROFILE_SECTION_END()
+
+  PROFILE_SECTION_START("Classify")
+  classify(view_projection);
+  PROFILE_SECTION_END()
+
+  PROFILE_SECTION_START("Resolve")
+  resolve(gbuffer);
+  PROFILE_SECTION_END()
+}
+
+void VisibilityBuffer::render_visibility() const
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  glClearBufferuiv(GL_COLOR, 0, &EMPTY_ID);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  glEnable(GL_DEPTH_TEST);
+
+  visibility_shader->use_shader_program();
+  const int first_instance_location = visibility_shader->get_uniform_location("first_instance");
+
+  for (const auto& draw : draws) {
+    Object::set_model_transforms(draw.transforms);
+    glUniform1ui(first_instance_location, draw.first_instance);
+    draw.object->draw_instanced(*visibility_shader, static_cast<int>(draw.transforms.size()));
+  }
+}
+
+void VisibilityBuffer::classify(const mat4& view_projection)
+{
+  // A draw's tiles are within the tiles its bounds cover on the screen, which sets how many
+  // the classify pass may append to its list
+  draw_tiles.clear();
+  unsigned int total_tiles = 0;
+
+  for (const auto& draw : draws) {
+    const auto [x, y, rect_width, rect_height] = screen_rect(draw.bounds, view_projection);
+    unsigned int max_tiles = 0;
+
+    if (rect_width > 0 && rect_height > 0) {
+      max_tiles = static_cast<unsigned int>(
+        (num_tiles(x + rect_width) - x / TILE_SIZE) * (num_tiles(y + rect_height) - y / TILE_SIZE));
+    }
+
+    draw_tiles.push_back({ TILE_VERTICES, 0, 0, 0, total_tiles, max_tiles, { 0, 0 } });
+    total_tiles += max_tiles;
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_draw_SSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               static_cast<long>(instance_draws.size() * sizeof (unsigned int)),
+               instance_draws.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_tiles_SSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<long>(draw_tiles.size() * sizeof (DrawTiles)),
+               draw_tiles.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, tile_SSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               static_cast<long>(std::max(total_tiles, 1u) * sizeof (unsigned int)), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_DRAW_BINDING, instance_draw_SSBO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_TILES_BINDING, draw_tiles_SSBO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_BINDING, tile_SSBO);
+
+  classify_shader->use_shader_program();
+  glActiveTexture(GL_TEXTURE0 + VISIBILITY_UNIT);
+  glBindTexture(GL_TEXTURE_2D, id_texture);
+  glUniform1i(classify_shader->get_uniform_location("visibility_ids"), VISIBILITY_UNIT);
+
+  glDispatchCompute(static_cast<unsigned int>(num_tiles(render_width)),
+                    static_cast<unsigned int>(num_tiles(render_height)), 1);
+  // The resolve draws read the counts as commands and the tiles as storage
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void VisibilityBuffer::resolve(const GBuffer& gbuffer) const
+{
+  gbuffer.bind_color_targets();
+  glDisable(GL_DEPTH_TEST);
+
+  resolve_shader->use_shader_program();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw_tiles_SSBO);
+
+  for (size_t i = 0; i < draws.size(); i++) {
+    const Draw& draw = draws[i];
+
+    if (draw_tiles[i].max_tiles == 0) {
+      continue;
+    }
+
+    // Material textures take the first units
+    draw.textures->use_textures(*resolve_shader);
+    glActiveTexture(GL_TEXTURE0 + VISIBILITY_UNIT);
+    glBindTexture(GL_TEXTURE_2D, id_texture);
+    glUniform1i(resolve_shader->get_uniform_location("visibility_ids"), VISIBILITY_UNIT);
+
+    const unsigned int index_buffer = draw.object->get_index_buffer();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, draw.object->get_vertex_buffer());
+    if (index_buffer != 0) {
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, index_buffer);
+    }
+
+    glUniform1i(resolve_shader->get_uniform_location("indexed"), index_buffer != 0);
+    glUniform1ui(resolve_shader->get_uniform_location("draw"), static_cast<unsigned int>(i));
+    glUniform1ui(resolve_shader->get_uniform_location("first_instance"), draw.first_instance);
+    glUniform1ui(resolve_shader->get_uniform_location("num_instances"),
+                 static_cast<unsigned int>(draw.transforms.size()));
+
+    for (const auto& flag : draw.flags) {
+      glUniform1i(resolve_shader->get_uniform_location(flag), 1);
+    }
+
+    // As many quads as the classify pass found tiles holding the draw
+    rect.draw_indirect(*resolve_shader, i * sizeof (DrawTiles));
+
+    for (const auto& flag : draw.flags) {
+      glUniform1i(resolve_shader->get_uniform_location(flag), 0);
+    }
+  }
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+std::array<int, 4> VisibilityBuffer::screen_rect(const AABB& bounds,
+                                                 const mat4& view_projection) const
+{
+  if (bounds.empty()) {
+    return { 0, 0, 0, 0 };
+  }
+
+  vec2 min(1.0f);
+  vec2 max(-1.0f);
+
+  for (int i = 0; i < 8; i++) {
+    const vec4 clip = view_projection * vec4(bounds.corner(i), 1.0f);
+
+    // Boxes crossing the camera plane can cover any part of the screen
+    if (clip.w <= 0.0f) {
+      return { 0, 0, render_width, render_height };
+    }
+
+    min = glm::min(min, vec2(clip) / clip.w);
+    max = glm::max(max, vec2(clip) / clip.w);
+  }
+
+  min = glm::clamp(min * 0.5f + 0.5f, vec2(0.0f), vec2(1.0f));
+  max = glm::clamp(max * 0.5f + 0.5f, vec2(0.0f), vec2(1.0f));
+
+  const int x0 = static_cast<int>(std::floor(min.x * static_cast<float>(render_width)));
+  const int y0 = static_cast<int>(std::floor(min.y * static_cast<float>(render_height)));
+  const int x1 = static_cast<int>(std::ceil(max.x * static_cast<float>(render_width)));
+  const int y1 = static_cast<int>(std::ceil(max.y * static_cast<float>(render_height)));
+
+  return { x0, y0, x1 - x0, y1 - y0 };
+}
@@ -0,0 +1,78 @@
+#ifndef VISIBILITY_BUFFER_H
+#define VISIBILITY_BUFFER_H
+
+#include "framebuffer/gbuffer.h"
+#include "model/object.h"
+#include "culling/bounds.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef glm::vec2 vec2;
+typedef glm::mat4 mat4;
+
+// Visibility buffer alternative to the geometry pass. Draws only write depth and a packed
+// instance and triangle ID, then a compute pass bins the screen's tiles by the draws whose
+// pixels they hold. Each draw's resolve covers only its tiles, fetching the triangle's
+// vertices from the mesh buffers, interpolating them at the pixel and writing the compact
+// G-buffer targets, so material work is done about once per pixel whatever the overdraw.
+class VisibilityBuffer
+{
+public:
+  VisibilityBuffer(int width, int height);
+  ~VisibilityBuffer();
+
+  // Part of the targets rendered to, only its tiles are binned
+  void set_render_size(int width, int height);
+  void begin_frame();
+  // Bounds of all instances in world space limit the pixels the draw's resolve touches
+  void add_draw(const Object& object, const Textures& textures,
+                const std::vector<Object::Transform>& transforms, const AABB& bounds,
+                std::initializer_list<std::string_view> flags = {});
+  void render(const GBuffer& gbuffer, const mat4& view_projection);
+
+private:
+  struct Draw {
+    const Object* object;
+    const Textures* textures;
+    std::vector<Object::Transform> transforms;
+    unsigned int first_instance;
+    AABB bounds;
+    std::vector<std::string> flags;
+  };
+
+  // Matches DrawTiles in the classify and resolve shaders. Starts with the indirect command
+  // of the draw's resolve, which draws a quad per tile the classify pass appends.
+  struct DrawTiles {
+    unsigned int count, instance_count, first, base_instance;
+    unsigned int first_tile, max_tiles;
+    unsigned int padding[2];
+  };
+
+  void render_visibility() const;
+  void classify(const mat4& view_projection);
+  void resolve(const GBuffer& gbuffer) const;
+  std::array<int, 4> screen_rect(const AABB& bounds, const mat4& view_projection) const;
+
+  int width, height;
+  int render_width, render_height;
+  unsigned int FBO, id_texture, instance_SSBO;
+  unsigned int instance_draw_SSBO, draw_tiles_SSBO, tile_SSBO;
+  unsigned int attached_depth;
+  std::unique_ptr<Shader> visibility_shader;
+  std::unique_ptr<Shader> classify_shader;
+  std::unique_ptr<Shader> resolve_shader;
+  Object rect;
+
+  std::vector<Draw> draws;
+  std::vector<mat4> instance_models;
+  // Index of the draw of each instance, for the classify pass
+  std::vector<unsigned int> instance_draws;
+  std::vector<DrawTiles> draw_tiles;
+};
+
+#endif // VISIBILITY_BUFFER_H
@@ -1,10 +1,15 @@
 #include "display/window.h"
+#include "util/profiling/profiling.h"
 
+#include <cstring>
 #include <iostream>
 
-int main() {
+int main(int argc, char** argv) {
+  PROFILE_THREAD_NAME("Main")
+
   try {
-    Window window;
+    const bool light_sweep = argc > 1 && std::strcmp(argv[1], "--light-sweep") == 0;
+    Window window(light_sweep);
     window.main_loop();
   } catch (const std::runtime_error& e) {
     std::cerr << e.what() << std::endl;
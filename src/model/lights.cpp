@@ -1,10 +1,26 @@
 #include "lights.h"
 #include "util/data.h"
+#include "util/exception.h"
+#include "util/profiling/profiling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+// Intensity under which a light is considered to have no effect
+constexpr float MIN_INTENSITY = 5.0f / 256.0f;
+// The faces of the tessellated sphere lie inside the sphere through its vertices
+constexpr float LIGHT_VOLUME_MARGIN = 1.1f;
 
 Lights::Lights(std::shared_ptr<Camera> camera)
   : camera(camera),
-    model_light("../../assets/sphere.obj")
+    model_light("../../assets/sphere.obj"),
+    counts_dirty(true)
 {
+  const vec3 extents = model_light.get_bounds().extents();
+  model_light_radius = std::max({ extents.x, extents.y, extents.z });
+
   glGenBuffers(1, &UBO);
   glGenBuffers(1, &dir_SSBO);
   glGenBuffers(1, &point_SSBO);
@@ -27,78 +43,161 @@ Lights::~Lights()
 
 void Lights::add_dir_light(Lights::DirLight&& light)
 {
-  dir_lights.emplace_back(std::move(light));
+  add_dir_lights({ std::move(light) });
+}
 
-  const size_t num_light = dir_lights.size();
+void Lights::add_point_light(Lights::PointLight&& light)
+{
+  add_point_lights({ std::move(light) });
+}
 
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, dir_SSBO);
-  glBufferData(GL_SHADER_STORAGE_BUFFER,
-               static_cast<long>(num_light * DIR_NUM_ELEMS * sizeof (vec4)),
-               nullptr, GL_STATIC_DRAW);
+void Lights::add_dir_lights(std::vector<DirLight>&& lights)
+{
+  const size_t first = dir_lights.size();
+  dir_lights.insert(dir_lights.end(),
+                    std::make_move_iterator(lights.begin()),
+                    std::make_move_iterator(lights.end()));
+  packed_dir_lights.data.resize(dir_lights.size() * DIR_NUM_ELEMS);
 
-  for (size_t i = 0; i < num_light; i++) {
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((0 + i * POINT_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &dir_lights[i].direction[0]);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((1 + i * DIR_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &dir_lights[i].ambient[0]);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((2 + i * DIR_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &dir_lights[i].diffuse[0]);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((3 + i * DIR_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &dir_lights[i].specular[0]);
+  for (size_t i = first; i < dir_lights.size(); i++) {
+    pack(dir_lights[i], &packed_dir_lights.data[i * DIR_NUM_ELEMS]);
   }
 
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  packed_dir_lights.mark_dirty(first * DIR_NUM_ELEMS, dir_lights.size() * DIR_NUM_ELEMS);
+  counts_dirty = true;
+}
 
-  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
-  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (vec3), sizeof (int), &num_light);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+void Lights::add_point_lights(std::vector<PointLight>&& lights)
+{
+  const size_t first = point_lights.size();
+  point_lights.insert(point_lights.end(),
+                      std::make_move_iterator(lights.begin()),
+                      std::make_move_iterator(lights.end()));
+  packed_point_lights.data.resize(point_lights.size() * POINT_NUM_ELEMS);
+  point_light_transforms.resize(point_lights.size());
+  light_volume_transforms.resize(point_lights.size());
+
+  for (size_t i = first; i < point_lights.size(); i++) {
+    pack(point_lights[i], &packed_point_lights.data[i * POINT_NUM_ELEMS]);
+    set_point_light_transforms(i);
+  }
+
+  packed_point_lights.mark_dirty(first * POINT_NUM_ELEMS, point_lights.size() * POINT_NUM_ELEMS);
+  counts_dirty = true;
 }
 
-void Lights::add_point_light(Lights::PointLight&& light)
+void Lights::remove_dir_lights(std::vector<size_t> indices)
 {
-  point_light_transforms.push_back({vec3(0.05f), {}, light.position});
-  point_lights.emplace_back(std::move(light));
+  std::sort(indices.begin(), indices.end(), std::greater<size_t>());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
 
-  const size_t num_light = point_lights.size();
+  if (indices.empty()) {
+    return;
+  }
 
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, point_SSBO);
-  glBufferData(GL_SHADER_STORAGE_BUFFER,
-               static_cast<long>(num_light * POINT_NUM_ELEMS * sizeof (vec4)),
-               nullptr, GL_STATIC_DRAW);
+  if (indices.front() >= dir_lights.size()) {
+    throw LightsException("Directional light out of range: " + std::to_string(indices.front()));
+  }
 
-  for (size_t i = 0; i < num_light; i++) {
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((0 + i * POINT_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &point_lights[i].position[0]);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((1 + i * POINT_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &point_lights[i].ambient[0]);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((2 + i * POINT_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &point_lights[i].diffuse[0]);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((3 + i * POINT_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &point_lights[i].specular[0]);
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
-                    static_cast<long>((4 + i * POINT_NUM_ELEMS) * sizeof (vec4)),
-                    sizeof (vec3), &point_lights[i].attenuation[0]);
+  for (size_t index : indices) {
+    dir_lights[index] = dir_lights.back();
+    dir_lights.pop_back();
   }
 
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  packed_dir_lights.data.resize(dir_lights.size() * DIR_NUM_ELEMS);
 
-  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
-  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (vec4), sizeof (int), &num_light);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  for (size_t i = indices.back(); i < dir_lights.size(); i++) {
+    pack(dir_lights[i], &packed_dir_lights.data[i * DIR_NUM_ELEMS]);
+  }
+
+  packed_dir_lights.mark_dirty(indices.back() * DIR_NUM_ELEMS, dir_lights.size() * DIR_NUM_ELEMS);
+  counts_dirty = true;
+}
+
+void Lights::remove_point_lights(std::vector<size_t> indices)
+{
+  std::sort(indices.begin(), indices.end(), std::greater<size_t>());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+  if (indices.empty()) {
+    return;
+  }
+
+  if (indices.front() >= point_lights.size()) {
+    throw LightsException("Point light out of range: " + std::to_string(indices.front()));
+  }
+
+  for (size_t index : indices) {
+    point_lights[index] = point_lights.back();
+    point_lights.pop_back();
+  }
+
+  packed_point_lights.data.resize(point_lights.size() * POINT_NUM_ELEMS);
+  point_light_transforms.resize(point_lights.size());
+  light_volume_transforms.resize(point_lights.size());
+
+  for (size_t i = indices.back(); i < point_lights.size(); i++) {
+    pack(point_lights[i], &packed_point_lights.data[i * POINT_NUM_ELEMS]);
+    set_point_light_transforms(i);
+  }
+
+  packed_point_lights.mark_dirty(indices.back() * POINT_NUM_ELEMS,
+                                 point_lights.size() * POINT_NUM_ELEMS);
+  counts_dirty = true;
+}
+
+void Lights::update_dir_lights(size_t first, const std::vector<DirLight>& lights)
+{
+  if (first + lights.size() > dir_lights.size()) {
+    throw LightsException("Directional lights out of range: " + std::to_string(first) + "-" +
+                          std::to_string(first + lights.size()));
+  }
+
+  for (size_t i = 0; i < lights.size(); i++) {
+    dir_lights[first + i] = lights[i];
+    pack(lights[i], &packed_dir_lights.data[(first + i) * DIR_NUM_ELEMS]);
+  }
+
+  packed_dir_lights.mark_dirty(first * DIR_NUM_ELEMS, (first + lights.size()) * DIR_NUM_ELEMS);
 }
 
-void Lights::update() const
+void Lights::update_point_lights(size_t first, const std::vector<PointLight>& lights)
 {
+  if (first + lights.size() > point_lights.size()) {
+    throw LightsException("Point lights out of range: " + std::to_string(first) + "-" +
+                          std::to_string(first + lights.size()));
+  }
+
+  for (size_t i = 0; i < lights.size(); i++) {
+    point_lights[first + i] = lights[i];
+    pack(lights[i], &packed_point_lights.data[(first + i) * POINT_NUM_ELEMS]);
+    set_point_light_transforms(first + i);
+  }
+
+  packed_point_lights.mark_dirty(first * POINT_NUM_ELEMS,
+                                 (first + lights.size()) * POINT_NUM_ELEMS);
+}
+
+void Lights::update()
+{
+  PROFILE_SCOPE("Lights")
+
+  PROFILE_SECTION_START("Upload Lights")
+  upload(dir_SSBO, packed_dir_lights);
+  upload(point_SSBO, packed_point_lights);
+  PROFILE_SECTION_END()
+
   glBindBuffer(GL_UNIFORM_BUFFER, UBO);
   glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof (vec3), &camera->get_position()[0]);
+
+  if (counts_dirty) {
+    const int num_dir_lights = static_cast<int>(dir_lights.size());
+    const int num_point_lights = static_cast<int>(point_lights.size());
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof (vec3), sizeof (int), &num_dir_lights);
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof (vec4), sizeof (int), &num_point_lights);
+    counts_dirty = false;
+  }
+
   glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
@@ -108,3 +207,113 @@ void Lights::draw(const Shader& shader) const
 
   model_light.draw_instanced(shader, static_cast<int>(point_lights.size()));
 }
+
+void Lights::draw_volumes(const Shader& shader, const Textures& textures) const
+{
+  Object::set_model_transforms(light_volume_transforms);
+
+  shader.use_shader_program();
+  textures.use_textures(shader);
+  model_light.draw_instanced(shader, static_cast<int>(point_lights.size()));
+}
+
+const std::vector<Lights::PointLight>& Lights::get_point_lights() const
+{
+  return point_lights;
+}
+
+float Lights::get_radius(const PointLight& light)
+{
+  const float max_intensity = std::max({ light.diffuse.x, light.diffuse.y, light.diffuse.z,
+                                         light.specular.x, light.specular.y, light.specular.z });
+  const float constant = light.attenuation.x;
+  const float linear = light.attenuation.y;
+  const float quadratic = light.attenuation.z;
+  const float cutoff = max_intensity / MIN_INTENSITY;
+
+  if (constant >= cutoff) {
+    return 0.0f;
+  }
+
+  if (quadratic > 0.0f) {
+    return (-linear + std::sqrt(linear * linear - 4.0f * quadratic * (constant - cutoff))) /
+           (2.0f * quadratic);
+  }
+
+  if (linear > 0.0f) {
+    return (cutoff - constant) / linear;
+  }
+
+  return std::numeric_limits<float>::max();
+}
+
+void Lights::PackedLights::mark_dirty(size_t begin, size_t end)
+{
+  if (begin >= end) {
+    return;
+  }
+
+  if (dirty_begin >= dirty_end) {
+    dirty_begin = begin;
+    dirty_end = end;
+  } else {
+    dirty_begin = std::min(dirty_begin, begin);
+    dirty_end = std::max(dirty_end, end);
+  }
+}
+
+void Lights::pack(const DirLight& light, vec4* data)
+{
+  data[0] = vec4(light.direction, 0.0f);
+  data[1] = vec4(light.ambient, 0.0f);
+  data[2] = vec4(light.diffuse, 0.0f);
+  data[3] = vec4(light.specular, 0.0f);
+}
+
+void Lights::pack(const PointLight& light, vec4* data)
+{
+  data[0] = vec4(light.position, 0.0f);
+  data[1] = vec4(light.ambient, 0.0f);
+  data[2] = vec4(light.diffuse, 0.0f);
+  data[3] = vec4(light.specular, 0.0f);
+  data[4] = vec4(light.attenuation, 0.0f);
+}
+
+void Lights::set_point_light_transforms(size_t index)
+{
+  const PointLight& light = point_lights[index];
+  point_light_transforms[index] = { vec3(0.05f), {}, light.position };
+  light_volume_transforms[index] = {
+    vec3(get_radius(light) * LIGHT_VOLUME_MARGIN / model_light_radius), {}, light.position
+  };
+}
+
+void Lights::upload(unsigned int SSBO, PackedLights& packed) const
+{
+  const size_t size = packed.data.size();
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+
+  // Growing reallocates the buffer, so everything has to be uploaded again
+  if (size > packed.capacity) {
+    packed.capacity = std::max(size, 2 * packed.capacity);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<long>(packed.capacity * sizeof (vec4)),
+                 nullptr, GL_DYNAMIC_DRAW);
+    packed.dirty_begin = 0;
+    packed.dirty_end = size;
+  }
+
+  packed.dirty_end = std::min(packed.dirty_end, size);
+
+  if (packed.dirty_begin < packed.dirty_end) {
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+                    static_cast<long>(packed.dirty_begin * sizeof (vec4)),
+                    static_cast<long>((packed.dirty_end - packed.dirty_begin) * sizeof (vec4)),
+                    &packed.data[packed.dirty_begin]);
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  packed.dirty_begin = 0;
+  packed.dirty_end = 0;
+}
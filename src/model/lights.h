@@ -14,7 +14,6 @@ typedef glm::vec3 vec3;
 typedef glm::vec4 vec4;
 typedef glm::mat4 mat4;
 
-constexpr int NUM_LIGHTS = 5;
 constexpr int DIR_NUM_ELEMS = 4;
 constexpr int POINT_NUM_ELEMS = 5;
 
@@ -42,16 +41,50 @@ public:
   void add_dir_light(DirLight&& light);
   void add_point_light(PointLight&& light);
 
-  void update() const;
+  // Batch edits only touch the CPU side copy, the changed range of the light buffers is
+  // uploaded once by the next update. Removing lights moves the last lights into the
+  // freed slots, so the indices of the remaining lights can change.
+  void add_dir_lights(std::vector<DirLight>&& lights);
+  void add_point_lights(std::vector<PointLight>&& lights);
+  void remove_dir_lights(std::vector<size_t> indices);
+  void remove_point_lights(std::vector<size_t> indices);
+  void update_dir_lights(size_t first, const std::vector<DirLight>& lights);
+  void update_point_lights(size_t first, const std::vector<PointLight>& lights);
+
+  void update();
   void draw(const Shader& shader) const;
+  void draw_volumes(const Shader& shader, const Textures& textures) const;
+
+  const std::vector<PointLight>& get_point_lights() const;
+  static float get_radius(const PointLight& light);
 
 private:
+  // Lights as laid out in the std430 light buffers, every vec3 is padded to a vec4
+  struct PackedLights {
+    std::vector<vec4> data;
+    size_t capacity = 0;
+    size_t dirty_begin = 0;
+    size_t dirty_end = 0;
+
+    void mark_dirty(size_t begin, size_t end);
+  };
+
+  static void pack(const DirLight& light, vec4* data);
+  static void pack(const PointLight& light, vec4* data);
+  void set_point_light_transforms(size_t index);
+  void upload(unsigned int SSBO, PackedLights& packed) const;
+
   unsigned int UBO, dir_SSBO, point_SSBO;
   std::shared_ptr<Camera> camera;
   Model model_light;
   std::vector<PointLight> point_lights;
   std::vector<DirLight> dir_lights;
+  PackedLights packed_dir_lights;
+  PackedLights packed_point_lights;
+  bool counts_dirty;
   std::vector<Object::Transform> point_light_transforms;
+  std::vector<Object::Transform> light_volume_transforms;
+  float model_light_radius;
 };
 
 #endif // LIGHTS_H
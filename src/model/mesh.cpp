@@ -13,11 +13,23 @@ Mesh::Mesh(std::vector<Vertex>&& vertices,
                    indices.size() * sizeof(unsigned int));
   mesh.add_vertex_attribs({ 3, 3, 2, 3, 3 });
   mesh.finalize_setup();
+
+  positions.reserve(vertices.size());
+
+  for (const auto& vertex : vertices) {
+    bounds.extend(vertex.position);
+    positions.emplace_back(vertex.position);
+  }
+
+  this->indices = std::move(indices);
 }
 
 Mesh::Mesh(Mesh&& other) noexcept
   : textures(std::move(other.textures)),
-    mesh(std::move(other.mesh))
+    mesh(std::move(other.mesh)),
+    bounds(other.bounds),
+    positions(std::move(other.positions)),
+    indices(std::move(other.indices))
 {
 }
 
@@ -31,3 +43,28 @@ void Mesh::draw_instanced(const Shader& shader, int num_times,
 {
   mesh.draw_instanced(shader, num_times, textures, flags);
 }
+
+const AABB& Mesh::get_bounds() const
+{
+  return bounds;
+}
+
+const std::vector<vec3>& Mesh::get_positions() const
+{
+  return positions;
+}
+
+const std::vector<unsigned int>& Mesh::get_indices() const
+{
+  return indices;
+}
+
+const Object& Mesh::get_object() const
+{
+  return mesh;
+}
+
+const Textures& Mesh::get_textures() const
+{
+  return textures;
+}
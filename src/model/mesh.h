@@ -9,6 +9,7 @@
 #include "shader/shader.h"
 #include "shader/textures.h"
 #include "model/object.h"
+#include "culling/bounds.h"
 
 typedef glm::vec3 vec3;
 typedef glm::vec2 vec2;
@@ -30,10 +31,19 @@ public:
   void draw(const Shader& shader, std::initializer_list<std::string_view> flags = {}) const;
   void draw_instanced(const Shader& shader, int num_times,
                       std::initializer_list<std::string_view> flags = {}) const;
+  const AABB& get_bounds() const;
+  const std::vector<vec3>& get_positions() const;
+  const std::vector<unsigned int>& get_indices() const;
+  const Object& get_object() const;
+  const Textures& get_textures() const;
 
 private:
   Textures textures;
   Object mesh;
+  AABB bounds;
+  // Kept on the CPU for culling shadow caster triangles
+  std::vector<vec3> positions;
+  std::vector<unsigned int> indices;
 };
 
 static_assert (std::is_nothrow_move_constructible<Mesh>::value, "Mesh not move constructible");
@@ -24,6 +24,17 @@ void Model::draw_instanced(const Shader& shader, int num_times,
   glDisable(GL_CULL_FACE);
 }
 
+AABB Model::get_bounds() const
+{
+  AABB bounds;
+
+  for (const Mesh& mesh : meshes) {
+    bounds.extend(mesh.get_bounds());
+  }
+
+  return bounds;
+}
+
 void Model::load_model(std::string_view path)
 {
   Assimp::Importer importer;
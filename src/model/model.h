@@ -17,6 +17,7 @@ public:
   void draw(const Shader& shader, std::initializer_list<std::string_view> flags = {}) const;
   void draw_instanced(const Shader& shader, int num_times,
                       std::initializer_list<std::string_view> flags = {}) const;
+  AABB get_bounds() const;
 
   std::vector<Mesh> meshes;
 
@@ -10,7 +10,7 @@ Object::Object() : EBO(0), num_vertices(0), num_indices(0)
   if (UBO == 0) {
     glGenBuffers(1, &UBO);
     glBindBuffer(GL_UNIFORM_BUFFER, UBO);
-    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(mat4), nullptr, GL_DYNAMIC_DRAW);
+    glBufferData(GL_UNIFORM_BUFFER, 5 * sizeof(mat4), nullptr, GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, UBO);
   }
   if (SSBO == 0) {
@@ -81,25 +81,32 @@ void Object::finalize_setup()
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+mat4 Object::get_model_matrix(const Transform& transform)
+{
+  const auto& [scale, rotate, translate] = transform;
+
+  mat4 model(1.0f);
+  if (translate.has_value()) {
+    model *= glm::translate(translate.value());
+  }
+  if (rotate.has_value()) {
+    auto [angle, axis] = rotate.value();
+    model *= glm::rotate(angle, axis);
+  }
+  if (scale.has_value()) {
+    model *= glm::scale(scale.value());
+  }
+
+  return model;
+}
+
 void Object::set_model_transforms(const std::vector<Transform>& transforms)
 {
   std::vector<mat4> model_matrices;
   model_matrices.reserve(transforms.size());
 
-  for (const auto& [scale, rotate, translate] : transforms) {
-    mat4 model(1.0f);
-    if (translate.has_value()) {
-      model *= glm::translate(translate.value());
-    }
-    if (rotate.has_value()) {
-      auto [angle, axis] = rotate.value();
-      model *= glm::rotate(angle, axis);
-    }
-    if (scale.has_value()) {
-      model *= glm::scale(scale.value());
-    }
-
-    model_matrices.emplace_back(std::move(model));
+  for (const auto& transform : transforms) {
+    model_matrices.emplace_back(get_model_matrix(transform));
   }
 
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
@@ -113,6 +120,20 @@ void Object::set_world_space_transform(mat4 perspective, mat4 view)
   glBindBuffer(GL_UNIFORM_BUFFER, UBO);
   glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof (mat4), &perspective[0][0]);
   glBufferSubData(GL_UNIFORM_BUFFER, sizeof (mat4), sizeof (mat4), &view[0][0]);
+
+  // Lets the lighting shaders rebuild world positions from depth
+  const mat4 inverse_view_projection = glm::inverse(perspective * view);
+  glBufferSubData(GL_UNIFORM_BUFFER, 2 * sizeof (mat4), sizeof (mat4),
+                  &inverse_view_projection[0][0]);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Object::set_motion_transforms(mat4 view_projection, mat4 previous_view_projection)
+{
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 3 * sizeof (mat4), sizeof (mat4), &view_projection[0][0]);
+  glBufferSubData(GL_UNIFORM_BUFFER, 4 * sizeof (mat4), sizeof (mat4),
+                  &previous_view_projection[0][0]);
   glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
@@ -159,3 +180,22 @@ void Object::draw_instanced(const Shader& shader, int num_times,
     glUniform1i(shader.get_uniform_location(flag), 0);
   }
 }
+
+void Object::draw_indirect(const Shader& shader, size_t command_offset) const
+{
+  shader.use_shader_program();
+
+  glBindVertexArray(VAO);
+  glDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<void*>(command_offset));
+  glBindVertexArray(0);
+}
+
+unsigned int Object::get_vertex_buffer() const
+{
+  return VBO;
+}
+
+unsigned int Object::get_index_buffer() const
+{
+  return EBO;
+}
@@ -32,8 +32,11 @@ public:
   void add_vertex_attribs(std::initializer_list<int> vertex_attrib_sizes);
   void finalize_setup();
 
+  static mat4 get_model_matrix(const Transform& transform);
   static void set_model_transforms(const std::vector<Transform>& transforms);
   static void set_world_space_transform(mat4 perspective, mat4 view);
+  // Unjittered view projections of this frame and the last, for motion vectors
+  static void set_motion_transforms(mat4 view_projection, mat4 previous_view_projection);
 
   void draw(const Shader& shader, const Textures& textures,
             std::initializer_list<std::string_view> flags = {}) const;
@@ -43,6 +46,12 @@ public:
                       std::initializer_list<std::string_view> flags = {}) const;
   void draw_instanced(const Shader& shader, int num_times,
                       std::initializer_list<std::string_view> flags = {}) const;
+  // Draws with the command at the offset into the bound GL_DRAW_INDIRECT_BUFFER, so the GPU
+  // can decide how many times, for objects without indices
+  void draw_indirect(const Shader& shader, size_t command_offset) const;
+
+  unsigned int get_vertex_buffer() const;
+  unsigned int get_index_buffer() const;
 
 private:
   unsigned int VAO, VBO, EBO;
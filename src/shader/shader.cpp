@@ -7,9 +7,9 @@
 #include <glad/glad.h>
 
 Shader::Shader(const char* path_vertex, const char* path_fragment,
-               std::optional<const char*> path_geometry) {
-  std::string vertex_source = read_source(path_vertex);
-  std::string fragment_source = read_source(path_fragment);
+               std::optional<const char*> path_geometry, const std::string& defines) {
+  std::string vertex_source = read_source(path_vertex, defines);
+  std::string fragment_source = read_source(path_fragment, defines);
   const char* vertex_source_cstr = vertex_source.c_str();
   const char* fragment_source_cstr = fragment_source.c_str();
 
@@ -32,7 +32,7 @@ Shader::Shader(const char* path_vertex, const char* path_fragment,
   shader_program = glCreateProgram();
 
   if (path_geometry.has_value()) {
-    std::string geometry_source = read_source(path_geometry.value());
+    std::string geometry_source = read_source(path_geometry.value(), defines);
     const char* geometry_source_cstr = geometry_source.c_str();
 
     geometry_shader = glCreateShader(GL_GEOMETRY_SHADER);
@@ -56,10 +56,32 @@ Shader::Shader(const char* path_vertex, const char* path_fragment,
   }
 }
 
+Shader::Shader(const char* path_compute, const std::string& defines) {
+  std::string compute_source = read_source(path_compute, defines);
+  const char* compute_source_cstr = compute_source.c_str();
+
+  compute_shader = glCreateShader(GL_COMPUTE_SHADER);
+  glShaderSource(compute_shader, 1, &compute_source_cstr, nullptr);
+  glCompileShader(compute_shader);
+
+  if (!check_shader_errors(compute_shader)) {
+    throw ShaderException("Failed to compile " + std::string(path_compute) + ", check above log");
+  }
+
+  shader_program = glCreateProgram();
+  glAttachShader(shader_program, compute_shader);
+  glLinkProgram(shader_program);
+
+  if (!check_program_errors(shader_program)) {
+    throw ShaderException("Failed to link compute shader, check above log");
+  }
+}
+
 Shader::~Shader() {
   glDeleteShader(vertex_shader);
   glDeleteShader(fragment_shader);
   glDeleteShader(geometry_shader);
+  glDeleteShader(compute_shader);
   glDeleteProgram(shader_program);
 }
 
@@ -71,7 +93,7 @@ int Shader::get_uniform_location(std::string_view uniform) const {
   return glGetUniformLocation(shader_program, uniform.data());
 }
 
-std::string Shader::read_source(const char* path) {
+std::string Shader::read_source(const char* path, const std::string& defines) {
   std::ifstream file(path);
   std::string source;
 
@@ -80,9 +102,17 @@ std::string Shader::read_source(const char* path) {
   }
 
   std::string line;
+  bool version_line = true;
+
   while (std::getline(file, line)) {
     source.append(std::move(line));
     source.append("\n");
+
+    // Nothing but comments and whitespace can come before #version
+    if (version_line) {
+      source.append(defines);
+      version_line = false;
+    }
   }
 
   return source;
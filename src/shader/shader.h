@@ -2,24 +2,32 @@
 #define SHADER_H
 
 #include <optional>
+#include <string>
 
 class Shader {
 public:
+  // Defines are inserted after the #version line of every stage
   Shader(const char* path_vertex, const char* path_fragment,
-         std::optional<const char*> path_geometry = std::nullopt);
+         std::optional<const char*> path_geometry = std::nullopt,
+         const std::string& defines = "");
+  // Compute program, dispatched instead of drawn
+  explicit Shader(const char* path_compute, const std::string& defines = "");
   ~Shader();
 
   void use_shader_program() const;
   int get_uniform_location(std::string_view uniform) const;
 
+  // Also reads sources shared between shaders, which are passed along with their defines
+  static std::string read_source(const char* path, const std::string& defines = "");
+
 private:
-  static std::string read_source(const char* path);
   static bool check_shader_errors(unsigned int shader);
   static bool check_program_errors(unsigned int program);
 
-  unsigned int vertex_shader;
-  unsigned int fragment_shader;
+  unsigned int vertex_shader = 0;
+  unsigned int fragment_shader = 0;
   unsigned int geometry_shader = 0;
+  unsigned int compute_shader = 0;
   unsigned int shader_program;
 };
 
@@ -1,24 +1,36 @@
 #include "directional_shadow.h"
 #include "util/exception.h"
+#include "util/profiling/profiling.h"
 
 #include <glad/glad.h>
 
-DirectionalShadow::DirectionalShadow(int width, int height, int window_width, int window_height,
-                                     vec3 direction)
-    : Shadow (width, height, window_width, window_height)
-{
-  glBindTexture(GL_TEXTURE_2D, Shadow::depth_map);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height,
-               0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-  float border_color[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-  glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border_color);
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+// Shadows end at this distance from the camera even if the camera sees further
+constexpr float MAX_SHADOW_DISTANCE = 40.0f;
+// Blend between logarithmic (1) and uniform (0) cascade splits
+constexpr float SPLIT_LAMBDA = 0.75f;
+// Cascade radii are rounded up to this step so the projection size stays fixed while turning
+constexpr float RADIUS_STEP = 1.0f / 16.0f;
+constexpr int FIRST_CASCADE_UNIT = 27;
+
+DirectionalShadow::DirectionalShadow(int resolution, int num_cascades,
+                                     int window_width, int window_height, vec3 direction)
+    : Shadow (resolution, resolution, window_width, window_height),
+      num_cascades(std::clamp(num_cascades, 1, MAX_CASCADES)),
+      depth_shader(std::make_unique<Shader>("../../shaders/shadow/dir_depth.vert",
+                                            "../../shaders/shadow/dir_depth.frag"))
+{
+  const vec3 up = std::abs(glm::normalize(direction).y) > 0.99f ? vec3(1.0f, 0.0f, 0.0f)
+                                                                 : vec3(0.0f, 1.0f, 0.0f);
+  light_view = glm::lookAt(vec3(0.0f), direction, up);
+
+  allocate_depth_map();
 
   glBindFramebuffer(GL_FRAMEBUFFER, Shadow::FBO);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, Shadow::depth_map, 0);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, Shadow::depth_map, 0, 0);
 
   glDrawBuffer(GL_NONE);
   glReadBuffer(GL_NONE);
@@ -27,17 +39,13 @@ DirectionalShadow::DirectionalShadow(int width, int height, int window_width, in
     throw ShadowException("Failed to generate directional shadow framebuffer");
   }
 
-  mat4 light_projection = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 10.0f);
-  mat4 light_view = glm::lookAt(-direction, vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
-  mat4 light_space = light_projection * light_view;
-
   glGenBuffers(1, &UBO);
   glBindBuffer(GL_UNIFORM_BUFFER, UBO);
-  glBufferData(GL_UNIFORM_BUFFER, sizeof(mat4), &light_space[0][0], GL_STATIC_DRAW);
+  glBufferData(GL_UNIFORM_BUFFER, MAX_CASCADES * sizeof (mat4) + 2 * sizeof (vec4),
+               nullptr, GL_DYNAMIC_DRAW);
   glBindBufferBase(GL_UNIFORM_BUFFER, 8, UBO);
 
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glBindTexture(GL_TEXTURE_2D, 0);
   glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
@@ -45,3 +53,229 @@ DirectionalShadow::~DirectionalShadow()
 {
   glDeleteBuffers(1, &UBO);
 }
+
+void DirectionalShadow::set_num_cascades(int num_cascades)
+{
+  this->num_cascades = std::clamp(num_cascades, 1, MAX_CASCADES);
+
+  for (auto& cascade : cascades) {
+    cascade.valid = false;
+  }
+}
+
+void DirectionalShadow::set_resolution(int resolution)
+{
+  Shadow::width = resolution;
+  Shadow::height = resolution;
+  allocate_depth_map();
+
+  for (auto& cascade : cascades) {
+    cascade.valid = false;
+  }
+}
+
+int DirectionalShadow::get_num_cascades() const
+{
+  return num_cascades;
+}
+
+int DirectionalShadow::get_resolution() const
+{
+  return Shadow::width;
+}
+
+void DirectionalShadow::update(const mat4& perspective, const mat4& view,
+                               const std::vector<AABB>& caster_bounds,
+                               const DrawCasters& draw_casters)
+{
+  PROFILE_GPU_SCOPE("DirectionalShadow")
+
+  const float near_plane = perspective[3][2] / (perspective[2][2] - 1.0f);
+  const float far_plane = std::min(perspective[3][2] / (perspective[2][2] + 1.0f),
+                                   MAX_SHADOW_DISTANCE);
+  const mat4 inverse_view = glm::inverse(view);
+
+  // Old and new bounds of every caster that moved since the last frame
+  std::vector<AABB> moved_bounds;
+
+  if (caster_bounds.size() != previous_caster_bounds.size()) {
+    moved_bounds = previous_caster_bounds;
+    moved_bounds.insert(moved_bounds.end(), caster_bounds.begin(), caster_bounds.end());
+  } else {
+    for (size_t i = 0; i < caster_bounds.size(); i++) {
+      if (caster_bounds[i].min != previous_caster_bounds[i].min ||
+          caster_bounds[i].max != previous_caster_bounds[i].max) {
+        moved_bounds.emplace_back(previous_caster_bounds[i]);
+        moved_bounds.emplace_back(caster_bounds[i]);
+      }
+    }
+  }
+
+  previous_caster_bounds = caster_bounds;
+
+  bool rendered = false;
+  float split_near = near_plane;
+
+  for (int i = 0; i < num_cascades; i++) {
+    const float t = static_cast<float>(i + 1) / num_cascades;
+    const float split_far = SPLIT_LAMBDA * near_plane * std::pow(far_plane / near_plane, t) +
+                            (1.0f - SPLIT_LAMBDA) * (near_plane + (far_plane - near_plane) * t);
+
+    Cascade& cascade = cascades[i];
+    const mat4 light_space = fit_cascade(inverse_view, perspective, split_near, split_far,
+                                         caster_bounds);
+    cascade.far_plane = split_far;
+    split_near = split_far;
+
+    bool needs_update = !cascade.valid || light_space != cascade.light_space;
+
+    if (!needs_update) {
+      const Frustum frustum(light_space);
+      needs_update = std::any_of(moved_bounds.begin(), moved_bounds.end(),
+                                 [&frustum] (const AABB& bounds) {
+        return frustum.intersects(bounds);
+      });
+    }
+
+    if (!needs_update) {
+      continue;
+    }
+
+    PROFILE_SECTION_START_ID(PROFILE_IDS("Cascade %d", 0, MAX_CASCADES)[static_cast<size_t>(i)])
+    if (!rendered) {
+      glBindFramebuffer(GL_FRAMEBUFFER, Shadow::FBO);
+      glViewport(0, 0, Shadow::width, Shadow::height);
+      glEnable(GL_DEPTH_TEST);
+      rendered = true;
+    }
+
+    cascade.light_space = light_space;
+    upload();
+    render_cascade(i, draw_casters);
+    cascade.valid = true;
+    PROFILE_SECTION_END()
+  }
+
+  if (rendered) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, Shadow::window_width, Shadow::window_height);
+  } else {
+    upload();
+  }
+}
+
+void DirectionalShadow::bind_shadow_map(const char* uniform_name,
+                                        std::initializer_list<std::shared_ptr<Shader>> shaders) const
+{
+  for (const auto& shader : shaders) {
+    shader->use_shader_program();
+    glActiveTexture(GL_TEXTURE0 + FIRST_CASCADE_UNIT);
+    glUniform1i(shader->get_uniform_location(uniform_name), FIRST_CASCADE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, Shadow::depth_map);
+  }
+}
+
+void DirectionalShadow::allocate_depth_map()
+{
+  glBindTexture(GL_TEXTURE_2D_ARRAY, Shadow::depth_map);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, Shadow::width, Shadow::height,
+               MAX_CASCADES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+  float border_color[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+  glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border_color);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+mat4 DirectionalShadow::fit_cascade(const mat4& inverse_view, const mat4& perspective,
+                                    float near, float far,
+                                    const std::vector<AABB>& caster_bounds) const
+{
+  const float tan_x = 1.0f / perspective[0][0];
+  const float tan_y = 1.0f / perspective[1][1];
+
+  vec3 corners[8];
+  vec3 center(0.0f);
+
+  for (int i = 0; i < 8; i++) {
+    const float depth = (i & 4) ? far : near;
+    const float x = ((i & 1) ? 1.0f : -1.0f) * tan_x * depth;
+    const float y = ((i & 2) ? 1.0f : -1.0f) * tan_y * depth;
+    corners[i] = vec3(inverse_view * vec4(x, y, -depth, 1.0f));
+    center += corners[i] / 8.0f;
+  }
+
+  // A sphere keeps the cascade the same size whichever way the camera is facing
+  float radius = 0.0f;
+  for (const auto& corner : corners) {
+    radius = std::max(radius, glm::length(corner - center));
+  }
+  radius = std::ceil(radius / RADIUS_STEP) * RADIUS_STEP;
+
+  vec3 light_center = vec3(light_view * vec4(center, 1.0f));
+  const float texel_size = 2.0f * radius / Shadow::width;
+  light_center.x = std::floor(light_center.x / texel_size) * texel_size;
+  light_center.y = std::floor(light_center.y / texel_size) * texel_size;
+
+  // Depths are snapped outwards like the radius, so the matrix and the cached cascade survive
+  // small camera moves along the light direction
+  const float far_plane = std::ceil(-(light_center.z - radius) / RADIUS_STEP) * RADIUS_STEP;
+
+  // Pull the near plane back to the casters between the light and the cascade
+  float near_plane = -(light_center.z + radius);
+
+  for (const auto& bounds : caster_bounds) {
+    if (bounds.empty()) {
+      continue;
+    }
+
+    const AABB light_bounds = bounds.transform(light_view);
+
+    if (light_bounds.max.x < light_center.x - radius ||
+        light_bounds.min.x > light_center.x + radius ||
+        light_bounds.max.y < light_center.y - radius ||
+        light_bounds.min.y > light_center.y + radius ||
+        -light_bounds.max.z > far_plane) {
+      continue;
+    }
+
+    near_plane = std::min(near_plane, -light_bounds.max.z);
+  }
+
+  near_plane = std::floor(near_plane / RADIUS_STEP) * RADIUS_STEP;
+
+  return glm::ortho(light_center.x - radius, light_center.x + radius,
+                    light_center.y - radius, light_center.y + radius,
+                    near_plane, far_plane) * light_view;
+}
+
+void DirectionalShadow::render_cascade(int cascade, const DrawCasters& draw_casters)
+{
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, Shadow::depth_map, 0, cascade);
+  glClear(GL_DEPTH_BUFFER_BIT);
+
+  depth_shader->use_shader_program();
+  glUniform1i(depth_shader->get_uniform_location("cascade"), cascade);
+
+  draw_casters(*depth_shader, Frustum(cascades[cascade].light_space));
+}
+
+void DirectionalShadow::upload() const
+{
+  mat4 light_spaces[MAX_CASCADES];
+  vec4 far_planes(0.0f);
+
+  for (int i = 0; i < MAX_CASCADES; i++) {
+    light_spaces[i] = cascades[i].light_space;
+    far_planes[i] = i < num_cascades ? cascades[i].far_plane : 0.0f;
+  }
+
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof (light_spaces), light_spaces);
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (light_spaces), sizeof (vec4), &far_planes[0]);
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (light_spaces) + sizeof (vec4), sizeof (int),
+                  &num_cascades);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -2,15 +2,55 @@
 #define DIRECTIONAL_SHADOW_H
 
 #include "shadow/shadow.h"
+#include "culling/bounds.h"
+#include "culling/frustum.h"
 
+#include <functional>
+
+constexpr int MAX_CASCADES = 4;
+
+// Cascaded shadow map of a directional light. The camera frustum is split into slices that
+// each get a layer of a depth texture array, fitted to the bounding sphere of the slice and
+// snapped to whole texels so the cascades don't shimmer while the camera moves. A cascade
+// is only re-rendered when its projection changed or a caster inside it moved.
 class DirectionalShadow : public Shadow
 {
 public:
-  DirectionalShadow(int width, int height, int window_width, int window_height, vec3 direction);
+  typedef std::function<void(const Shader& shader, const Frustum& frustum)> DrawCasters;
+
+  DirectionalShadow(int resolution, int num_cascades, int window_width, int window_height,
+                    vec3 direction);
   ~DirectionalShadow() override;
 
+  void set_num_cascades(int num_cascades);
+  void set_resolution(int resolution);
+  int get_num_cascades() const;
+  int get_resolution() const;
+
+  void update(const mat4& perspective, const mat4& view,
+              const std::vector<AABB>& caster_bounds, const DrawCasters& draw_casters);
+  void bind_shadow_map(const char* uniform_name,
+                       std::initializer_list<std::shared_ptr<Shader>> shaders) const override;
+
 private:
+  struct Cascade {
+    mat4 light_space = mat4(0.0f);
+    float far_plane = 0.0f;
+    bool valid = false;
+  };
+
+  void allocate_depth_map();
+  mat4 fit_cascade(const mat4& inverse_view, const mat4& perspective, float near, float far,
+                   const std::vector<AABB>& caster_bounds) const;
+  void render_cascade(int cascade, const DrawCasters& draw_casters);
+  void upload() const;
+
   unsigned int UBO;
+  mat4 light_view;
+  int num_cascades;
+  Cascade cascades[MAX_CASCADES];
+  std::vector<AABB> previous_caster_bounds;
+  std::unique_ptr<Shader> depth_shader;
 };
 
 #endif // DIRECTIONAL_SHADOW_H
@@ -0,0 +1,677 @@
+#include "point_shadow_cache.h"
+#include "util/exception.h"
+#include "util/logging.h"
+#include "util/profiling/profiling.h"
+
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <string>
+
+struct ShadowTier {
+  int resolution;
+  int num_slots;
+};
+
+// Highest resolution first, a light drops one tier every time its size on screen halves
+constexpr ShadowTier SHADOW_TIERS[] {
+  { 1024, 1 },
+  { 512, 4 },
+  { 256, 8 },
+  { 128, 16 },
+};
+constexpr int NUM_SHADOW_TIERS = sizeof (SHADOW_TIERS) / sizeof (SHADOW_TIERS[0]);
+constexpr int FIRST_SHADOW_UNIT = 32 - NUM_SHADOW_TIERS;
+// Compare samplers of the same tiers, below the directional shadow map
+constexpr int FIRST_COMPARE_UNIT = FIRST_SHADOW_UNIT - 1 - NUM_SHADOW_TIERS;
+constexpr int DEFAULT_FILTER_TAPS = 8;
+constexpr float SHADOW_NEAR_PLANE = 0.1f;
+constexpr float CLEAR_DEPTH = 1.0f;
+
+constexpr const char* RENDER_MODE_NAMES[] {
+  "Vertex Layer",
+  "Geometry Shader",
+  "Per Face",
+};
+constexpr size_t NUM_RENDER_MODES = sizeof (RENDER_MODE_NAMES) / sizeof (RENDER_MODE_NAMES[0]);
+
+constexpr const char* FILTER_NAMES[] {
+  "Manual",
+  "Hardware",
+  "Poisson",
+  "Poisson Early Out",
+};
+
+constexpr std::pair<vec3, vec3> FACE_LOOKATS[6] {
+  { vec3(1.0f, 0.0f, 0.0f),  vec3(0.0f, -1.0f, 0.0f) },
+  { vec3(-1.0f, 0.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f) },
+  { vec3(0.0f, 1.0f, 0.0f),  vec3(0.0f, 0.0f, 1.0f) },
+  { vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f) },
+  { vec3(0.0f, 0.0f, 1.0f),  vec3(0.0f, -1.0f, 0.0f) },
+  { vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, -1.0f, 0.0f) },
+};
+
+// Section of the face rendering, named after the render mode, every name interned once
+[[maybe_unused]] static Profiling::ScopeId get_render_faces_scope(
+  PointShadowCache::RenderMode mode)
+{
+  static const auto scopes = [] {
+    std::array<Profiling::ScopeId, NUM_RENDER_MODES> ids;
+
+    for (size_t i = 0; i < NUM_RENDER_MODES; i++) {
+      ids[i] = Profiling::intern_format("Render Faces (%s)", RENDER_MODE_NAMES[i]);
+    }
+
+    return ids;
+  }();
+
+  return scopes[static_cast<size_t>(mode)];
+}
+
+PointShadowCache::PointShadowCache(int window_width, int window_height, int face_budget)
+  : window_width(window_width),
+    window_height(window_height),
+    face_budget(face_budget),
+    render_mode(RenderMode::PER_FACE),
+    filter(ShadowFilter::POISSON_EARLY_OUT),
+    filter_taps(DEFAULT_FILTER_TAPS),
+    depth_shader(std::make_unique<Shader>("../../shaders/shadow/point_cache_depth.vert",
+                                          "../../shaders/shadow/point_cache_depth.frag")),
+    geometry_shader(std::make_unique<Shader>("../../shaders/shadow/point_cache_world.vert",
+                                             "../../shaders/shadow/point_cache_depth.frag",
+                                             "../../shaders/shadow/point_cache_depth.geom")),
+    num_frames(0),
+    total_rendered(0),
+    total_reused(0),
+    mode_frames {},
+    mode_triangles {}
+{
+  // Writing gl_Layer outside the geometry shader is an extension to GL 4.5, the layer shader
+  // doesn't compile without it
+  int num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+
+  for (int i = 0; i < num_extensions; i++) {
+    const std::string extension(reinterpret_cast<const char*>(
+      glGetStringi(GL_EXTENSIONS, static_cast<unsigned int>(i))));
+
+    if (extension == "GL_ARB_shader_viewport_layer_array" ||
+        extension == "GL_AMD_vertex_shader_layer") {
+      layer_shader = std::make_unique<Shader>("../../shaders/shadow/point_cache_layer.vert",
+                                              "../../shaders/shadow/point_cache_depth.frag");
+      render_mode = RenderMode::VERTEX_LAYER;
+      break;
+    }
+  }
+
+  for (const auto& [resolution, num_slots] : SHADOW_TIERS) {
+    Tier tier { resolution, 0, {} };
+
+    glGenTextures(1, &tier.cubemap_array);
+    glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, tier.cubemap_array);
+    glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, 0, GL_DEPTH_COMPONENT, resolution, resolution,
+                 6 * num_slots, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glClearTexImage(tier.cubemap_array, 0, GL_DEPTH_COMPONENT, GL_FLOAT, &CLEAR_DEPTH);
+
+    for (int slot = num_slots - 1; slot >= 0; slot--) {
+      tier.free_slots.emplace_back(slot);
+    }
+
+    tiers.emplace_back(std::move(tier));
+  }
+
+  glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+
+  glGenFramebuffers(1, &FBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tiers[0].cubemap_array, 0, 0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    throw ShadowException("Failed to generate point shadow cache framebuffer");
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  glGenBuffers(1, &UBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferData(GL_UNIFORM_BUFFER, 6 * sizeof (mat4) + 2 * sizeof (vec4), nullptr, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, 10, UBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  glGenBuffers(1, &slot_SSBO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, slot_SSBO);
+
+  // Overrides the nearest filtering of the cube arrays on the compare units only
+  glGenSamplers(1, &compare_sampler);
+  glSamplerParameteri(compare_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glSamplerParameteri(compare_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glSamplerParameteri(compare_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(compare_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(compare_sampler, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(compare_sampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+  glSamplerParameteri(compare_sampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+}
+
+PointShadowCache::~PointShadowCache()
+{
+  for (const auto& tier : tiers) {
+    glDeleteTextures(1, &tier.cubemap_array);
+  }
+
+  glDeleteFramebuffers(1, &FBO);
+  glDeleteBuffers(1, &UBO);
+  glDeleteBuffers(1, &slot_SSBO);
+  glDeleteSamplers(1, &compare_sampler);
+
+  if (num_frames == 0) {
+    return;
+  }
+
+  const long long total_faces = total_rendered + total_reused;
+  const double reuse_rate = total_faces == 0 ? 0.0 : 100.0 * total_reused / total_faces;
+
+  logger_t logger = Logging::get_logger();
+  logger << "-----------------------------------------------------" << std::endl;
+  logger << "                  Point Shadow Cache                 " << std::endl;
+  logger << "-----------------------------------------------------" << std::endl;
+  logger << "Face budget per frame: " << face_budget << std::endl;
+  logger << "Faces rendered per frame: "
+         << static_cast<double>(total_rendered) / num_frames << std::endl;
+  logger << "Faces reused per frame: "
+         << static_cast<double>(total_reused) / num_frames << std::endl;
+  logger << "Reuse rate: " << reuse_rate << " %" << std::endl;
+
+  for (size_t i = 0; i < mode_frames.size(); i++) {
+    if (mode_frames[i] > 0) {
+      logger << RENDER_MODE_NAMES[i] << " triangles per frame: "
+             << static_cast<double>(mode_triangles[i]) / mode_frames[i] << std::endl;
+    }
+  }
+}
+
+void PointShadowCache::update(const std::vector<Lights::PointLight>& point_lights,
+                              const std::vector<AABB>& caster_bounds,
+                              const mat4& view_projection, const vec3& view_position,
+                              ShadowCasters& casters)
+{
+  PROFILE_GPU_SCOPE("PointShadowCache")
+
+  PROFILE_SECTION_START("Schedule Faces")
+  update_lights(point_lights, view_projection, view_position);
+  allocate_slots();
+  invalidate_casters(caster_bounds);
+
+  stats = {};
+  stale_faces.clear();
+
+  for (unsigned int i = 0; i < shadows.size(); i++) {
+    const LightShadow& shadow = shadows[i];
+
+    if (shadow.slot < 0) {
+      continue;
+    }
+
+    stats.shadowed_lights++;
+
+    for (int face = 0; face < 6; face++) {
+      if (shadow.valid[static_cast<size_t>(face)]) {
+        stats.faces_reused++;
+      } else {
+        stale_faces.push_back({ i, face, shadow.rendered[static_cast<size_t>(face)],
+                                shadow.priority });
+      }
+    }
+  }
+
+  // Faces that were never rendered come first since they don't cast any shadow yet
+  const size_t num_rendered = std::min(stale_faces.size(), static_cast<size_t>(face_budget));
+  std::partial_sort(stale_faces.begin(), stale_faces.begin() + static_cast<long>(num_rendered),
+                    stale_faces.end(), [] (const Face& a, const Face& b) {
+    if (a.rendered != b.rendered) {
+      return !a.rendered;
+    }
+    return a.priority > b.priority;
+  });
+
+  stats.faces_rendered = static_cast<int>(num_rendered);
+  stats.faces_pending = static_cast<int>(stale_faces.size() - num_rendered);
+
+  // Render the selected faces grouped by light so each light culls its casters only once
+  std::vector<int> face_masks(shadows.size(), 0);
+  std::vector<unsigned int> rendered_lights;
+
+  for (size_t i = 0; i < num_rendered; i++) {
+    if (face_masks[stale_faces[i].light] == 0) {
+      rendered_lights.emplace_back(stale_faces[i].light);
+    }
+    face_masks[stale_faces[i].light] |= 1 << stale_faces[i].face;
+  }
+  PROFILE_SECTION_END()
+
+  const long long triangles = casters.get_num_triangles();
+
+  PROFILE_SECTION_START_ID(get_render_faces_scope(render_mode))
+  if (!rendered_lights.empty()) {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glEnable(GL_DEPTH_TEST);
+
+    for (unsigned int light : rendered_lights) {
+      render_light(light, face_masks[light], casters);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, window_width, window_height);
+  }
+
+  stats.triangles = casters.get_num_triangles() - triangles;
+
+  upload_slots();
+  PROFILE_SECTION_END()
+
+  num_frames++;
+  total_rendered += stats.faces_rendered;
+  total_reused += stats.faces_reused;
+  mode_frames[static_cast<size_t>(render_mode)]++;
+  mode_triangles[static_cast<size_t>(render_mode)] += stats.triangles;
+  log_stats();
+}
+
+void PointShadowCache::bind_shadow_maps(const char* uniform_name, const char* compare_uniform_name,
+                                        std::initializer_list<std::shared_ptr<Shader>> shaders) const
+{
+  for (const auto& shader : shaders) {
+    shader->use_shader_program();
+
+    for (int i = 0; i < NUM_SHADOW_TIERS; i++) {
+      const std::string index = "[" + std::to_string(i) + "]";
+      const unsigned int cubemap_array = tiers[static_cast<size_t>(i)].cubemap_array;
+
+      glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(FIRST_SHADOW_UNIT + i));
+      glUniform1i(shader->get_uniform_location(uniform_name + index), FIRST_SHADOW_UNIT + i);
+      glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, cubemap_array);
+
+      glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(FIRST_COMPARE_UNIT + i));
+      glUniform1i(shader->get_uniform_location(compare_uniform_name + index),
+                  FIRST_COMPARE_UNIT + i);
+      glBindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, cubemap_array);
+      glBindSampler(static_cast<unsigned int>(FIRST_COMPARE_UNIT + i), compare_sampler);
+    }
+
+    glUniform1i(shader->get_uniform_location("shadow_filter"), static_cast<int>(filter));
+    glUniform1i(shader->get_uniform_location("shadow_filter_taps"), filter_taps);
+  }
+}
+
+void PointShadowCache::set_render_mode(RenderMode mode)
+{
+  render_mode = mode == RenderMode::VERTEX_LAYER && !layer_shader ? RenderMode::PER_FACE : mode;
+}
+
+PointShadowCache::RenderMode PointShadowCache::get_render_mode() const
+{
+  return render_mode;
+}
+
+bool PointShadowCache::vertex_layer_supported() const
+{
+  return layer_shader != nullptr;
+}
+
+void PointShadowCache::set_filter(ShadowFilter filter)
+{
+  this->filter = filter;
+}
+
+PointShadowCache::ShadowFilter PointShadowCache::get_filter() const
+{
+  return filter;
+}
+
+const char* PointShadowCache::get_filter_name() const
+{
+  return FILTER_NAMES[static_cast<size_t>(filter)];
+}
+
+void PointShadowCache::set_filter_taps(int taps)
+{
+  filter_taps = std::clamp(taps, 1, MAX_SHADOW_FILTER_TAPS);
+}
+
+int PointShadowCache::get_filter_taps() const
+{
+  return filter_taps;
+}
+
+const std::string& PointShadowCache::get_shader_source()
+{
+  static const std::string source =
+    Shader::read_source("../../shaders/processing/point_shadow.glsl");
+  return source;
+}
+
+void PointShadowCache::update_lights(const std::vector<Lights::PointLight>& point_lights,
+                                     const mat4& view_projection, const vec3& view_position)
+{
+  for (size_t i = point_lights.size(); i < shadows.size(); i++) {
+    free_slot(shadows[i]);
+  }
+
+  shadows.resize(point_lights.size());
+
+  const Frustum frustum(view_projection);
+
+  for (size_t i = 0; i < point_lights.size(); i++) {
+    LightShadow& shadow = shadows[i];
+    const vec3& position = point_lights[i].position;
+    const float radius = Lights::get_radius(point_lights[i]);
+
+    if (position != shadow.position || radius != shadow.radius) {
+      shadow.position = position;
+      shadow.radius = radius;
+      shadow.valid.fill(false);
+    }
+
+    // Squared ratio of radius to distance, proportional to the area the light covers on screen
+    if (frustum.intersects(position, radius)) {
+      const float ratio = radius / std::max(glm::length(position - view_position),
+                                            SHADOW_NEAR_PLANE);
+      shadow.priority = ratio * ratio;
+    } else {
+      shadow.priority = 0.0f;
+    }
+  }
+
+  const bool resized = light_bounds.size() != shadows.size();
+  light_bounds.resize(shadows.size());
+
+  for (size_t i = 0; i < shadows.size(); i++) {
+    light_bounds[i] = { shadows[i].position - vec3(shadows[i].radius),
+                        shadows[i].position + vec3(shadows[i].radius) };
+  }
+
+  if (resized) {
+    light_bvh.build(light_bounds);
+  } else {
+    light_bvh.refit(light_bounds);
+  }
+}
+
+void PointShadowCache::allocate_slots()
+{
+  size_t num_slots = 0;
+  for (const auto& tier : SHADOW_TIERS) {
+    num_slots += static_cast<size_t>(tier.num_slots);
+  }
+
+  std::vector<unsigned int> order;
+  for (unsigned int i = 0; i < shadows.size(); i++) {
+    if (shadows[i].priority > 0.0f) {
+      order.emplace_back(i);
+    }
+  }
+
+  std::sort(order.begin(), order.end(), [this] (unsigned int a, unsigned int b) {
+    return shadows[a].priority > shadows[b].priority;
+  });
+
+  // Lights that no longer make the cut give their slots to the ones that do
+  std::vector<bool> shadowed(shadows.size(), false);
+  for (size_t i = 0; i < std::min(order.size(), num_slots); i++) {
+    shadowed[order[i]] = true;
+  }
+
+  for (size_t i = 0; i < shadows.size(); i++) {
+    if (!shadowed[i]) {
+      free_slot(shadows[i]);
+    }
+  }
+
+  for (size_t i = 0; i < std::min(order.size(), num_slots); i++) {
+    LightShadow& shadow = shadows[order[i]];
+    const int desired_tier = std::clamp(static_cast<int>(-0.5f * std::log2(shadow.priority)),
+                                        0, NUM_SHADOW_TIERS - 1);
+
+    if (shadow.tier == desired_tier) {
+      continue;
+    }
+
+    // Prefer the desired resolution, then lower ones, then higher ones
+    int tier = -1;
+    for (int offset = 0; offset < NUM_SHADOW_TIERS && tier < 0; offset++) {
+      for (int candidate : { desired_tier + offset, desired_tier - offset }) {
+        if (candidate >= 0 && candidate < NUM_SHADOW_TIERS &&
+            !tiers[static_cast<size_t>(candidate)].free_slots.empty()) {
+          tier = candidate;
+          break;
+        }
+      }
+    }
+
+    if (tier < 0 || tier == shadow.tier) {
+      continue;
+    }
+
+    if (shadow.slot >= 0 && std::abs(tier - desired_tier) >= std::abs(shadow.tier - desired_tier)) {
+      continue;
+    }
+
+    free_slot(shadow);
+
+    Tier& new_tier = tiers[static_cast<size_t>(tier)];
+    shadow.tier = tier;
+    shadow.slot = new_tier.free_slots.back();
+    new_tier.free_slots.pop_back();
+
+    // Faces that were not rendered yet read as unshadowed
+    glClearTexSubImage(new_tier.cubemap_array, 0, 0, 0, 6 * shadow.slot,
+                       new_tier.resolution, new_tier.resolution, 6,
+                       GL_DEPTH_COMPONENT, GL_FLOAT, &CLEAR_DEPTH);
+  }
+}
+
+void PointShadowCache::free_slot(LightShadow& shadow)
+{
+  if (shadow.slot >= 0) {
+    tiers[static_cast<size_t>(shadow.tier)].free_slots.emplace_back(shadow.slot);
+  }
+
+  shadow.tier = -1;
+  shadow.slot = -1;
+  shadow.valid.fill(false);
+  shadow.rendered.fill(false);
+}
+
+void PointShadowCache::invalidate_casters(const std::vector<AABB>& caster_bounds)
+{
+  if (caster_bounds.size() != previous_caster_bounds.size()) {
+    for (const auto& bounds : previous_caster_bounds) {
+      invalidate_faces(bounds);
+    }
+
+    for (const auto& bounds : caster_bounds) {
+      invalidate_faces(bounds);
+    }
+  } else {
+    for (size_t i = 0; i < caster_bounds.size(); i++) {
+      const AABB& previous = previous_caster_bounds[i];
+      const AABB& current = caster_bounds[i];
+
+      if (previous.min != current.min || previous.max != current.max) {
+        invalidate_faces(previous);
+        invalidate_faces(current);
+      }
+    }
+  }
+
+  previous_caster_bounds = caster_bounds;
+}
+
+void PointShadowCache::invalidate_faces(const AABB& bounds)
+{
+  if (bounds.empty()) {
+    return;
+  }
+
+  // Lights whose bounds touch the sphere around the caster, tested exactly below
+  light_bvh.query_sphere(bounds.center(), 0.5f * glm::length(bounds.max - bounds.min),
+                         nearby_lights);
+
+  for (const unsigned int light : nearby_lights) {
+    LightShadow& shadow = shadows[light];
+
+    if (shadow.slot < 0) {
+      continue;
+    }
+
+    const vec3 closest = glm::clamp(shadow.position, bounds.min, bounds.max);
+    const vec3 offset = closest - shadow.position;
+
+    if (glm::dot(offset, offset) > shadow.radius * shadow.radius) {
+      continue;
+    }
+
+    for (int face = 0; face < 6; face++) {
+      if (shadow.valid[static_cast<size_t>(face)] &&
+          Frustum(face_view_projection(shadow, face)).intersects(bounds)) {
+        shadow.valid[static_cast<size_t>(face)] = false;
+      }
+    }
+  }
+}
+
+void PointShadowCache::render_light(unsigned int light, int face_mask, ShadowCasters& casters)
+{
+  LightShadow& shadow = shadows[light];
+  const Tier& tier = tiers[static_cast<size_t>(shadow.tier)];
+  const int first_layer = 6 * shadow.slot;
+
+  std::array<mat4, 6> view_projections;
+  for (int face = 0; face < 6; face++) {
+    view_projections[static_cast<size_t>(face)] = face_view_projection(shadow, face);
+  }
+
+  // Matches ShadowFace in the point cache shaders
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof (view_projections), view_projections.data());
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (view_projections), sizeof (vec3),
+                  &shadow.position[0]);
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (view_projections) + sizeof (vec3), sizeof (float),
+                  &shadow.radius);
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (view_projections) + sizeof (vec4), sizeof (int),
+                  &first_layer);
+  glBufferSubData(GL_UNIFORM_BUFFER, sizeof (view_projections) + sizeof (vec4) + sizeof (int),
+                  sizeof (int), &face_mask);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+  casters.cull(view_projections, face_mask, shadow.position, shadow.radius);
+  glViewport(0, 0, tier.resolution, tier.resolution);
+
+  if (render_mode == RenderMode::PER_FACE) {
+    depth_shader->use_shader_program();
+    const int model_location = depth_shader->get_uniform_location("model_matrix");
+
+    for (int face = 0; face < 6; face++) {
+      if (!(face_mask & (1 << face))) {
+        continue;
+      }
+
+      glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tier.cubemap_array, 0,
+                                first_layer + face);
+      glClear(GL_DEPTH_BUFFER_BIT);
+      glUniform1i(depth_shader->get_uniform_location("face"), face);
+      casters.draw_face(face, model_location);
+    }
+  } else {
+    // Layered rendering writes the whole array, so only the stale faces are cleared
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, tier.cubemap_array, 0);
+
+    for (int face = 0; face < 6; face++) {
+      if (face_mask & (1 << face)) {
+        glClearTexSubImage(tier.cubemap_array, 0, 0, 0, first_layer + face,
+                           tier.resolution, tier.resolution, 1,
+                           GL_DEPTH_COMPONENT, GL_FLOAT, &CLEAR_DEPTH);
+      }
+    }
+
+    if (render_mode == RenderMode::VERTEX_LAYER) {
+      layer_shader->use_shader_program();
+      casters.draw_layered(layer_shader->get_uniform_location("model_matrix"));
+    } else {
+      geometry_shader->use_shader_program();
+      casters.draw_union(geometry_shader->get_uniform_location("model_matrix"));
+    }
+  }
+
+  for (int face = 0; face < 6; face++) {
+    if (face_mask & (1 << face)) {
+      shadow.valid[static_cast<size_t>(face)] = true;
+      shadow.rendered[static_cast<size_t>(face)] = true;
+    }
+  }
+}
+
+void PointShadowCache::upload_slots() const
+{
+  if (shadows.empty()) {
+    return;
+  }
+
+  // Matches ShadowSlot in the lighting shaders, a negative tier means no shadow
+  struct ShadowSlot {
+    int tier;
+    int layer;
+    float far_plane;
+    float padding;
+  };
+
+  std::vector<ShadowSlot> slots;
+  slots.reserve(shadows.size());
+
+  for (const auto& shadow : shadows) {
+    slots.push_back({ shadow.tier, shadow.slot, shadow.radius, 0.0f });
+  }
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, slot_SSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<long>(slots.size() * sizeof (ShadowSlot)),
+               slots.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+mat4 PointShadowCache::face_view_projection(const LightShadow& shadow, int face)
+{
+  const auto& [center, up] = FACE_LOOKATS[face];
+
+  return glm::perspective(glm::radians(90.0f), 1.0f, SHADOW_NEAR_PLANE, shadow.radius) *
+         glm::lookAt(shadow.position, shadow.position + center, up);
+}
+
+void PointShadowCache::log_stats()
+{
+  if (stats.shadowed_lights == logged_stats.shadowed_lights &&
+      stats.faces_rendered == logged_stats.faces_rendered &&
+      stats.faces_reused == logged_stats.faces_reused &&
+      stats.faces_pending == logged_stats.faces_pending) {
+    return;
+  }
+
+  logged_stats = stats;
+
+  const int total_faces = stats.faces_rendered + stats.faces_reused;
+  const double reuse_rate = total_faces == 0 ? 0.0 : 100.0 * stats.faces_reused / total_faces;
+
+  logger_t logger = Logging::get_logger();
+  logger << "Point shadow faces of " << stats.shadowed_lights << " lights: "
+         << stats.faces_rendered << " rendered, " << stats.faces_reused << " reused ("
+         << reuse_rate << " %), " << stats.faces_pending << " pending, " << stats.triangles
+         << " triangles" << std::endl;
+}
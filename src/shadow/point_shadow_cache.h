@@ -0,0 +1,147 @@
+#ifndef POINT_SHADOW_CACHE_H
+#define POINT_SHADOW_CACHE_H
+
+#include "shader/shader.h"
+#include "model/lights.h"
+#include "culling/bounds.h"
+#include "culling/bvh.h"
+#include "culling/frustum.h"
+#include "shadow/shadow_casters.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+typedef glm::vec3 vec3;
+typedef glm::mat4 mat4;
+
+// Most taps of the Poisson shadow filters, matching MAX_POISSON_TAPS in point_shadow.glsl
+constexpr int MAX_SHADOW_FILTER_TAPS = 16;
+
+// Shadow maps for many point lights. Cube faces are allocated from cubemap arrays of a few
+// resolution tiers, and the tier of a light follows its size on screen. Faces stay cached
+// until the light or a shadow caster inside the face moved, and at most a fixed number of
+// stale faces is re-rendered per frame, ordered by how much the light covers on screen.
+// The stale faces of a light are rendered together, either one pass per face, one layered
+// pass with the layer picked in the vertex shader, or one pass through a geometry shader.
+class PointShadowCache
+{
+public:
+  enum class RenderMode {
+    VERTEX_LAYER,
+    GEOMETRY_SHADER,
+    PER_FACE,
+  };
+
+  // How the lighting shaders filter the shadow maps, the values match SHADOW_FILTER_* there.
+  // MANUAL compares 20 nearest taps in the shader, HARDWARE takes a single bilinear depth
+  // compare, the Poisson filters take a rotated disk of compare taps and the early out
+  // variant stops after the first ring when its taps agree.
+  enum class ShadowFilter {
+    MANUAL,
+    HARDWARE,
+    POISSON,
+    POISSON_EARLY_OUT,
+  };
+
+  PointShadowCache(int window_width, int window_height, int face_budget);
+  ~PointShadowCache();
+
+  void update(const std::vector<Lights::PointLight>& point_lights,
+              const std::vector<AABB>& caster_bounds,
+              const mat4& view_projection, const vec3& view_position,
+              ShadowCasters& casters);
+  void bind_shadow_maps(const char* uniform_name, const char* compare_uniform_name,
+                        std::initializer_list<std::shared_ptr<Shader>> shaders) const;
+
+  void set_render_mode(RenderMode mode);
+  RenderMode get_render_mode() const;
+  bool vertex_layer_supported() const;
+  void set_filter(ShadowFilter filter);
+  ShadowFilter get_filter() const;
+  const char* get_filter_name() const;
+  void set_filter_taps(int taps);
+  int get_filter_taps() const;
+
+  // Shadow lookup and filters of the lighting shaders, to be appended to their defines
+  static const std::string& get_shader_source();
+
+private:
+  // Of the current frame, faces that were stale past the budget are pending
+  struct Stats {
+    int shadowed_lights = 0;
+    int faces_rendered = 0;
+    int faces_reused = 0;
+    int faces_pending = 0;
+    long long triangles = 0;
+  };
+
+  struct Tier {
+    int resolution;
+    unsigned int cubemap_array;
+    std::vector<int> free_slots;
+  };
+
+  struct LightShadow {
+    int tier = -1;
+    int slot = -1;
+    vec3 position = vec3(0.0f);
+    float radius = 0.0f;
+    float priority = 0.0f;
+    std::array<bool, 6> valid {};
+    std::array<bool, 6> rendered {};
+  };
+
+  struct Face {
+    unsigned int light;
+    int face;
+    bool rendered;
+    float priority;
+  };
+
+  void update_lights(const std::vector<Lights::PointLight>& point_lights,
+                     const mat4& view_projection, const vec3& view_position);
+  void allocate_slots();
+  void free_slot(LightShadow& shadow);
+  void invalidate_casters(const std::vector<AABB>& caster_bounds);
+  void invalidate_faces(const AABB& bounds);
+  void render_light(unsigned int light, int face_mask, ShadowCasters& casters);
+  void upload_slots() const;
+  void log_stats();
+
+  static mat4 face_view_projection(const LightShadow& shadow, int face);
+
+  int window_width, window_height;
+  int face_budget;
+  unsigned int FBO, UBO, slot_SSBO;
+  unsigned int compare_sampler;
+
+  std::vector<Tier> tiers;
+  std::vector<LightShadow> shadows;
+  std::vector<AABB> previous_caster_bounds;
+  // Over the bounds of every light's sphere, so a moved caster only visits the lights it
+  // may touch
+  BVH light_bvh;
+  std::vector<AABB> light_bounds;
+  std::vector<unsigned int> nearby_lights;
+  std::vector<Face> stale_faces;
+  RenderMode render_mode;
+  ShadowFilter filter;
+  int filter_taps;
+  std::unique_ptr<Shader> depth_shader;
+  std::unique_ptr<Shader> layer_shader;
+  std::unique_ptr<Shader> geometry_shader;
+
+  Stats stats;
+  // Last logged frame, the faces are only logged again when their counts change
+  Stats logged_stats;
+  long long num_frames;
+  long long total_rendered;
+  long long total_reused;
+  std::array<long long, 3> mode_frames;
+  std::array<long long, 3> mode_triangles;
+};
+
+#endif // POINT_SHADOW_CACHE_H
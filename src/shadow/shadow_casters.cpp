@@ -0,0 +1,283 @@
+#include "shadow_casters.h"
+
+#include <glad/glad.h>
+
+// Clip space outcode bits, a triangle is outside a face when all of its vertices share one
+constexpr unsigned char OUTSIDE_LEFT = 1 << 0;
+constexpr unsigned char OUTSIDE_RIGHT = 1 << 1;
+constexpr unsigned char OUTSIDE_BOTTOM = 1 << 2;
+constexpr unsigned char OUTSIDE_TOP = 1 << 3;
+constexpr unsigned char OUTSIDE_NEAR = 1 << 4;
+constexpr unsigned char OUTSIDE_FAR = 1 << 5;
+
+ShadowCasters::ShadowCasters()
+  : index_capacity(0),
+    indirect_capacity(0),
+    num_triangles(0)
+{
+  constexpr int faces[6] = { 0, 1, 2, 3, 4, 5 };
+
+  glGenBuffers(1, &EBO);
+  glGenBuffers(1, &indirect_buffer);
+  glGenBuffers(1, &face_VBO);
+
+  glBindBuffer(GL_ARRAY_BUFFER, face_VBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof (faces), faces, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+ShadowCasters::~ShadowCasters()
+{
+  for (const auto& mesh : meshes) {
+    glDeleteVertexArrays(1, &mesh.VAO);
+    glDeleteBuffers(1, &mesh.VBO);
+  }
+
+  glDeleteBuffers(1, &EBO);
+  glDeleteBuffers(1, &indirect_buffer);
+  glDeleteBuffers(1, &face_VBO);
+}
+
+unsigned int ShadowCasters::add_mesh(const vec3* positions, int num_positions,
+                                     const unsigned int* indices, int num_indices)
+{
+  CasterMesh mesh {
+    0, 0,
+    std::vector<vec3>(positions, positions + num_positions),
+    std::vector<unsigned int>(indices, indices + num_indices),
+  };
+
+  glGenVertexArrays(1, &mesh.VAO);
+  glGenBuffers(1, &mesh.VBO);
+
+  glBindVertexArray(mesh.VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<long>(mesh.positions.size() * sizeof (vec3)),
+               mesh.positions.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof (vec3), reinterpret_cast<void*>(0));
+  glEnableVertexAttribArray(0);
+
+  // The face of a layered draw comes from the base instance of its command
+  glBindBuffer(GL_ARRAY_BUFFER, face_VBO);
+  glVertexAttribIPointer(1, 1, GL_INT, sizeof (int), reinterpret_cast<void*>(0));
+  glVertexAttribDivisor(1, 1);
+  glEnableVertexAttribArray(1);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  meshes.emplace_back(std::move(mesh));
+
+  return static_cast<unsigned int>(meshes.size() - 1);
+}
+
+unsigned int ShadowCasters::add_mesh(const float* vertices, int stride, int num_vertices,
+                                     const unsigned int* indices, int num_indices)
+{
+  std::vector<vec3> positions;
+  positions.reserve(static_cast<size_t>(num_vertices));
+
+  for (int i = 0; i < num_vertices; i++) {
+    positions.emplace_back(vertices[i * stride], vertices[i * stride + 1],
+                           vertices[i * stride + 2]);
+  }
+
+  return add_mesh(positions.data(), num_vertices, indices, num_indices);
+}
+
+void ShadowCasters::clear_instances()
+{
+  instances.clear();
+}
+
+void ShadowCasters::add_instance(unsigned int mesh, const mat4& model, const AABB& bounds)
+{
+  instances.push_back({ mesh, model, bounds });
+}
+
+void ShadowCasters::cull(const std::array<mat4, 6>& face_matrices, int face_mask,
+                         const vec3& center, float radius)
+{
+  visible_instances.clear();
+  face_ranges.clear();
+  union_ranges.clear();
+  culled_indices.clear();
+  draw_commands.clear();
+  command_ranges.clear();
+
+  for (unsigned int i = 0; i < instances.size(); i++) {
+    const Instance& instance = instances[i];
+    const vec3 closest = glm::clamp(center, instance.bounds.min, instance.bounds.max);
+
+    if (glm::dot(closest - center, closest - center) > radius * radius) {
+      continue;
+    }
+
+    const CasterMesh& mesh = meshes[instance.mesh];
+    const std::vector<unsigned int>& indices = mesh.indices;
+
+    #pragma omp parallel for
+    for (int face = 0; face < 6; face++) {
+      std::vector<unsigned char>& codes = outcodes[static_cast<size_t>(face)];
+      std::vector<unsigned int>& kept = face_indices[static_cast<size_t>(face)];
+      kept.clear();
+
+      if (!(face_mask & (1 << face))) {
+        continue;
+      }
+
+      const mat4 model_view_projection = face_matrices[static_cast<size_t>(face)] * instance.model;
+      codes.resize(mesh.positions.size());
+
+      for (size_t v = 0; v < mesh.positions.size(); v++) {
+        const vec4 clip = model_view_projection * vec4(mesh.positions[v], 1.0f);
+        codes[v] = static_cast<unsigned char>((clip.x < -clip.w ? OUTSIDE_LEFT : 0) |
+                                              (clip.x > clip.w ? OUTSIDE_RIGHT : 0) |
+                                              (clip.y < -clip.w ? OUTSIDE_BOTTOM : 0) |
+                                              (clip.y > clip.w ? OUTSIDE_TOP : 0) |
+                                              (clip.z < -clip.w ? OUTSIDE_NEAR : 0) |
+                                              (clip.z > clip.w ? OUTSIDE_FAR : 0));
+      }
+
+      for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        if ((codes[indices[t]] & codes[indices[t + 1]] & codes[indices[t + 2]]) == 0) {
+          kept.insert(kept.end(), &indices[t], &indices[t] + 3);
+        }
+      }
+    }
+
+    union_indices.clear();
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+      for (int face = 0; face < 6; face++) {
+        const std::vector<unsigned char>& codes = outcodes[static_cast<size_t>(face)];
+
+        if ((face_mask & (1 << face)) &&
+            (codes[indices[t]] & codes[indices[t + 1]] & codes[indices[t + 2]]) == 0) {
+          union_indices.insert(union_indices.end(), &indices[t], &indices[t] + 3);
+          break;
+        }
+      }
+    }
+
+    if (union_indices.empty()) {
+      continue;
+    }
+
+    std::array<Range, 6> ranges {};
+    const Range commands { static_cast<unsigned int>(draw_commands.size()), 0 };
+    command_ranges.push_back(commands);
+
+    for (int face = 0; face < 6; face++) {
+      const std::vector<unsigned int>& kept = face_indices[static_cast<size_t>(face)];
+      ranges[static_cast<size_t>(face)] = {
+        static_cast<unsigned int>(culled_indices.size()), static_cast<unsigned int>(kept.size())
+      };
+
+      if (!kept.empty()) {
+        draw_commands.push_back({
+          static_cast<unsigned int>(kept.size()), 1,
+          static_cast<unsigned int>(culled_indices.size()), 0, static_cast<unsigned int>(face)
+        });
+        command_ranges.back().count++;
+      }
+
+      culled_indices.insert(culled_indices.end(), kept.begin(), kept.end());
+    }
+
+    union_ranges.push_back({ static_cast<unsigned int>(culled_indices.size()),
+                             static_cast<unsigned int>(union_indices.size()) });
+    culled_indices.insert(culled_indices.end(), union_indices.begin(), union_indices.end());
+
+    visible_instances.emplace_back(i);
+    face_ranges.push_back(ranges);
+  }
+
+  if (culled_indices.empty()) {
+    return;
+  }
+
+  // Orphan the buffers every cull so the driver doesn't wait for the previous light's draws
+  glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+  index_capacity = std::max(index_capacity, culled_indices.size());
+  glBufferData(GL_COPY_WRITE_BUFFER, static_cast<long>(index_capacity * sizeof (unsigned int)),
+               nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, 0,
+                  static_cast<long>(culled_indices.size() * sizeof (unsigned int)),
+                  culled_indices.data());
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, indirect_buffer);
+  indirect_capacity = std::max(indirect_capacity, draw_commands.size());
+  glBufferData(GL_COPY_WRITE_BUFFER, static_cast<long>(indirect_capacity * sizeof (DrawCommand)),
+               nullptr, GL_STREAM_DRAW);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, 0,
+                  static_cast<long>(draw_commands.size() * sizeof (DrawCommand)),
+                  draw_commands.data());
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void ShadowCasters::draw_face(int face, int model_location) const
+{
+  for (size_t i = 0; i < visible_instances.size(); i++) {
+    draw_range(instances[visible_instances[i]], face_ranges[i][static_cast<size_t>(face)],
+               model_location);
+  }
+
+  glBindVertexArray(0);
+}
+
+void ShadowCasters::draw_layered(int model_location) const
+{
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+
+  for (size_t i = 0; i < visible_instances.size(); i++) {
+    const Instance& instance = instances[visible_instances[i]];
+    const Range& commands = command_ranges[i];
+
+    if (commands.count == 0) {
+      continue;
+    }
+
+    glUniformMatrix4fv(model_location, 1, GL_FALSE, &instance.model[0][0]);
+    glBindVertexArray(meshes[instance.mesh].VAO);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                                reinterpret_cast<void*>(commands.first * sizeof (DrawCommand)),
+                                static_cast<int>(commands.count), 0);
+
+    for (int face = 0; face < 6; face++) {
+      num_triangles += face_ranges[i][static_cast<size_t>(face)].count / 3;
+    }
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void ShadowCasters::draw_union(int model_location) const
+{
+  for (size_t i = 0; i < visible_instances.size(); i++) {
+    draw_range(instances[visible_instances[i]], union_ranges[i], model_location);
+  }
+
+  glBindVertexArray(0);
+}
+
+long long ShadowCasters::get_num_triangles() const
+{
+  return num_triangles;
+}
+
+void ShadowCasters::draw_range(const Instance& instance, const Range& range,
+                               int model_location) const
+{
+  if (range.count == 0) {
+    return;
+  }
+
+  glUniformMatrix4fv(model_location, 1, GL_FALSE, &instance.model[0][0]);
+  glBindVertexArray(meshes[instance.mesh].VAO);
+  glDrawElements(GL_TRIANGLES, static_cast<int>(range.count), GL_UNSIGNED_INT,
+                 reinterpret_cast<void*>(range.first * sizeof (unsigned int)));
+
+  num_triangles += range.count / 3;
+}
@@ -0,0 +1,89 @@
+#ifndef SHADOW_CASTERS_H
+#define SHADOW_CASTERS_H
+
+#include "culling/bounds.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+typedef glm::vec3 vec3;
+typedef glm::mat4 mat4;
+
+// Depth-only copies of the shadow casting meshes together with the instances placed this
+// frame. Before a cube shadow map is rendered the triangles of every instance are culled on
+// the CPU against each face frustum, and only the survivors are submitted, either one face
+// at a time, all faces in one multi-draw with the layer picked in the vertex shader, or as
+// the union of all faces for a geometry shader to amplify.
+class ShadowCasters
+{
+public:
+  ShadowCasters();
+  ~ShadowCasters();
+
+  unsigned int add_mesh(const vec3* positions, int num_positions,
+                        const unsigned int* indices, int num_indices);
+  unsigned int add_mesh(const float* vertices, int stride, int num_vertices,
+                        const unsigned int* indices, int num_indices);
+
+  void clear_instances();
+  void add_instance(unsigned int mesh, const mat4& model, const AABB& bounds);
+
+  void cull(const std::array<mat4, 6>& face_matrices, int face_mask,
+            const vec3& center, float radius);
+  void draw_face(int face, int model_location) const;
+  void draw_layered(int model_location) const;
+  void draw_union(int model_location) const;
+
+  long long get_num_triangles() const;
+
+private:
+  struct CasterMesh {
+    unsigned int VAO, VBO;
+    std::vector<vec3> positions;
+    std::vector<unsigned int> indices;
+  };
+
+  struct Instance {
+    unsigned int mesh;
+    mat4 model;
+    AABB bounds;
+  };
+
+  struct Range {
+    unsigned int first;
+    unsigned int count;
+  };
+
+  struct DrawCommand {
+    unsigned int count;
+    unsigned int instance_count;
+    unsigned int first_index;
+    int base_vertex;
+    unsigned int base_instance;
+  };
+
+  void draw_range(const Instance& instance, const Range& range, int model_location) const;
+
+  unsigned int EBO, face_VBO, indirect_buffer;
+  size_t index_capacity, indirect_capacity;
+
+  std::vector<CasterMesh> meshes;
+  std::vector<Instance> instances;
+
+  // Culled triangles of the last cull, per visible instance and face plus their union
+  std::vector<unsigned int> visible_instances;
+  std::vector<std::array<Range, 6>> face_ranges;
+  std::vector<Range> union_ranges;
+  std::vector<unsigned int> culled_indices;
+  std::vector<DrawCommand> draw_commands;
+  std::vector<Range> command_ranges;
+  std::array<std::vector<unsigned char>, 6> outcodes;
+  std::array<std::vector<unsigned int>, 6> face_indices;
+  std::vector<unsigned int> union_indices;
+  // Triangles submitted by all draws so far
+  mutable long long num_triangles;
+};
+
+#endif // SHADOW_CASTERS_H
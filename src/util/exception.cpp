@@ -9,3 +9,5 @@ GENERATE_EXCEPTION_IMPL(ModelException)
 GENERATE_EXCEPTION_IMPL(ShadowException)
 GENERATE_EXCEPTION_IMPL(FrameBufferException)
 GENERATE_EXCEPTION_IMPL(LoggingException)
+GENERATE_EXCEPTION_IMPL(LightsException)
+GENERATE_EXCEPTION_IMPL(RenderGraphException)
@@ -21,5 +21,7 @@ GENERATE_EXCEPTION_HEADER(ModelException)
 GENERATE_EXCEPTION_HEADER(ShadowException)
 GENERATE_EXCEPTION_HEADER(FrameBufferException)
 GENERATE_EXCEPTION_HEADER(LoggingException)
+GENERATE_EXCEPTION_HEADER(LightsException)
+GENERATE_EXCEPTION_HEADER(RenderGraphException)
 
 #endif // EXCEPTION_H
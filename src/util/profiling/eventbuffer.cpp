@@ -0,0 +1,170 @@
+#include "eventbuffer.h"
+#include "util/profiling/timetree.h"
+#include "util/profiling/tracewriter.h"
+#include "util/logging.h"
+
+#include <algorithm>
+
+namespace Profiling {
+  // Buffers of the threads that profiled something, kept until their last events are in
+  struct BufferRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<EventBuffer>> buffers;
+    unsigned int num_threads = 0;
+  };
+
+  // Never destroyed, threads may still exit during static destruction
+  static BufferRegistry& get_registry()
+  {
+    static auto registry = new BufferRegistry();
+    return *registry;
+  }
+
+  // Registers the thread's buffer and marks it finished once the thread exits
+  struct ThreadBuffer {
+    std::shared_ptr<EventBuffer> buffer;
+
+    ThreadBuffer()
+    {
+      BufferRegistry& registry = get_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+
+      buffer = std::make_shared<EventBuffer>(registry.num_threads++);
+      registry.buffers.push_back(buffer);
+    }
+
+    ~ThreadBuffer()
+    {
+      buffer->finished.store(true, std::memory_order_release);
+    }
+  };
+
+  EventBuffer::EventBuffer(unsigned int thread)
+    : events(std::make_unique<Event[]>(CAPACITY)),
+      head(0),
+      tail(0),
+      dropped(0),
+      depth(0),
+      dropped_depth(0),
+      finished(false),
+      thread(thread),
+      thread_name("Thread " + std::to_string(thread))
+  {
+  }
+
+  EventBuffer& EventBuffer::get()
+  {
+    thread_local ThreadBuffer thread_buffer;
+    return *thread_buffer.buffer;
+  }
+
+  void EventBuffer::collect(unsigned long long frame, TimeTree& time_tree, GpuTimer& gpu_timer,
+                            TraceWriter& trace_writer)
+  {
+    BufferRegistry& registry = get_registry();
+    std::vector<std::shared_ptr<EventBuffer>> buffers;
+
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      buffers = registry.buffers;
+    }
+
+    std::vector<std::shared_ptr<EventBuffer>> finished_buffers;
+
+    for (const auto& buffer : buffers) {
+      // Checked before draining, whatever the thread recorded before exiting is then drained
+      const bool finished = buffer->finished.load(std::memory_order_acquire);
+      buffer->drain(frame, time_tree, gpu_timer, trace_writer);
+
+      if (finished) {
+        finished_buffers.push_back(buffer);
+      }
+    }
+
+    if (finished_buffers.empty()) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto& registered = registry.buffers;
+    registered.erase(std::remove_if(registered.begin(), registered.end(),
+                                    [&finished_buffers] (const auto& buffer) {
+                                      return std::find(finished_buffers.begin(),
+                                                       finished_buffers.end(), buffer) !=
+                                             finished_buffers.end();
+                                    }),
+                     registered.end());
+  }
+
+  void EventBuffer::set_thread_name(const std::string& name)
+  {
+    std::lock_guard<std::mutex> lock(name_mutex);
+    thread_name = name;
+  }
+
+  void EventBuffer::discard()
+  {
+    tail.store(head.load(std::memory_order_relaxed), std::memory_order_release);
+    dropped.store(0, std::memory_order_relaxed);
+  }
+
+  void EventBuffer::drain(unsigned long long frame, TimeTree& time_tree, GpuTimer& gpu_timer,
+                          TraceWriter& trace_writer)
+  {
+    const size_t end = head.load(std::memory_order_acquire);
+    size_t position = tail.load(std::memory_order_relaxed);
+
+    if (position == end) {
+      return;
+    }
+
+    const std::string name = get_thread_name();
+    const int root = time_tree.get_child(TimeTree::ROOT, intern(name));
+
+    for (; position != end; position++) {
+      const Event& event = events[position & (CAPACITY - 1)];
+
+      if (event.type == Event::Type::BEGIN) {
+        const int parent = open_scopes.empty() ? root : open_scopes.back().node;
+        const int node = time_tree.get_child(parent, event.scope);
+
+        if (event.gpu_region >= 0) {
+          gpu_timer.set_node(event.gpu_region, node);
+        }
+
+        open_scopes.push_back({ event.scope, node, event.time, frame });
+        continue;
+      }
+
+      // Only after a discard inside a scope
+      if (open_scopes.empty()) {
+        continue;
+      }
+
+      const OpenScope& scope = open_scopes.back();
+
+      // Nanoseconds like the GPU times
+      time_tree.add_time(scope.node, static_cast<long long>(event.time - scope.start));
+      trace_writer.write_cpu_event(thread, name, scope.scope, scope.start, event.time,
+                                   scope.frame);
+      open_scopes.pop_back();
+    }
+
+    // The slots are the thread's to fill again
+    tail.store(end, std::memory_order_release);
+
+    const unsigned long long num_dropped = dropped.exchange(0, std::memory_order_relaxed);
+
+    if (num_dropped > 0) {
+      logger_t logger = Logging::get_logger();
+      logger << "Profiler dropped " << num_dropped << " scopes of " << name
+             << " past its capacity of " << CAPACITY << std::endl;
+    }
+  }
+
+  std::string EventBuffer::get_thread_name()
+  {
+    std::lock_guard<std::mutex> lock(name_mutex);
+    return thread_name;
+  }
+}
@@ -0,0 +1,126 @@
+#ifndef EVENTBUFFER_H
+#define EVENTBUFFER_H
+
+#include "util/profiling/gputimer.h"
+#include "util/profiling/scopenames.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TimeTree;
+
+namespace Profiling {
+  class TraceWriter;
+
+  struct Event {
+    enum class Type : unsigned char {
+      BEGIN,
+      END,
+    };
+
+    // Steady clock nanoseconds
+    unsigned long long time;
+    ScopeId scope;
+    // Started along with a BEGIN, -1 when the scope isn't timed on the GPU
+    GpuTimer::Region gpu_region;
+    Type type;
+  };
+
+  // A thread's scope entries and exits as fixed size records in a ring allocated once, so
+  // the scopes themselves don't allocate, lock or look anything up. Only the owning thread
+  // writes to the ring and only the collector reads from it, the two share nothing but the
+  // head and tail positions. Between frames the buffers of all threads are collected into a
+  // TimeTree, each thread's scopes under an element named after the thread, which is when
+  // the hierarchy is rebuilt from the order of the events. Events past the capacity are
+  // dropped until the collector catches up.
+  class EventBuffer {
+  public:
+    // A power of two, positions wrap with a mask
+    static constexpr size_t CAPACITY = 1 << 14;
+
+    explicit EventBuffer(unsigned int thread);
+
+    // The calling thread's buffer, registered with the collector on first use
+    static EventBuffer& get();
+    // Drains the buffers of every thread and forgets those of threads that have exited, from
+    // the thread ending the frames
+    static void collect(unsigned long long frame, TimeTree& time_tree, GpuTimer& gpu_timer,
+                        TraceWriter& trace_writer);
+
+    void record(Event::Type type, ScopeId scope, GpuTimer::Region gpu_region = -1)
+    {
+      const size_t position = head.load(std::memory_order_relaxed);
+
+      if (type == Event::Type::BEGIN) {
+        // Every scope still open keeps a slot for its end, so ends are never dropped and a
+        // scope inside a dropped one is dropped too
+        const size_t used = position - tail.load(std::memory_order_acquire);
+
+        if (dropped_depth > 0 || used + depth + 2 > CAPACITY) {
+          dropped_depth++;
+          dropped.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+
+        depth++;
+      } else if (dropped_depth > 0) {
+        dropped_depth--;
+        return;
+      } else {
+        depth--;
+      }
+
+      const auto now = std::chrono::steady_clock::now().time_since_epoch();
+      events[position & (CAPACITY - 1)] = {
+        static_cast<unsigned long long>(std::chrono::nanoseconds(now).count()),
+        scope, gpu_region, type
+      };
+      head.store(position + 1, std::memory_order_release);
+    }
+
+    // Shown in reports and traces, threads are numbered in the order they first profile
+    void set_thread_name(const std::string& name);
+    // Drops the events recorded so far, from the owning thread while nothing collects and
+    // outside of any scope started since the last collect
+    void discard();
+
+  private:
+    friend struct ThreadBuffer;
+
+    struct OpenScope {
+      ScopeId scope;
+      int node;
+      unsigned long long start;
+      unsigned long long frame;
+    };
+
+    // Scopes that ended are timed in the tree and written to the trace as part of the frame
+    // they started in, scopes still open stay open and are timed by a later drain
+    void drain(unsigned long long frame, TimeTree& time_tree, GpuTimer& gpu_timer,
+               TraceWriter& trace_writer);
+    std::string get_thread_name();
+
+    std::unique_ptr<Event[]> events;
+    // Advanced by the owning thread and the collector respectively
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    // Scopes dropped, counted by the owning thread and reset by the collector
+    std::atomic<unsigned long long> dropped;
+    // Open scopes of the owning thread that were recorded and that were dropped
+    size_t depth;
+    size_t dropped_depth;
+    // Set when the owning thread exits, its last events are still collected
+    std::atomic<bool> finished;
+    const unsigned int thread;
+    std::mutex name_mutex;
+    std::string thread_name;
+    // Only touched by the collector
+    std::vector<OpenScope> open_scopes;
+  };
+}
+
+#endif // EVENTBUFFER_H
@@ -0,0 +1,229 @@
+#include "gputimer.h"
+#include "util/profiling/timetree.h"
+#include "util/profiling/tracewriter.h"
+#include "util/logging.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// Targets of ARB_pipeline_statistics_query, core since 4.6, which the loader predates
+constexpr GLenum STATISTICS_TARGETS[] {
+  0x82EE, // GL_VERTICES_SUBMITTED
+  0x82EF, // GL_PRIMITIVES_SUBMITTED
+  0x82F4, // GL_FRAGMENT_SHADER_INVOCATIONS
+};
+
+static bool has_extension(const char* name)
+{
+  int num_extensions = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+
+  for (int i = 0; i < num_extensions; i++) {
+    const auto extension = reinterpret_cast<const char*>(
+      glGetStringi(GL_EXTENSIONS, static_cast<unsigned int>(i)));
+
+    if (std::strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool is_available(unsigned int query)
+{
+  unsigned int available = GL_FALSE;
+  glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+  return available == GL_TRUE;
+}
+
+static unsigned long long get_result(unsigned int query)
+{
+  GLuint64 result = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+
+  return result;
+}
+
+namespace Profiling {
+  GpuTimer::GpuTimer()
+    : initialized(false),
+      statistics_supported(false),
+      statistics_region(-1),
+      current(0),
+      dropped_frames(0),
+      frames(),
+      owner()
+  {
+  }
+
+  GpuTimer::Region GpuTimer::begin(bool statistics)
+  {
+    if (!claim()) {
+      return -1;
+    }
+
+    init();
+    Frame& frame = frames[current];
+
+    if (frame.used_timestamps + 2 > frame.timestamp_queries.size()) {
+      frame.timestamp_queries.resize(frame.used_timestamps + 2);
+      glGenQueries(2, &frame.timestamp_queries[frame.used_timestamps]);
+    }
+
+    const unsigned int timestamps = frame.used_timestamps;
+    frame.used_timestamps += 2;
+    glQueryCounter(frame.timestamp_queries[timestamps], GL_TIMESTAMP);
+
+    const auto region = static_cast<Region>(frame.records.size());
+    int statistics_index = -1;
+
+    if (statistics && statistics_supported && statistics_region < 0) {
+      if (frame.used_statistics == frame.statistics_queries.size()) {
+        frame.statistics_queries.emplace_back();
+        glGenQueries(static_cast<int>(frame.statistics_queries.back().size()),
+                     frame.statistics_queries.back().data());
+      }
+
+      statistics_index = static_cast<int>(frame.used_statistics++);
+      const StatisticsQueries& queries =
+        frame.statistics_queries[static_cast<size_t>(statistics_index)];
+
+      for (size_t i = 0; i < queries.size(); i++) {
+        glBeginQuery(STATISTICS_TARGETS[i], queries[i]);
+      }
+
+      statistics_region = region;
+    }
+
+    frame.records.push_back({ -1, timestamps, statistics_index });
+
+    return region;
+  }
+
+  void GpuTimer::end(Region region)
+  {
+    if (region < 0) {
+      return;
+    }
+
+    const Frame& frame = frames[current];
+    const Record& record = frame.records[static_cast<size_t>(region)];
+
+    glQueryCounter(frame.timestamp_queries[record.timestamps + 1], GL_TIMESTAMP);
+
+    if (region == statistics_region) {
+      for (const GLenum target : STATISTICS_TARGETS) {
+        glEndQuery(target);
+      }
+
+      statistics_region = -1;
+    }
+  }
+
+  void GpuTimer::set_node(Region region, int node)
+  {
+    if (region < 0) {
+      return;
+    }
+
+    frames[current].records[static_cast<size_t>(region)].node = node;
+  }
+
+  void GpuTimer::end_frame(unsigned long long frame_number, TimeTree& time_tree,
+                           TraceWriter& trace_writer)
+  {
+    if (!claim()) {
+      return;
+    }
+
+    frames[current].number = frame_number;
+    current = (current + 1) % FRAME_LATENCY;
+    Frame& frame = frames[current];
+
+    if (!frame.records.empty() && !read_back(frame, time_tree, trace_writer)) {
+      dropped_frames++;
+
+      // Every power of two, a slow GPU would fill the log otherwise
+      if ((dropped_frames & (dropped_frames - 1)) == 0) {
+        logger_t logger = Logging::get_logger();
+        logger << "GPU timings of " << dropped_frames << " frames dropped, still in flight after "
+               << FRAME_LATENCY << " frames" << std::endl;
+      }
+    }
+
+    frame.records.clear();
+    frame.used_timestamps = 0;
+    frame.used_statistics = 0;
+  }
+
+  void GpuTimer::init()
+  {
+    if (initialized) {
+      return;
+    }
+
+    // Queries need a context, so this waits for the first region instead of the constructor
+    statistics_supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 6) ||
+                           has_extension("GL_ARB_pipeline_statistics_query");
+    initialized = true;
+
+    logger_t logger = Logging::get_logger();
+    logger << "GPU pipeline statistics " << (statistics_supported ? "supported" : "not supported")
+           << std::endl;
+  }
+
+  bool GpuTimer::claim()
+  {
+    const std::thread::id thread = std::this_thread::get_id();
+    std::thread::id unowned;
+
+    return owner.compare_exchange_strong(unowned, thread, std::memory_order_relaxed) ||
+           unowned == thread;
+  }
+
+  bool GpuTimer::read_back(const Frame& frame, TimeTree& time_tree,
+                           TraceWriter& trace_writer) const
+  {
+    for (const Record& record : frame.records) {
+      if (!is_available(frame.timestamp_queries[record.timestamps + 1])) {
+        return false;
+      }
+
+      if (record.statistics >= 0 &&
+          !is_available(get_statistics_queries(frame, record).back())) {
+        return false;
+      }
+    }
+
+    for (const Record& record : frame.records) {
+      if (record.node < 0) {
+        continue;
+      }
+
+      const unsigned long long start = get_result(frame.timestamp_queries[record.timestamps]);
+      const unsigned long long end = get_result(frame.timestamp_queries[record.timestamps + 1]);
+
+      // Nanoseconds like the CPU times
+      time_tree.add_gpu_time(record.node, static_cast<long long>(end - start));
+      trace_writer.write_gpu_event(time_tree.get_scope(record.node), start, end, frame.number);
+
+      if (record.statistics >= 0) {
+        const StatisticsQueries& queries = get_statistics_queries(frame, record);
+        time_tree.add_pipeline_statistics(record.node, {
+          get_result(queries[0]), get_result(queries[1]), get_result(queries[2])
+        });
+      }
+    }
+
+    return true;
+  }
+
+  const GpuTimer::StatisticsQueries& GpuTimer::get_statistics_queries(const Frame& frame,
+                                                                       const Record& record)
+  {
+    return frame.statistics_queries[static_cast<size_t>(record.statistics)];
+  }
+}
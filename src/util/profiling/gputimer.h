@@ -0,0 +1,82 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+class TimeTree;
+
+namespace Profiling {
+  class TraceWriter;
+
+  struct PipelineStatistics {
+    unsigned long long vertices;
+    unsigned long long primitives;
+    unsigned long long fragments;
+  };
+
+  // GL_TIMESTAMP queries around GPU scopes, written into a ring of per-frame query pools and
+  // read back FRAME_LATENCY frames later, by which time the GPU is done with them and reading
+  // doesn't stall. Pipeline statistics are queried too where the driver supports them. The
+  // results go to the TimeTree element the region's scope was placed under, see EventBuffer.
+  // Queries need the GL context, so the first thread to begin a region or end a frame owns
+  // the timer and GPU scopes on any other thread are only timed on the CPU.
+  class GpuTimer {
+  public:
+    typedef int Region;
+
+    // Frames between issuing queries and reading them back
+    static constexpr unsigned int FRAME_LATENCY = 4;
+
+    GpuTimer();
+
+    // Regions nest, statistics queries can't, so they only count the outermost region that
+    // asks for them
+    // -1 on threads other than the owner, which end and set_node ignore
+    Region begin(bool statistics);
+    void end(Region region);
+    // Regions of the current frame without an element are left out of the results
+    void set_node(Region region, int node);
+    // Hands the results of the oldest frame to the time tree and the trace, then starts a
+    // new frame. Frames still in flight by then are dropped rather than waited for.
+    void end_frame(unsigned long long frame, TimeTree& time_tree, TraceWriter& trace_writer);
+
+  private:
+    typedef std::array<unsigned int, 3> StatisticsQueries;
+
+    struct Record {
+      int node;
+      unsigned int timestamps;
+      int statistics;
+    };
+
+    struct Frame {
+      std::vector<Record> records;
+      std::vector<unsigned int> timestamp_queries;
+      std::vector<StatisticsQueries> statistics_queries;
+      unsigned int used_timestamps;
+      unsigned int used_statistics;
+      unsigned long long number;
+    };
+
+    void init();
+    // Whether the calling thread owns the timer, taking it if nobody does yet
+    bool claim();
+    bool read_back(const Frame& frame, TimeTree& time_tree, TraceWriter& trace_writer) const;
+    static const StatisticsQueries& get_statistics_queries(const Frame& frame,
+                                                           const Record& record);
+
+    bool initialized;
+    bool statistics_supported;
+    // Region counting the statistics, -1 when none is
+    Region statistics_region;
+    unsigned int current;
+    unsigned long dropped_frames;
+    std::array<Frame, FRAME_LATENCY> frames;
+    std::atomic<std::thread::id> owner;
+  };
+}
+
+#endif // GPUTIMER_H
@@ -1,11 +1,37 @@
 #include "util/profiling/timescope.h"
 
+// Names are string literals, interned the first time the line runs. Also used to name render
+// graph passes, so defined in every build.
+#define PROFILE_ID(name)                 ([] { \
+                                           static const Profiling::ScopeId id = \
+                                             Profiling::intern(name); \
+                                           return id; \
+                                         }())
+// Array of the IDs of the format filled in with first to first + count - 1, for names numbered
+// at runtime, interned the first time the line runs
+#define PROFILE_IDS(format, first, count) ([]() -> const auto& { \
+                                            static const auto ids = \
+                                              Profiling::intern_range<count>(format, first); \
+                                            return ids; \
+                                          }())
+
 #ifdef PROFILE
-  #define PROFILE_SCOPE(name)              Profiling::TimeScope ts(name);
-  #define PROFILE_SECTION_START(m)   ts.section_start(m);
+  #define PROFILE_SCOPE(name)              Profiling::TimeScope ts(PROFILE_ID(name));
+  #define PROFILE_GPU_SCOPE(name)          Profiling::TimeScope ts(PROFILE_ID(name), true);
+  #define PROFILE_SECTION_START(m)   ts.section_start(PROFILE_ID(m));
+  // Names built at runtime are interned once by the caller, see PROFILE_IDS
+  #define PROFILE_SECTION_START_ID(id)     ts.section_start(id);
   #define PROFILE_SECTION_END()      ts.section_end();
+  #define PROFILE_FRAME_END()        Profiling::end_frame();
+  #define PROFILE_THREAD_NAME(name)  Profiling::set_thread_name(name);
+  #define PROFILE_CAPTURE_TRACE(n)   Profiling::capture_trace(n);
 #else
   #define PROFILE_SCOPE(name)
+  #define PROFILE_GPU_SCOPE(name)
   #define PROFILE_SECTION_START(m)
+  #define PROFILE_SECTION_START_ID(id)
   #define PROFILE_SECTION_END()
+  #define PROFILE_FRAME_END()
+  #define PROFILE_THREAD_NAME(name)
+  #define PROFILE_CAPTURE_TRACE(n)
 #endif
@@ -0,0 +1,67 @@
+#include "scopenames.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+constexpr size_t MAX_FORMATTED_LENGTH = 128;
+
+namespace Profiling {
+  // Names are never removed, so the map's keys can view the deque's strings
+  struct Registry {
+    std::mutex mutex;
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, ScopeId> ids;
+  };
+
+  // Never destroyed, the timings printed at exit still need the names
+  static Registry& get_registry()
+  {
+    static auto registry = new Registry();
+    return *registry;
+  }
+
+  ScopeId intern(std::string_view name)
+  {
+    Registry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    const auto interned = registry.ids.find(name);
+    if (interned != registry.ids.end()) {
+      return interned->second;
+    }
+
+    const auto scope = static_cast<ScopeId>(registry.names.size());
+    registry.ids.emplace(registry.names.emplace_back(name), scope);
+
+    return scope;
+  }
+
+  ScopeId intern_format(const char* format, ...)
+  {
+    char name[MAX_FORMATTED_LENGTH];
+
+    va_list arguments;
+    va_start(arguments, format);
+    const int length = std::vsnprintf(name, sizeof (name), format, arguments);
+    va_end(arguments);
+
+    if (length < 0) {
+      return intern(format);
+    }
+
+    return intern(std::string_view(name, std::min(static_cast<size_t>(length),
+                                                  sizeof (name) - 1)));
+  }
+
+  std::string get_name(ScopeId scope)
+  {
+    Registry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    return registry.names[scope];
+  }
+}
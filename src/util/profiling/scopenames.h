@@ -0,0 +1,34 @@
+#ifndef SCOPENAMES_H
+#define SCOPENAMES_H
+
+#include <array>
+#include <string>
+#include <string_view>
+
+namespace Profiling {
+  // Index of an interned scope name, the profiler records these instead of the names
+  typedef unsigned int ScopeId;
+
+  // The ID of the name, registered the first time it's seen. Names already registered are
+  // looked up without allocating.
+  ScopeId intern(std::string_view name);
+  // Interns the name printf would format, for names built at runtime, which are formatted
+  // on the stack and truncated past 127 characters
+  ScopeId intern_format(const char* format, ...) __attribute__ ((format (printf, 1, 2)));
+  std::string get_name(ScopeId scope);
+
+  // IDs of the names printf would format with first to first + N - 1, see PROFILE_IDS
+  template <size_t N>
+  std::array<ScopeId, N> intern_range(const char* format, int first)
+  {
+    std::array<ScopeId, N> ids;
+
+    for (size_t i = 0; i < N; i++) {
+      ids[i] = intern_format(format, first + static_cast<int>(i));
+    }
+
+    return ids;
+  }
+}
+
+#endif // SCOPENAMES_H
@@ -0,0 +1,158 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Profiling {
+  Statistics::Statistics()
+  {
+    reset();
+  }
+
+  void Statistics::add(double time)
+  {
+    count++;
+    const double delta = time - mean;
+    mean += delta / static_cast<double>(count);
+    m2 += delta * (time - mean);
+    min = std::min(min, time);
+    max = std::max(max, time);
+    histogram[static_cast<size_t>(get_bucket(time))]++;
+  }
+
+  void Statistics::merge(const Statistics& other)
+  {
+    if (other.count == 0) {
+      return;
+    }
+
+    if (count == 0) {
+      *this = other;
+      return;
+    }
+
+    // Chan et al.'s pairwise update
+    const auto count_a = static_cast<double>(count);
+    const auto count_b = static_cast<double>(other.count);
+    const double merged_count = count_a + count_b;
+    const double delta = other.mean - mean;
+
+    mean += delta * count_b / merged_count;
+    m2 += other.m2 + delta * delta * count_a * count_b / merged_count;
+    count += other.count;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+
+    for (size_t i = 0; i < histogram.size(); i++) {
+      histogram[i] += other.histogram[i];
+    }
+  }
+
+  void Statistics::reset()
+  {
+    count = 0;
+    mean = 0.0;
+    m2 = 0.0;
+    min = std::numeric_limits<double>::infinity();
+    max = -std::numeric_limits<double>::infinity();
+    histogram.fill(0);
+  }
+
+  unsigned long long Statistics::get_count() const
+  {
+    return count;
+  }
+
+  double Statistics::get_mean() const
+  {
+    return mean;
+  }
+
+  double Statistics::get_variance() const
+  {
+    return count > 1 ? m2 / static_cast<double>(count - 1) : 0.0;
+  }
+
+  double Statistics::get_percentile(double fraction) const
+  {
+    if (count == 0) {
+      return 0.0;
+    }
+
+    const auto rank = static_cast<unsigned long long>(
+      std::ceil(fraction * static_cast<double>(count)));
+    unsigned long long seen = 0;
+    int bucket = 0;
+
+    for (; bucket < NUM_BUCKETS - 1; bucket++) {
+      seen += histogram[static_cast<size_t>(bucket)];
+
+      if (seen >= std::max(rank, 1ULL)) {
+        break;
+      }
+    }
+
+    if (bucket == 0) {
+      return min;
+    }
+
+    // Geometric middle of the bucket, kept within the times actually seen
+    const double exponent = (static_cast<double>(bucket) - 0.5) / SUB_BUCKETS;
+    return std::clamp(std::exp2(exponent), min, max);
+  }
+
+  Statistics::Summary Statistics::summarize() const
+  {
+    if (count == 0) {
+      return {};
+    }
+
+    return {
+      count, mean, std::sqrt(get_variance()), min, max,
+      get_percentile(0.5), get_percentile(0.9), get_percentile(0.99), get_percentile(0.999),
+    };
+  }
+
+  int Statistics::get_bucket(double time)
+  {
+    if (time < 1.0) {
+      return 0;
+    }
+
+    const auto bucket = 1 + static_cast<int>(std::floor(std::log2(time) * SUB_BUCKETS));
+    return std::min(bucket, NUM_BUCKETS - 1);
+  }
+
+  RollingStatistics::RollingStatistics()
+    : current(0)
+  {
+  }
+
+  void RollingStatistics::add(double time)
+  {
+    if (windows[static_cast<size_t>(current)].get_count() >= WINDOW_SAMPLES) {
+      current = (current + 1) % NUM_WINDOWS;
+      windows[static_cast<size_t>(current)].reset();
+    }
+
+    total.add(time);
+    windows[static_cast<size_t>(current)].add(time);
+  }
+
+  const Statistics& RollingStatistics::get_total() const
+  {
+    return total;
+  }
+
+  Statistics RollingStatistics::get_window() const
+  {
+    Statistics window;
+
+    for (const Statistics& statistics : windows) {
+      window.merge(statistics);
+    }
+
+    return window;
+  }
+}
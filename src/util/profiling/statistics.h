@@ -0,0 +1,71 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <array>
+
+namespace Profiling {
+  // Streaming statistics of a series of times in nanoseconds with a fixed memory cost. The
+  // mean and variance use Welford's updates, percentiles come from a histogram with
+  // logarithmic buckets, SUB_BUCKETS per power of two, so they are within about 9%.
+  class Statistics {
+  public:
+    struct Summary {
+      unsigned long long count;
+      double mean, deviation;
+      double min, max;
+      double p50, p90, p99, p999;
+    };
+
+    static constexpr int SUB_BUCKETS = 4;
+    // Up to 2^42 ns, over an hour, larger times share the last bucket
+    static constexpr int MAX_EXPONENT = 42;
+    // The first bucket holds everything under 1 ns
+    static constexpr int NUM_BUCKETS = 1 + MAX_EXPONENT * SUB_BUCKETS;
+
+    Statistics();
+
+    void add(double time);
+    // Combines the statistics as if all of the other's times had been added to these
+    void merge(const Statistics& other);
+    void reset();
+
+    unsigned long long get_count() const;
+    double get_mean() const;
+    double get_variance() const;
+    // The time below which the given fraction of the times fall
+    double get_percentile(double fraction) const;
+    Summary summarize() const;
+
+  private:
+    static int get_bucket(double time);
+
+    unsigned long long count;
+    double mean;
+    // Sum of squared differences from the mean
+    double m2;
+    double min, max;
+    std::array<unsigned long long, NUM_BUCKETS> histogram;
+  };
+
+  // Statistics over the whole run and over a rolling window of the last WINDOW_SAMPLES to
+  // NUM_WINDOWS * WINDOW_SAMPLES times. The window is a ring of sub-windows and the oldest
+  // is dropped whole when the newest fills up.
+  class RollingStatistics {
+  public:
+    static constexpr int NUM_WINDOWS = 4;
+    static constexpr unsigned long long WINDOW_SAMPLES = 128;
+
+    RollingStatistics();
+
+    void add(double time);
+    const Statistics& get_total() const;
+    Statistics get_window() const;
+
+  private:
+    Statistics total;
+    std::array<Statistics, NUM_WINDOWS> windows;
+    int current;
+  };
+}
+
+#endif // STATISTICS_H
@@ -1,55 +1,112 @@
 #include "timescope.h"
+#include "util/profiling/eventbuffer.h"
 #include "util/profiling/timetree.h"
+#include "util/profiling/tracewriter.h"
+
+#include <csignal>
+
+// Frames a trace asked for with the signal covers
+constexpr unsigned long long SIGNAL_TRACE_FRAMES = 300;
 
 namespace Profiling {
-  using namespace std::chrono;
   static auto time_tree = TimeTree();
-  static std::string current_parent;
+  static auto gpu_timer = GpuTimer();
+  static auto trace_writer = TraceWriter();
+  // Frames ended so far, the number of the current one
+  static unsigned long long frame = 0;
+  static volatile std::sig_atomic_t trace_signalled = 0;
+
+  static void on_trace_signal(int)
+  {
+    trace_signalled = 1;
+  }
+
+  static bool install_trace_signal()
+  {
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, on_trace_signal);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  TimeScope::TimeScope(ScopeId scope, bool gpu)
+    : scope(scope),
+      section(0),
+      gpu(gpu),
+      region(gpu ? gpu_timer.begin(false) : -1),
+      section_region(-1)
+  {
+    EventBuffer::get().record(Event::Type::BEGIN, scope, region);
+  }
+
+  TimeScope::~TimeScope() {
+    if (gpu) {
+      gpu_timer.end(region);
+    }
+
+    EventBuffer::get().record(Event::Type::END, scope);
+  }
 
-  TimeScope::TimeScope(const std::string& name)
-    : start(steady_clock::now()),
-      name(name)
+  void TimeScope::section_start(ScopeId section)
   {
-    time_tree.register_element(name);
+    this->section = section;
 
-    if (current_parent == name) {
-      return;
+    if (gpu) {
+      section_region = gpu_timer.begin(true);
     }
 
-    if (current_parent == "") {
-      current_parent = name;
-      time_tree.register_global_parent(name);
-      return;
+    EventBuffer::get().record(Event::Type::BEGIN, section, section_region);
+  }
+
+  void TimeScope::section_end()
+  {
+    if (gpu) {
+      gpu_timer.end(section_region);
     }
 
-    if (!time_tree.is_ancestor_of(name, current_parent)) {
-      time_tree.register_child(current_parent, name);
+    EventBuffer::get().record(Event::Type::END, section);
+  }
+
+  void end_frame()
+  {
+    static const bool signal_installed = install_trace_signal();
+
+    if (signal_installed && trace_signalled) {
+      trace_signalled = 0;
+      capture_trace(SIGNAL_TRACE_FRAMES);
     }
 
-    current_parent = name;
+    EventBuffer::collect(frame, time_tree, gpu_timer, trace_writer);
+    gpu_timer.end_frame(frame, time_tree, trace_writer);
+    trace_writer.end_frame(frame, GpuTimer::FRAME_LATENCY);
+    frame++;
   }
 
-  TimeScope::~TimeScope() {
-    const auto duration = duration_cast<microseconds>(steady_clock::now() - start).count();
-    time_tree.add_time(name, duration);
+  void set_thread_name(const std::string& name)
+  {
+    EventBuffer::get().set_thread_name(name);
   }
 
-  void TimeScope::section_start(const std::string& message)
+  void capture_trace(unsigned long long first_frame, unsigned long long num_frames)
   {
-    this->message = message;
-    t0 = steady_clock::now();
+    trace_writer.capture("logs/trace_" + std::to_string(first_frame) + ".json", first_frame,
+                         num_frames);
+  }
 
-    time_tree.register_element(message);
-    time_tree.register_child(name, message);
+  void capture_trace(unsigned long long num_frames)
+  {
+    capture_trace(frame + 1, num_frames);
+  }
 
-    if (current_parent != message) {
-      current_parent = message;
-    }
+  Statistics get_statistics(const std::string& name, bool gpu, bool window)
+  {
+    return time_tree.get_statistics(name, gpu, window);
   }
 
-  void TimeScope::section_end()
+  std::string report()
   {
-    const auto duration = duration_cast<microseconds>(steady_clock::now() - t0).count();
-    time_tree.add_time(message, duration);
+    return time_tree.print_tree(true);
   }
 }
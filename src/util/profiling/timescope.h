@@ -1,24 +1,51 @@
 #ifndef TIMESCOPE_H
 #define TIMESCOPE_H
 
-#include <chrono>
+#include "util/profiling/gputimer.h"
+#include "util/profiling/scopenames.h"
+#include "util/profiling/statistics.h"
+
 #include <string>
 
 namespace Profiling {
+  // Records its entry and exit in the thread's EventBuffer, nothing else happens until the
+  // events are collected at the end of the frame. Scopes can be used on any thread.
   class TimeScope {
   public:
-    TimeScope(const std::string& name);
+    // GPU scopes and their sections are also timed on the GPU with timestamp queries, the
+    // sections also count pipeline statistics unless an enclosing section already does
+    TimeScope(ScopeId scope, bool gpu = false);
     ~TimeScope();
 
-    void section_start(const std::string& message);
+    void section_start(ScopeId section);
     void section_end();
 
   private:
-    std::chrono::steady_clock::time_point start;
-    std::chrono::steady_clock::time_point t0;
-    std::string message;
-    std::string name;
+    ScopeId scope;
+    ScopeId section;
+    bool gpu;
+    GpuTimer::Region region;
+    GpuTimer::Region section_region;
   };
+
+  // Rebuilds the timings of the scopes every thread recorded since the last frame and reads
+  // back the GPU timings of the frame FRAME_LATENCY frames ago, called once per frame outside
+  // of any GPU scope on the thread with the GL context. The functions below are only called
+  // from that thread as well.
+  void end_frame();
+  // Groups the calling thread's scopes under the name in reports and traces
+  void set_thread_name(const std::string& name);
+
+  // Writes a Chrome trace of the frames from the first on to logs/, see TraceWriter. Sending
+  // the process SIGUSR1 captures the next frames too, where there is such a signal.
+  void capture_trace(unsigned long long first_frame, unsigned long long num_frames);
+  // Starting with the frame after this one
+  void capture_trace(unsigned long long num_frames);
+
+  // Times of an element so far, over the rolling window or the whole run
+  Statistics get_statistics(const std::string& name, bool gpu = false, bool window = true);
+  // The tree of timings over the rolling window, printed like the one logged at exit
+  std::string report();
 }
 
 #endif // TIMESCOPE_H
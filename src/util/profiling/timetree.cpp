@@ -2,9 +2,17 @@
 #include "util/logging.h"
 
 #include <sstream>
-#include <numeric>
 #include <iomanip>
 
+// Columns of the printed tree, names are padded to the first
+constexpr int NAME_WIDTH = 40;
+constexpr int TIME_WIDTH = 11;
+
+TimeTree::TimeTree()
+  : elements(1)
+{
+}
+
 TimeTree::~TimeTree()
 {
   logger_t logger = Logging::get_logger();
@@ -14,105 +22,183 @@ TimeTree::~TimeTree()
   logger << print_tree();
 }
 
-void TimeTree::register_element(const std::string& element)
+TimeTree::Node TimeTree::get_child(Node parent, Profiling::ScopeId scope)
 {
-  auto [it, success] = time_map.try_emplace(element, std::vector<long>());
-
-  if (!success) {
-    return;
+  // Elements have a handful of children, scanning them beats hashing
+  for (const Node child : elements[static_cast<size_t>(parent)].children) {
+    if (elements[static_cast<size_t>(child)].scope == scope) {
+      return child;
+    }
   }
 
-  hierarchy.try_emplace(element, std::vector<std::string>());
+  const auto child = static_cast<Node>(elements.size());
+  elements.emplace_back();
+  elements.back().scope = scope;
+  elements[static_cast<size_t>(parent)].children.emplace_back(child);
+
+  return child;
 }
 
-void TimeTree::register_child(const std::string& parent, const std::string& child)
+Profiling::ScopeId TimeTree::get_scope(Node node) const
 {
-  auto [it, success] = hierarchy_search[parent].emplace(child);
+  return elements[static_cast<size_t>(node)].scope;
+}
 
-  if (!success) {
-    return;
-  }
+void TimeTree::add_time(Node node, long long time)
+{
+  elements[static_cast<size_t>(node)].cpu_times.add(static_cast<double>(time));
+}
 
-  time_map.try_emplace(child, std::vector<long>());
-  hierarchy[parent].emplace_back(child);
+void TimeTree::add_gpu_time(Node node, long long time)
+{
+  elements[static_cast<size_t>(node)].gpu_times.add(static_cast<double>(time));
 }
 
-void TimeTree::add_time(const std::string& name, long time)
+void TimeTree::add_pipeline_statistics(Node node,
+                                       const Profiling::PipelineStatistics& statistics)
 {
-  time_map[name].emplace_back(time);
+  StatisticsTotal& total = elements[static_cast<size_t>(node)].statistics;
+  total.sum.vertices += statistics.vertices;
+  total.sum.primitives += statistics.primitives;
+  total.sum.fragments += statistics.fragments;
+  total.count++;
 }
 
-bool TimeTree::is_ancestor_of(const std::string& ancestor, const std::string& child)
+Profiling::Statistics TimeTree::get_statistics(const std::string& name, bool gpu,
+                                               bool window) const
 {
-  const auto& children = hierarchy_search[ancestor];
-  if (children.find(child) != children.end()) {
-    return true;
-  }
+  Profiling::Statistics statistics;
 
-  for (const auto& parent : children) {
-    if (is_ancestor_of(parent, child)) {
-      return true;
+  for (size_t i = ROOT + 1; i < elements.size(); i++) {
+    const Element& element = elements[i];
+
+    if (Profiling::get_name(element.scope) != name) {
+      continue;
     }
+
+    const auto& times = gpu ? element.gpu_times : element.cpu_times;
+    statistics.merge(window ? times.get_window() : times.get_total());
   }
 
-  return false;
+  return statistics;
 }
 
-void TimeTree::register_global_parent(const std::string& parent)
+static std::string format_time(double time)
 {
-  register_element(parent);
-  global_parent = parent;
-}
+  const char* unit = "ns";
 
-double get_average_time(const std::vector<long>& times) {
-  return std::accumulate(times.begin(), times.end(), 0.0, [&times] (auto a, auto b) {
-    return (a * times.size() + b) / times.size();
-  });
+  if (time >= 1e9) {
+    time /= 1e9;
+    unit = "s";
+  } else if (time >= 1e6) {
+    time /= 1e6;
+    unit = "ms";
+  } else if (time >= 1e3) {
+    time /= 1e3;
+    unit = "us";
+  }
+
+  std::stringstream ss;
+  ss << std::setprecision(3) << time << " " << unit;
+
+  return ss.str();
 }
 
-void TimeTree::print_average(std::ostream& stream, const std::string& name, int padding) {
-  for (int i = 0; i < padding; i++) {
-    stream << " ";
+static std::string format_count(double count)
+{
+  const char* unit = "";
+
+  if (count >= 1e6) {
+    count /= 1e6;
+    unit = "M";
+  } else if (count >= 1e3) {
+    count /= 1e3;
+    unit = "K";
   }
 
-  double time = get_average_time(time_map.find(name)->second);
-  const char* unit = "us";
+  std::stringstream ss;
+  ss << std::setprecision(3) << count << unit;
+
+  return ss.str();
+}
 
-  if (time >= 1e6) {
-    time /= 1e6;
-    unit = "s";
-  } else if (time >= 1e3) {
-    time /= 1e3;
-    unit = "ms";
-  }
+static void print_times(std::ostream& stream, const Profiling::Statistics& statistics)
+{
+  const Profiling::Statistics::Summary summary = statistics.summarize();
 
-  stream << name;
-  stream << std::right << std::setw(50 - padding - static_cast<int>(name.length()))
-         << time << " " << unit << std::endl;
+  for (const double time : { summary.mean, summary.deviation, summary.p50, summary.p90,
+                             summary.p99, summary.p999, summary.max }) {
+    stream << std::setw(TIME_WIDTH) << format_time(time);
+  }
 }
 
-void TimeTree::print_element(std::ostream& stream, const std::string& name, int padding)
+void TimeTree::print_statistics(std::ostream& stream, Node node, int padding,
+                                bool window) const
 {
-  print_average(stream, name, padding);
-  auto children = hierarchy.find(name);
+  const Element& element = elements[static_cast<size_t>(node)];
+
+  stream << std::string(static_cast<size_t>(padding), ' ') << std::left
+         << std::setw(NAME_WIDTH - padding) << Profiling::get_name(element.scope) << std::right;
+
+  // Threads group their scopes without being timed themselves
+  if (element.cpu_times.get_total().get_count() > 0) {
+    print_times(stream, window ? element.cpu_times.get_window() : element.cpu_times.get_total());
+  }
+
+  stream << std::endl;
 
-  if (children == hierarchy.end()) {
+  if (element.gpu_times.get_total().get_count() == 0) {
     return;
   }
 
-  for (const auto& child : children->second) {
-   print_element(stream, child, padding + 2);
+  // GPU times go on a line of their own under the CPU times
+  stream << std::string(static_cast<size_t>(padding + 2), ' ') << std::left
+         << std::setw(NAME_WIDTH - padding - 2) << "(GPU)" << std::right;
+  print_times(stream, window ? element.gpu_times.get_window() : element.gpu_times.get_total());
+
+  const StatisticsTotal& total = element.statistics;
+
+  if (total.count > 0) {
+    const auto count = static_cast<double>(total.count);
+
+    stream << "  " << format_count(static_cast<double>(total.sum.vertices) / count)
+           << " vertices, " << format_count(static_cast<double>(total.sum.primitives) / count)
+           << " primitives, " << format_count(static_cast<double>(total.sum.fragments) / count)
+           << " fragments";
   }
+
+  stream << std::endl;
 }
 
-std::string TimeTree::print_tree()
+void TimeTree::print_element(std::ostream& stream, Node node, int padding, bool window) const
 {
-  if (global_parent.empty()) {
+  print_statistics(stream, node, padding, window);
+
+  for (const Node child : elements[static_cast<size_t>(node)].children) {
+    print_element(stream, child, padding + 2, window);
+  }
+}
+
+std::string TimeTree::print_tree(bool window) const
+{
+  const std::vector<Node>& outermost = elements[ROOT].children;
+
+  if (outermost.empty()) {
     return "";
   }
 
   std::stringstream ss;
-  print_element(ss, global_parent, 0);
+  ss << std::setw(NAME_WIDTH) << "";
+
+  for (const char* column : { "mean", "deviation", "p50", "p90", "p99", "p99.9", "max" }) {
+    ss << std::setw(TIME_WIDTH) << column;
+  }
+
+  ss << std::endl;
+
+  for (const Node node : outermost) {
+    print_element(ss, node, 0, window);
+  }
 
   return ss.str();
 }
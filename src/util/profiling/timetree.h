@@ -1,30 +1,58 @@
 #ifndef TIMETREE_H
 #define TIMETREE_H
 
-#include <unordered_map>
-#include <unordered_set>
+#include "util/profiling/gputimer.h"
+#include "util/profiling/scopenames.h"
+#include "util/profiling/statistics.h"
+
+#include <string>
 #include <vector>
 
+// Call tree of the profiled scopes, rebuilt from the recorded events by EventBuffer. The
+// outermost elements are the threads, a scope entered from different parents has an element
+// under each of them.
 class TimeTree
 {
 public:
+  typedef int Node;
+
+  // Parent of the outermost scopes, never timed itself
+  static constexpr Node ROOT = 0;
+
+  TimeTree();
   ~TimeTree();
 
-  void register_element(const std::string& element);
-  void register_child(const std::string& parent, const std::string& child);
-  void add_time(const std::string& name, long time);
-  bool is_ancestor_of(const std::string& ancestor, const std::string& child);
-  void register_global_parent(const std::string& parent);
-  std::string print_tree();
+  // The child element for the scope, added the first time it's entered from the parent
+  Node get_child(Node parent, Profiling::ScopeId scope);
+  Profiling::ScopeId get_scope(Node node) const;
+  // In nanoseconds, converted to a unit only when printed
+  void add_time(Node node, long long time);
+  // Measured by GpuTimer, printed next to the CPU time of the same element
+  void add_gpu_time(Node node, long long time);
+  void add_pipeline_statistics(Node node, const Profiling::PipelineStatistics& statistics);
+  // Over the rolling window or the whole run, merged across the elements of every scope
+  // with the name, empty if it was never timed
+  Profiling::Statistics get_statistics(const std::string& name, bool gpu, bool window) const;
+  std::string print_tree(bool window = false) const;
 
 private:
-  void print_average(std::ostream& stream, const std::string& name, int padding);
-  void print_element(std::ostream& stream, const std::string& name, int padding);
+  struct StatisticsTotal {
+    Profiling::PipelineStatistics sum;
+    unsigned long long count;
+  };
+
+  struct Element {
+    Profiling::ScopeId scope;
+    std::vector<Node> children;
+    Profiling::RollingStatistics cpu_times;
+    Profiling::RollingStatistics gpu_times;
+    StatisticsTotal statistics;
+  };
+
+  void print_statistics(std::ostream& stream, Node node, int padding, bool window) const;
+  void print_element(std::ostream& stream, Node node, int padding, bool window) const;
 
-  std::unordered_map<std::string, std::vector<long>> time_map;
-  std::unordered_map<std::string, std::vector<std::string>> hierarchy;
-  std::unordered_map<std::string, std::unordered_set<std::string>> hierarchy_search;
-  std::string global_parent = "";
+  std::vector<Element> elements;
 };
 
 #endif // TIMETREE_H
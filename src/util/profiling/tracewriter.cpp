@@ -0,0 +1,183 @@
+#include "tracewriter.h"
+#include "util/logging.h"
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+
+// Tracks of the trace, one process with a thread for the GPU and one for each profiled thread
+constexpr int PROCESS_ID = 1;
+constexpr int GPU_TRACK = 0;
+constexpr int FIRST_THREAD_TRACK = 1;
+
+static std::string escape(const std::string& name)
+{
+  std::string escaped;
+
+  for (const char c : name) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      continue;
+    }
+
+    escaped += c;
+  }
+
+  return escaped;
+}
+
+namespace Profiling {
+  TraceWriter::TraceWriter()
+    : first_frame(0),
+      num_frames(0),
+      requested(false),
+      cpu_origin(0),
+      gpu_origin(0)
+  {
+  }
+
+  TraceWriter::~TraceWriter()
+  {
+    close();
+  }
+
+  void TraceWriter::capture(const std::string& path, unsigned long long first_frame,
+                            unsigned long long num_frames)
+  {
+    if (file.is_open()) {
+      logger_t logger = Logging::get_logger();
+      logger << "Trace of " << this->path << " still running, " << path << " not captured"
+             << std::endl;
+      return;
+    }
+
+    this->path = path;
+    this->first_frame = first_frame;
+    this->num_frames = num_frames;
+    requested = true;
+  }
+
+  bool TraceWriter::is_capturing() const
+  {
+    return file.is_open();
+  }
+
+  void TraceWriter::write_cpu_event(unsigned int thread, const std::string& thread_name,
+                                    ScopeId scope, unsigned long long start,
+                                    unsigned long long end, unsigned long long frame)
+  {
+    if (!in_capture(frame)) {
+      return;
+    }
+
+    const int track = FIRST_THREAD_TRACK + static_cast<int>(thread);
+
+    if (thread >= named_threads.size()) {
+      named_threads.resize(thread + 1, false);
+    }
+
+    if (!named_threads[thread]) {
+      file << ",\n";
+      write_thread_name(track, thread_name);
+      named_threads[thread] = true;
+    }
+
+    write_event(scope, track, static_cast<long long>(start) - cpu_origin,
+                static_cast<long long>(end) - cpu_origin);
+  }
+
+  void TraceWriter::write_gpu_event(ScopeId scope, unsigned long long start,
+                                    unsigned long long end, unsigned long long frame)
+  {
+    if (!in_capture(frame)) {
+      return;
+    }
+
+    write_event(scope, GPU_TRACK, static_cast<long long>(start) - gpu_origin,
+                static_cast<long long>(end) - gpu_origin);
+  }
+
+  void TraceWriter::end_frame(unsigned long long frame, unsigned long long gpu_latency)
+  {
+    const unsigned long long next_frame = frame + 1;
+
+    if (requested && next_frame >= first_frame) {
+      // Captures asked for frames already gone start with the next one
+      first_frame = next_frame;
+      requested = false;
+      open();
+    } else if (file.is_open() && next_frame >= first_frame + num_frames + gpu_latency) {
+      close();
+    }
+  }
+
+  void TraceWriter::open()
+  {
+    const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+    if (!directory.empty()) {
+      std::filesystem::create_directories(directory);
+    }
+
+    file.open(path);
+
+    logger_t logger = Logging::get_logger();
+
+    if (!file.is_open()) {
+      logger << "Cannot open trace file " << path << std::endl;
+      return;
+    }
+
+    logger << "Writing a trace of frames " << first_frame << " to "
+           << first_frame + num_frames - 1 << " to " << path << std::endl;
+
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    cpu_origin = std::chrono::nanoseconds(now).count();
+    GLint64 gpu_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+    gpu_origin = gpu_now;
+    named_threads.clear();
+
+    file << std::fixed << std::setprecision(3) << "[\n";
+    file << R"({"name":"process_name","ph":"M","pid":)" << PROCESS_ID
+         << R"(,"args":{"name":"Renderer"}},)" << "\n";
+    write_thread_name(GPU_TRACK, "GPU");
+  }
+
+  void TraceWriter::close()
+  {
+    if (!file.is_open()) {
+      return;
+    }
+
+    file << "\n]\n";
+    file.close();
+
+    logger_t logger = Logging::get_logger();
+    logger << "Trace written to " << path << std::endl;
+  }
+
+  void TraceWriter::write_event(ScopeId scope, int track, long long start, long long end)
+  {
+    // The metadata always comes first, so every event follows another. These are complete
+    // events in microseconds from the start of the capture.
+    file << ",\n";
+    file << R"({"name":")" << escape(get_name(scope)) << R"(","ph":"X","pid":)" << PROCESS_ID
+         << R"(,"tid":)" << track << R"(,"ts":)" << static_cast<double>(start) / 1000.0
+         << R"(,"dur":)" << static_cast<double>(end - start) / 1000.0 << "}";
+  }
+
+  void TraceWriter::write_thread_name(int track, const std::string& name)
+  {
+    file << R"({"name":"thread_name","ph":"M","pid":)" << PROCESS_ID << R"(,"tid":)" << track
+         << R"(,"args":{"name":")" << escape(name) << R"("}})";
+  }
+
+  bool TraceWriter::in_capture(unsigned long long frame) const
+  {
+    return file.is_open() && frame >= first_frame && frame < first_frame + num_frames;
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include "util/profiling/scopenames.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace Profiling {
+  // Writes the scopes of a range of frames as a Chrome trace (the JSON array format, which
+  // chrome://tracing and the Perfetto UI both open). Events go to the file as the frames are
+  // drained, nothing is kept in memory, and a trace cut short is still readable since the
+  // format doesn't need the closing bracket. Every profiled thread is a track, named as it
+  // first shows up, and GPU scopes another, moved onto the CPU clock with an offset measured
+  // when the capture starts. Only used from the thread ending the frames.
+  class TraceWriter {
+  public:
+    TraceWriter();
+    ~TraceWriter();
+
+    // Replaces any capture not started yet, one already running carries on
+    void capture(const std::string& path, unsigned long long first_frame,
+                 unsigned long long num_frames);
+    bool is_capturing() const;
+
+    // Times are steady clock nanoseconds, events of frames outside the capture are skipped
+    void write_cpu_event(unsigned int thread, const std::string& thread_name, ScopeId scope,
+                         unsigned long long start, unsigned long long end,
+                         unsigned long long frame);
+    // Times are GPU timestamps
+    void write_gpu_event(ScopeId scope, unsigned long long start, unsigned long long end,
+                         unsigned long long frame);
+    // Opens the file before the first frame of the capture and closes it once the GPU
+    // results of the last one are in, on the thread with the GL context
+    void end_frame(unsigned long long frame, unsigned long long gpu_latency);
+
+  private:
+    void open();
+    void close();
+    void write_event(ScopeId scope, int track, long long start, long long end);
+    void write_thread_name(int track, const std::string& name);
+    bool in_capture(unsigned long long frame) const;
+
+    std::string path;
+    unsigned long long first_frame, num_frames;
+    bool requested;
+    std::ofstream file;
+    // Capture start on the steady clock and the GPU clock
+    long long cpu_origin, gpu_origin;
+    // Threads whose track has been named in the current capture
+    std::vector<bool> named_threads;
+  };
+}
+
+#endif // TRACEWRITER_H